@@ -10,8 +10,8 @@
  * 3. `point_t`
  *
  * As well as several function-specific convenience functions and convenience
- * macros for you to "extend" points.  For example, `pal_point_t`'s definition
- * looks like this:
+ * macros for you to "extend" points.  For example, a point carrying Paleo's
+ * features could be defined like this:
  *
  * \code{.c}
  * typedef struct {
@@ -0,0 +1,465 @@
+/*!
+ * \addtogroup common
+ * \{
+ *
+ * \file srz.c
+ * Implementation of interface defined in srz.h.
+ *
+ * Only the parts of the zip format that `.srz` archives use are supported: a
+ * single disk, no zip64, no encryption, and stored or deflated entries.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "srz.h"
+
+
+
+//! Signature of a local file header.
+#define _LOCAL_SIG 0x04034b50
+//! Signature of a central directory file header.
+#define _CENTRAL_SIG 0x02014b50
+//! Signature of the end of central directory record.
+#define _END_SIG 0x06054b50
+
+//! Size of a local file header (without name and extra field).
+#define _LOCAL_SIZE 30
+//! Size of a central directory file header (without variable fields).
+#define _CENTRAL_SIZE 46
+//! Size of the end of central directory record (without comment).
+#define _END_SIZE 22
+
+//! Maximum length of an entry name written by `srz_write()`.
+#define _NAME_LEN 32
+
+//! Compression methods.
+enum { _STORED = 0, _DEFLATED = 8 };
+
+/*! Reads a little-endian 16-bit integer.
+ * \param p The bytes.
+ * \return The integer.
+ */
+static inline uint16_t _get16(const unsigned char* p) {
+  return p[0] | p[1] << 8;
+}
+
+/*! Reads a little-endian 32-bit integer.
+ * \param p The bytes.
+ * \return The integer.
+ */
+static inline uint32_t _get32(const unsigned char* p) {
+  return (uint32_t)_get16(p) | (uint32_t)_get16(p + 2) << 16;
+}
+
+/*! Writes a little-endian 16-bit integer.
+ * \param p The destination.
+ * \param v The integer.
+ */
+static inline void _put16(unsigned char* p, uint16_t v) {
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+}
+
+/*! Writes a little-endian 32-bit integer.
+ * \param p The destination.
+ * \param v The integer.
+ */
+static inline void _put32(unsigned char* p, uint32_t v) {
+  _put16(p, v & 0xffff);
+  _put16(p + 2, v >> 16);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// -------------------------------- Reading --------------------------------- //
+////////////////////////////////////////////////////////////////////////////////
+
+/*! Parses the canvas and stroke index out of an entry name.
+ *
+ * \param e The entry to populate.
+ * \param name The name (not NUL-terminated).
+ * \param len The length of the name.
+ */
+static inline void
+_parse_name(srz_entry_t* e, const unsigned char* name, size_t len) {
+  char buf[_NAME_LEN+1];
+  e->canvas = e->index = -1;
+  if (len > _NAME_LEN) {
+    return;
+  }
+  memcpy(buf, name, len);
+  buf[len] = '\0';
+
+  int canvas, index, end = 0;
+  if (sscanf(buf, "stroke-%d-%d.sr%n", &canvas, &index, &end) == 2 &&
+      end == len) {
+    e->canvas = canvas;
+    e->index = index;
+  }
+}
+
+/*! Reads the central directory of the archive into `self->entries`.
+ *
+ * \param self The reader.
+ *
+ * \return 1 on success, 0 o.w.
+ */
+static int _read_directory(srz_reader_t* self) {
+  if (self->len < _END_SIZE) {
+    fprintf(stderr, "Error: not a zip archive.\n");
+    return 0;
+  }
+
+  // The end record is at the very end unless there's an archive comment.
+  const unsigned char* end = NULL;
+  for (size_t i = self->len - _END_SIZE + 1; i-- > 0 && !end; ) {
+    if (_get32(&self->data[i]) == _END_SIG &&
+        i + _END_SIZE + _get16(&self->data[i+20]) == self->len) {
+      end = &self->data[i];
+    }
+  }
+  if (end == NULL) {
+    fprintf(stderr, "Error: not a zip archive.\n");
+    return 0;
+  }
+
+  const size_t num = _get16(&end[10]);
+  const size_t cd_off = _get32(&end[16]);
+  if (_get16(&end[4]) != 0 || _get16(&end[8]) != num ||
+      cd_off > (size_t)(end - self->data)) {
+    fprintf(stderr, "Error: unsupported zip archive.\n");
+    return 0;
+  }
+
+  self->entries = calloc(num ? num : 1, sizeof(srz_entry_t));
+  const unsigned char* p = &self->data[cd_off];
+  for (size_t i = 0; i < num; i++) {
+    if (p + _CENTRAL_SIZE > end || _get32(p) != _CENTRAL_SIG) {
+      fprintf(stderr, "Error: corrupt zip central directory.\n");
+      return 0;
+    }
+
+    const size_t name_len = _get16(&p[28]);
+    const size_t var_len = name_len + _get16(&p[30]) + _get16(&p[32]);
+    if (p + _CENTRAL_SIZE + var_len > end) {
+      fprintf(stderr, "Error: corrupt zip central directory.\n");
+      return 0;
+    }
+
+    // Skip directories.
+    const unsigned char* name = &p[_CENTRAL_SIZE];
+    if (name_len == 0 || name[name_len-1] != '/') {
+      srz_entry_t* e = &self->entries[self->num++];
+      e->method = _get16(&p[10]);
+      e->crc = _get32(&p[16]);
+      e->comp_size = _get32(&p[20]);
+      e->size = _get32(&p[24]);
+      e->offset = _get32(&p[42]);
+      _parse_name(e, name, name_len);
+    }
+    p += _CENTRAL_SIZE + var_len;
+  }
+  return 1;
+}
+
+srz_reader_t* srz_open_mem(const void* data, size_t len) {
+  srz_reader_t* self = calloc(1, sizeof(srz_reader_t));
+  self->data = data;
+  self->len = len;
+  if (!_read_directory(self)) {
+    srz_close(self);
+    return NULL;
+  }
+  return self;
+}
+
+srz_reader_t* srz_open(const char* fname) {
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Could not read from file: %s\n", fname);
+    return NULL;
+  }
+
+  struct stat st;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "Could not map file: %s\n", fname);
+    return NULL;
+  }
+
+  srz_reader_t* self = srz_open_mem(map, st.st_size);
+  if (self == NULL) {
+    fprintf(stderr, "Error: could not open archive: %s\n", fname);
+    munmap(map, st.st_size);
+    return NULL;
+  }
+  self->map = map;
+  return self;
+}
+
+/*! Decompresses an entry into `self->buf` and NUL-terminates it.
+ *
+ * \param self The reader.
+ * \param e The entry.
+ *
+ * \return 1 on success, 0 o.w.
+ */
+static int _inflate_entry(srz_reader_t* self, const srz_entry_t* e) {
+  const unsigned char* local = &self->data[e->offset];
+  if (self->len < _LOCAL_SIZE || e->offset > self->len - _LOCAL_SIZE ||
+      _get32(local) != _LOCAL_SIG) {
+    fprintf(stderr, "Error: corrupt zip entry.\n");
+    return 0;
+  }
+  const size_t start =
+    e->offset + _LOCAL_SIZE + _get16(&local[26]) + _get16(&local[28]);
+  if (start > self->len || e->comp_size > self->len - start) {
+    fprintf(stderr, "Error: corrupt zip entry.\n");
+    return 0;
+  }
+
+  if (self->buf_cap < (size_t)e->size + 1) {
+    self->buf = realloc(self->buf, self->buf_cap = (size_t)e->size + 1);
+  }
+
+  if (e->method == _STORED) {
+    if (e->comp_size != e->size) {
+      fprintf(stderr, "Error: corrupt zip entry.\n");
+      return 0;
+    }
+    memcpy(self->buf, &self->data[start], e->size);
+  } else if (e->method == _DEFLATED) {
+    z_stream zs;
+    bzero(&zs, sizeof(zs));
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+      fprintf(stderr, "Error: could not initialize zlib.\n");
+      return 0;
+    }
+    zs.next_in = (unsigned char*)&self->data[start];
+    zs.avail_in = e->comp_size;
+    zs.next_out = (unsigned char*)self->buf;
+    zs.avail_out = e->size;
+    int ret = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+    if (ret != Z_STREAM_END || zs.total_out != e->size) {
+      fprintf(stderr, "Error: could not inflate zip entry.\n");
+      return 0;
+    }
+  } else {
+    fprintf(stderr, "Error: unsupported compression method: %d\n", e->method);
+    return 0;
+  }
+
+  if (crc32(0, (unsigned char*)self->buf, e->size) != e->crc) {
+    fprintf(stderr, "Error: zip entry failed its CRC check.\n");
+    return 0;
+  }
+  self->buf[e->size] = '\0';
+  return 1;
+}
+
+stroke_t* srz_next(srz_reader_t* self, int* canvas, int* index) {
+  if (self->next >= self->num) {
+    return NULL;
+  }
+
+  const srz_entry_t* e = &self->entries[self->next++];
+  stroke_t* strk = _inflate_entry(self, e) ? stroke_from_text(self->buf) : NULL;
+  if (strk == NULL) {
+    self->error = 1;
+    return NULL;
+  }
+  if (canvas) { *canvas = e->canvas; }
+  if (index) { *index = e->index; }
+  return strk;
+}
+
+void srz_close(srz_reader_t* self) {
+  if (self->map) {
+    munmap(self->map, self->len);
+  }
+  free(self->entries);
+  free(self->buf);
+  bzero(self, sizeof(srz_reader_t));
+  free(self);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// -------------------------------- Writing --------------------------------- //
+////////////////////////////////////////////////////////////////////////////////
+
+/*! Formats the name of an entry.
+ *
+ * \param name Gets the name; must have room for `_NAME_LEN + 1` chars.
+ * \param e The entry.
+ *
+ * \return The length of the name.
+ */
+static inline int _format_name(char* name, const srz_entry_t* e) {
+  return snprintf(name, _NAME_LEN + 1, "stroke-%02d-%03d.sr",
+                  e->canvas, e->index);
+}
+
+srz_writer_t* srz_writer_create(const char* fname) {
+  FILE* fp = fopen(fname, "w");
+  if (!fp) {
+    fprintf(stderr, "Could not write to file: %s\n", fname);
+    return NULL;
+  }
+
+  srz_writer_t* self = calloc(1, sizeof(srz_writer_t));
+  self->fp = fp;
+
+  time_t now = time(NULL);
+  struct tm tm;
+  localtime_r(&now, &tm);
+  self->dos_time = tm.tm_hour << 11 | tm.tm_min << 5 | tm.tm_sec / 2;
+  self->dos_date = (tm.tm_year - 80) << 9 | (tm.tm_mon + 1) << 5 | tm.tm_mday;
+  return self;
+}
+
+int srz_write(srz_writer_t* self, const stroke_t* strk, int canvas, int index) {
+  if (canvas < 0 || index < 0) {
+    fprintf(stderr, "Error: bad stroke position: %d,%d\n", canvas, index);
+    return 0;
+  }
+
+  size_t len;
+  char* text = stroke_to_text(strk, &len);
+
+  // Compress the whole entry in memory so the local header can be written
+  // with its sizes and CRC, keeping the archive a single streaming pass.
+  z_stream zs;
+  bzero(&zs, sizeof(zs));
+  if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    fprintf(stderr, "Error: could not initialize zlib.\n");
+    free(text);
+    return 0;
+  }
+  const size_t bound = deflateBound(&zs, len);
+  unsigned char* comp = malloc(bound);
+  zs.next_in = (unsigned char*)text;
+  zs.avail_in = len;
+  zs.next_out = comp;
+  zs.avail_out = bound;
+  int ret = deflate(&zs, Z_FINISH);
+  deflateEnd(&zs);
+  if (ret != Z_STREAM_END || len > UINT32_MAX) {
+    fprintf(stderr, "Error: could not deflate stroke.\n");
+    free(comp);
+    free(text);
+    return 0;
+  }
+
+  if (self->num >= self->cap) {
+    self->cap = self->cap ? 2 * self->cap : 16;
+    self->entries = realloc(self->entries, self->cap * sizeof(srz_entry_t));
+  }
+  srz_entry_t* e = &self->entries[self->num];
+  e->method = _DEFLATED;
+  e->crc = crc32(0, (unsigned char*)text, len);
+  e->comp_size = zs.total_out;
+  e->size = len;
+  e->offset = self->offset;
+  e->canvas = canvas;
+  e->index = index;
+  free(text);
+
+  char name[_NAME_LEN+1];
+  const int name_len = _format_name(name, e);
+
+  unsigned char h[_LOCAL_SIZE];
+  _put32(&h[0], _LOCAL_SIG);
+  _put16(&h[4], 20);
+  _put16(&h[6], 0);
+  _put16(&h[8], e->method);
+  _put16(&h[10], self->dos_time);
+  _put16(&h[12], self->dos_date);
+  _put32(&h[14], e->crc);
+  _put32(&h[18], e->comp_size);
+  _put32(&h[22], e->size);
+  _put16(&h[26], name_len);
+  _put16(&h[28], 0);
+
+  const uint64_t next = (uint64_t)self->offset + sizeof(h) + name_len +
+    e->comp_size;
+  int ok = next <= UINT32_MAX &&
+    fwrite(h, sizeof(h), 1, self->fp) == 1 &&
+    fwrite(name, name_len, 1, self->fp) == 1 &&
+    fwrite(comp, e->comp_size, 1, self->fp) == 1;
+  free(comp);
+  if (!ok) {
+    fprintf(stderr, "Error: could not write stroke to archive.\n");
+    return 0;
+  }
+
+  self->offset = next;
+  self->num++;
+  return 1;
+}
+
+int srz_writer_close(srz_writer_t* self) {
+  int ok = self->num <= UINT16_MAX;
+  const uint32_t cd_off = self->offset;
+  uint32_t cd_size = 0;
+
+  for (size_t i = 0; ok && i < self->num; i++) {
+    const srz_entry_t* e = &self->entries[i];
+    char name[_NAME_LEN+1];
+    const int name_len = _format_name(name, e);
+
+    unsigned char h[_CENTRAL_SIZE];
+    bzero(h, sizeof(h));
+    _put32(&h[0], _CENTRAL_SIG);
+    _put16(&h[4], 20);
+    _put16(&h[6], 20);
+    _put16(&h[10], e->method);
+    _put16(&h[12], self->dos_time);
+    _put16(&h[14], self->dos_date);
+    _put32(&h[16], e->crc);
+    _put32(&h[20], e->comp_size);
+    _put32(&h[24], e->size);
+    _put16(&h[28], name_len);
+    _put32(&h[42], e->offset);
+
+    ok = fwrite(h, sizeof(h), 1, self->fp) == 1 &&
+      fwrite(name, name_len, 1, self->fp) == 1;
+    cd_size += sizeof(h) + name_len;
+  }
+
+  unsigned char end[_END_SIZE];
+  bzero(end, sizeof(end));
+  _put32(&end[0], _END_SIG);
+  _put16(&end[8], self->num);
+  _put16(&end[10], self->num);
+  _put32(&end[12], cd_size);
+  _put32(&end[16], cd_off);
+  ok = ok && fwrite(end, sizeof(end), 1, self->fp) == 1;
+  ok = (fclose(self->fp) == 0) && ok;
+  if (!ok) {
+    fprintf(stderr, "Error: could not write archive directory.\n");
+  }
+
+  free(self->entries);
+  bzero(self, sizeof(srz_writer_t));
+  free(self);
+  return ok;
+}
+
+/*! \} */
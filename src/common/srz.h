@@ -0,0 +1,165 @@
+/*!
+ * \addtogroup common
+ * \{
+ *
+ * \file srz.h
+ * Reads and writes `.srz` stroke archives without temporary files.
+ *
+ * An `.srz` archive is a zip file (as written by `tools/collector.py`) whose
+ * entries are named `stroke-CC-SSS.sr` -- the stroke `SSS` on canvas `CC` --
+ * and hold one stroke each in the text format written by `stroke_save()`.
+ * Entries are either stored or deflated.
+ *
+ * Reading iterates the archive's central directory and inflates each entry
+ * straight from memory (the archive is `mmap`'d or supplied by the caller):
+ *
+ * \code{.c}
+ * srz_reader_t* srz = srz_open("strokes.srz");
+ * stroke_t* strk;
+ * while ((strk = srz_next(srz, NULL, NULL))) {
+ *   // ... use strk ...
+ *   stroke_destroy(strk);
+ * }
+ * if (srz_error(srz)) {
+ *   // ... an entry could not be read ...
+ * }
+ * srz_close(srz);
+ * \endcode
+ *
+ * Writing happens in one streaming pass: each stroke is compressed in memory
+ * and written behind its local header, and the central directory is written
+ * by `srz_writer_close()`.
+ */
+
+#ifndef __srz_h__
+#define __srz_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "stroke.h"
+
+//! A central directory entry of an `.srz` archive.
+typedef struct {
+  uint16_t method;        //!< Compression method (0: stored, 8: deflate).
+  uint32_t crc;           //!< CRC-32 of the uncompressed data.
+  uint32_t comp_size;     //!< Compressed size.
+  uint32_t size;          //!< Uncompressed size.
+  uint32_t offset;        //!< Offset of the entry's local header.
+  int canvas;             //!< Canvas from the name, or -1.
+  int index;              //!< Stroke index from the name, or -1.
+} srz_entry_t;
+
+//! Reads the strokes of an `.srz` archive.
+typedef struct {
+  const unsigned char* data;  //!< The archive.
+  size_t len;                 //!< Length of the archive.
+  void* map;                  //!< The mapping if opened by file, else \c NULL.
+
+  srz_entry_t* entries;       //!< The archive's entries.
+  size_t num;                 //!< Number of entries.
+  size_t next;                //!< Index of the next entry to read.
+  int error;                  //!< Whether an entry could not be read.
+
+  char* buf;                  //!< Inflate buffer, reused across entries.
+  size_t buf_cap;             //!< Capacity of `buf`.
+} srz_reader_t;
+
+//! Writes an `.srz` archive in a single streaming pass.
+typedef struct {
+  FILE* fp;                   //!< The archive being written.
+  uint32_t offset;            //!< Current offset into the archive.
+  srz_entry_t* entries;       //!< Entries written so far.
+  size_t num;                 //!< Number of entries.
+  size_t cap;                 //!< Capacity of `entries`.
+  uint16_t dos_time;          //!< Modification time of every entry.
+  uint16_t dos_date;          //!< Modification date of every entry.
+} srz_writer_t;
+
+/*! Opens an `.srz` archive by mapping it into memory.
+ *
+ * \param fname The archive.
+ *
+ * \return The reader, or \c NULL on error.
+ */
+srz_reader_t* srz_open(const char* fname);
+
+/*! Opens an `.srz` archive that is already in memory.  The memory must stay
+ * valid until [\ref srz_close(srz_reader_t*)].
+ *
+ * \param data The archive.
+ * \param len The length of the archive.
+ *
+ * \return The reader, or \c NULL on error.
+ */
+srz_reader_t* srz_open_mem(const void* data, size_t len);
+
+/*! Reads the next stroke in the archive.
+ *
+ * \param self The reader.
+ * \param canvas If not \c NULL, gets the stroke's canvas (-1 if unknown).
+ * \param index If not \c NULL, gets the stroke's index (-1 if unknown).
+ *
+ * \return The stroke (freed with `stroke_destroy()`) or \c NULL at the end of
+ *   the archive or on error; tell them apart with
+ *   [\ref srz_error(const srz_reader_t*)].  After an error, the next call
+ *   reads the entry after the bad one.
+ */
+stroke_t* srz_next(srz_reader_t* self, int* canvas, int* index);
+
+/*! Tells whether an entry could not be read since the reader was opened or
+ * rewound.
+ *
+ * \param self The reader.
+ *
+ * \return 1 if a call to [\ref srz_next(srz_reader_t*, int*, int*)] failed, 0
+ *   o.w.
+ */
+static inline int srz_error(const srz_reader_t* self) { return self->error; }
+
+/*! Restarts iteration at the first stroke, and clears the error.
+ *
+ * \param self The reader.
+ */
+static inline void srz_rewind(srz_reader_t* self) {
+  self->next = 0;
+  self->error = 0;
+}
+
+/*! Closes the archive and frees the reader.
+ *
+ * \param self The reader.
+ */
+void srz_close(srz_reader_t* self);
+
+/*! Creates an `.srz` archive.
+ *
+ * \param fname The archive to write.
+ *
+ * \return The writer, or \c NULL on error.
+ */
+srz_writer_t* srz_writer_create(const char* fname);
+
+/*! Adds a stroke to the archive as `stroke-CC-SSS.sr`.
+ *
+ * \param self The writer.
+ * \param strk The stroke.
+ * \param canvas The stroke's canvas.
+ * \param index The stroke's index on its canvas.
+ *
+ * \return 1 on success, 0 o.w.
+ */
+int srz_write(srz_writer_t* self, const stroke_t* strk, int canvas, int index);
+
+/*! Writes the archive's central directory, closes it, and frees the writer.
+ *
+ * \param self The writer.
+ *
+ * \return 1 on success, 0 o.w.
+ */
+int srz_writer_close(srz_writer_t* self);
+
+#endif  // __srz_h__
+
+/*! \} */
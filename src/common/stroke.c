@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <values.h>
 
 #include "debug.h"
@@ -151,17 +152,32 @@ stroke_t* stroke_from_file(const char* fname) {
     return NULL;
   }
 
+  // Each point takes at least 6 bytes ("0,0,0\n"), so a count the file can't
+  // hold is rejected before it's used to size the points.
+  struct stat st;
   stroke_t* self = calloc(sizeof(stroke_t), 1);
-  if (fscanf(fp, "%ld\n", &self->num) == EOF) {
+  if (fstat(fileno(fp), &st) ||
+      fscanf(fp, "%ld\n", &self->num) != 1 ||
+      self->num < 0 || self->num > INT_MAX || self->num > st.st_size / 6) {
+    fprintf(stderr, "Error: bad point count in %s\n", fname);
     stroke_destroy(self);
     fclose(fp);
     return NULL;
   }
 
-  self->pts = calloc(sizeof(point_t), self->num);
+  self->pts = calloc(sizeof(point_t), self->size = self->num);
+  if (self->pts == NULL && self->num > 0) {
+    fprintf(stderr, "Error: could not allocate %ld points for %s\n",
+            self->num, fname);
+    stroke_destroy(self);
+    fclose(fp);
+    return NULL;
+  }
   for (int i = 0; i < self->num; i++) {
     if (fscanf(fp, "%lf,%lf,%ld",
-               &self->pts[i].x, &self->pts[i].y, &self->pts[i].t) == EOF) {
+               &self->pts[i].x, &self->pts[i].y, &self->pts[i].t) != 3) {
+      fprintf(stderr, "Error: expected %ld points in %s, read %d\n",
+              self->num, fname, i);
       stroke_destroy(self);
       fclose(fp);
       return NULL;
@@ -172,6 +188,78 @@ stroke_t* stroke_from_file(const char* fname) {
   return self;
 }
 
+char* stroke_to_text(const stroke_t* self, size_t* len) {
+  // Generous per-point bound; grown below if a point doesn't fit.
+  size_t cap = 32 + self->num * 48;
+  char* text = malloc(cap);
+  size_t n = snprintf(text, cap, "%ld\n", self->num);
+  for (int i = 0; i < self->num; i++) {
+    int w;
+    while ((w = snprintf(&text[n], cap - n, "%.1f,%.1f,%ld\n",
+            self->pts[i].x, self->pts[i].y, self->pts[i].t)) >= cap - n) {
+      text = realloc(text, cap *= 2);
+    }
+    n += w;
+  }
+  *len = n;
+  return text;
+}
+
+/*! Parses a point's separator, i.e., checks that the text at `*p` is `c` and
+ * moves past it.
+ *
+ * \param p The parse position.
+ * \param c The expected separator.
+ *
+ * \return 1 if the separator was there, 0 o.w.
+ */
+static inline int _expect(const char** p, char c) {
+  if (**p != c) {
+    return 0;
+  }
+  (*p)++;
+  return 1;
+}
+
+stroke_t* stroke_from_text(const char* text) {
+  char* end;
+  long num = strtol(text, &end, 10);
+  // Each point takes at least 6 bytes (a separator, then "0,0,0"), so a count
+  // the text can't hold is rejected before it's used to size the points.
+  if (end == text || num < 0 || num > INT_MAX || num > strlen(end) / 6) {
+    fprintf(stderr, "Error: bad point count in stroke text\n");
+    return NULL;
+  }
+
+  stroke_t* self = stroke_create(num);
+  if (self->pts == NULL && num > 0) {
+    fprintf(stderr, "Error: could not allocate %ld points\n", num);
+    stroke_destroy(self);
+    return NULL;
+  }
+  const char* p = end;
+  for (int i = 0; i < num; i++) {
+    point_t* pt = &self->pts[i];
+    pt->x = strtod(p, &end);
+    if (end == p || !_expect((const char**)&end, ',')) { break; }
+    pt->y = strtod(p = end, &end);
+    if (end == p || !_expect((const char**)&end, ',')) { break; }
+    pt->t = strtol(p = end, &end, 10);
+    if (end == p) { break; }
+    pt->i = i;
+    p = end;
+    self->num++;
+  }
+
+  if (self->num != num) {
+    fprintf(stderr, "Error: expected %ld points in stroke text, read %ld\n",
+            num, self->num);
+    stroke_destroy(self);
+    return NULL;
+  }
+  return self;
+}
+
 point_t* stroke_get(const stroke_t* self, int i) {
   return &self->pts[i];
 }
@@ -140,10 +140,29 @@ int stroke_save(stroke_t* self, const char* fname);
  *
  * \param fname The name of the file to load.
  *
- * \return The stroke that was in the file.
+ * \return The stroke that was in the file, or \c NULL if it is malformed.
  */
 stroke_t* stroke_from_file(const char* fname);
 
+/*!
+ * Formats a stroke in the same text format `stroke_save()` writes.
+ *
+ * \param self The stroke to format.
+ * \param len Gets the length of the text (excluding the terminating NUL).
+ *
+ * \return The NUL-terminated text; must be freed by the caller.
+ */
+char* stroke_to_text(const stroke_t* self, size_t* len);
+
+/*!
+ * Parses a stroke from text in the format `stroke_save()` writes.
+ *
+ * \param text The NUL-terminated text to parse.
+ *
+ * \return The stroke, or \c NULL if the text is malformed.
+ */
+stroke_t* stroke_from_text(const char* text);
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
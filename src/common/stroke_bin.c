@@ -0,0 +1,190 @@
+/*!
+ * \addtogroup common
+ * \{
+ *
+ * \file stroke_bin.c
+ * Implementation of interface defined in stroke_bin.h.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stroke_bin.h"
+#include "util.h"
+
+
+
+//! Offset of the first column; the header padded to `STROKE_SOA_ALIGN`.
+#define _HEADER_SIZE \
+  ((sizeof(stroke_bin_header_t) + STROKE_SOA_ALIGN - 1) \
+   / STROKE_SOA_ALIGN * STROKE_SOA_ALIGN)
+
+int stroke_bin_write_column(FILE* fp, const void* col, uint64_t num,
+                            uint64_t stride) {
+  static const char zeros[STROKE_SOA_ALIGN];
+  if (fwrite(col, sizeof(double), num, fp) != num) {
+    return 0;
+  }
+  for (uint64_t i = num; i < stride; i += STROKE_SOA_PAD) {
+    const uint64_t n = MIN(stride - i, (uint64_t)STROKE_SOA_PAD);
+    if (fwrite(zeros, sizeof(double), n, fp) != n) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int stroke_bin_check_preamble(const void* header, const char* magic,
+                              uint32_t version, size_t min_size, size_t len,
+                              const char* kind, const char* fname) {
+  stroke_bin_preamble_t p;
+  memcpy(&p, header, sizeof(p));
+  if (memcmp(p.magic, magic, sizeof(p.magic))) {
+    fprintf(stderr, "Error: %s is not a %s.\n", fname, kind);
+    return 0;
+  }
+  if (p.bom != STROKE_BIN_BOM) {
+    fprintf(stderr, "Error: %s has the wrong byte order.\n", fname);
+    return 0;
+  }
+  if (p.version != version) {
+    fprintf(stderr, "Error: %s has unsupported version %u.\n",
+            fname, p.version);
+    return 0;
+  }
+  if (p.header_size < min_size || p.header_size > len ||
+      p.header_size % STROKE_SOA_ALIGN) {
+    fprintf(stderr, "Error: %s is corrupt.\n", fname);
+    return 0;
+  }
+  return 1;
+}
+
+int stroke_soa_save_bin(const stroke_soa_t* self, const char* fname) {
+  FILE* fp = fopen(fname, "w");
+  if (!fp) {
+    fprintf(stderr, "Could not write to file: %s\n", fname);
+    return 0;
+  }
+
+  char header[_HEADER_SIZE];
+  bzero(header, sizeof(header));
+  stroke_bin_header_t* h = (stroke_bin_header_t*)header;
+  memcpy(h->magic, STROKE_BIN_MAGIC, sizeof(h->magic));
+  h->version = STROKE_BIN_VERSION;
+  h->bom = STROKE_BIN_BOM;
+  h->header_size = _HEADER_SIZE;
+  h->num = self->num;
+  h->stride = (self->num + STROKE_SOA_PAD - 1) / STROKE_SOA_PAD
+    * STROKE_SOA_PAD;
+
+  int ok = fwrite(header, sizeof(header), 1, fp) == 1 &&
+    stroke_bin_write_column(fp, self->x, h->num, h->stride) &&
+    stroke_bin_write_column(fp, self->y, h->num, h->stride) &&
+    stroke_bin_write_column(fp, self->t, h->num, h->stride);
+  ok = (fclose(fp) == 0) && ok;
+  if (!ok) {
+    fprintf(stderr, "Could not write to file: %s\n", fname);
+  }
+  return ok;
+}
+
+int stroke_save_bin(const stroke_t* self, const char* fname) {
+  stroke_soa_t* soa = stroke_soa_from_stroke(self);
+  if (soa == NULL) {
+    return 0;
+  }
+  int ok = stroke_soa_save_bin(soa, fname);
+  stroke_soa_destroy(soa);
+  return ok;
+}
+
+/*! Checks that a header describes a valid file of `len` bytes.
+ *
+ * \param h The header.
+ * \param len The length of the file.
+ * \param fname The name of the file (for error messages).
+ *
+ * \return 1 if valid, 0 o.w.
+ */
+static inline int
+_check_header(const stroke_bin_header_t* h, size_t len, const char* fname) {
+  if (!stroke_bin_check_preamble(h, STROKE_BIN_MAGIC, STROKE_BIN_VERSION,
+                                 sizeof(stroke_bin_header_t), len,
+                                 "binary stroke file", fname)) {
+    return 0;
+  }
+  if (h->stride < h->num || h->stride % STROKE_SOA_PAD ||
+      h->stride > (len - h->header_size) / (3 * sizeof(double)) ||
+      h->header_size + 3 * sizeof(double) * h->stride != len) {
+    fprintf(stderr, "Error: %s is corrupt.\n", fname);
+    return 0;
+  }
+  return 1;
+}
+
+stroke_map_t* stroke_map(const char* fname) {
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Could not read from file: %s\n", fname);
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < (off_t)_HEADER_SIZE) {
+    fprintf(stderr, "Error: %s is not a binary stroke file.\n", fname);
+    close(fd);
+    return NULL;
+  }
+
+  const size_t len = st.st_size;
+  void* addr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    fprintf(stderr, "Could not map %s: %s\n", fname, strerror(errno));
+    return NULL;
+  }
+
+  const stroke_bin_header_t* h = addr;
+  if (!_check_header(h, len, fname)) {
+    munmap(addr, len);
+    return NULL;
+  }
+
+  stroke_map_t* self = calloc(1, sizeof(stroke_map_t));
+  self->addr = addr;
+  self->len = len;
+  self->strk.num = h->num;
+  self->strk.size = h->stride;
+  self->strk.x = (double*)((char*)addr + h->header_size);
+  self->strk.y = self->strk.x + h->stride;
+  self->strk.t = (long*)(self->strk.y + h->stride);
+  self->strk.mem = NULL;
+  return self;
+}
+
+void stroke_unmap(stroke_map_t* self) {
+  munmap(self->addr, self->len);
+  bzero(self, sizeof(stroke_map_t));
+  free(self);
+}
+
+int stroke_text_to_bin(const char* text_fname, const char* bin_fname) {
+  stroke_t* strk = stroke_from_file(text_fname);
+  if (strk == NULL) {
+    return 0;
+  }
+  int ok = stroke_save_bin(strk, bin_fname);
+  stroke_destroy(strk);
+  return ok;
+}
+
+#undef _HEADER_SIZE
+
+/*! \} */
@@ -0,0 +1,149 @@
+/*!
+ * \addtogroup common
+ * \{
+ *
+ * \file stroke_bin.h
+ * A versioned, binary, memory-mappable stroke file format.
+ *
+ * A binary stroke file is laid out as follows (all values in host byte order,
+ * which is recorded in the header):
+ *
+ * | Offset                | Contents                                   |
+ * |-----------------------|--------------------------------------------|
+ * | 0                     | `stroke_bin_header_t`                      |
+ * | `header_size`         | `stride` X-coordinates (`double`)          |
+ * | `+ 8 * stride`        | `stride` Y-coordinates (`double`)          |
+ * | `+ 16 * stride`       | `stride` times (`int64_t`)                 |
+ *
+ * `stride` is `num` padded to a multiple of `STROKE_SOA_PAD` and
+ * `header_size` is a multiple of `STROKE_SOA_ALIGN`, so every column of a
+ * mapped file is aligned exactly like a `stroke_soa_t`'s.  This lets
+ * `stroke_map()` return a view straight over the file with no parsing or
+ * copying.
+ */
+
+#ifndef __stroke_bin_h__
+#define __stroke_bin_h__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "stroke.h"
+#include "stroke_soa.h"
+
+//! The magic bytes at the start of every binary stroke file.
+#define STROKE_BIN_MAGIC "SRKB"
+
+//! The current version of the binary stroke format.
+#define STROKE_BIN_VERSION 1
+
+//! Written to `stroke_bin_header_t.bom` to detect the file's byte order.
+#define STROKE_BIN_BOM 0x01020304
+
+/*! The fields every binary header in this library starts with.  Headers that
+ * are checked with `stroke_bin_check_preamble()` must begin with exactly
+ * these fields.
+ */
+typedef struct {
+  char magic[4];          //!< The format's magic bytes.
+  uint32_t version;       //!< Format version.
+  uint32_t bom;           //!< Always `STROKE_BIN_BOM` in the writer's order.
+  uint32_t header_size;   //!< Offset of the first column in bytes.
+} stroke_bin_preamble_t;
+
+//! The header of a binary stroke file.
+typedef struct {
+  char magic[4];          //!< Always `STROKE_BIN_MAGIC`.
+  uint32_t version;       //!< Format version; `STROKE_BIN_VERSION`.
+  uint32_t bom;           //!< Always `STROKE_BIN_BOM` in the writer's order.
+  uint32_t header_size;   //!< Offset of the first column in bytes.
+  uint64_t num;           //!< Number of points.
+  uint64_t stride;        //!< Number of elements in each column.
+} stroke_bin_header_t;
+
+/*! A read-only stroke mapped from a binary stroke file.  Create with
+ * [\ref stroke_map(const char*)] and release with
+ * [\ref stroke_unmap(stroke_map_t*)].
+ */
+typedef struct {
+  stroke_soa_t strk;      //!< The view; its columns point into the mapping.
+  void* addr;             //!< Start of the mapping.
+  size_t len;             //!< Length of the mapping in bytes.
+} stroke_map_t;
+
+/*! Writes `num` doubles of a column, then zeros up to `stride` elements, so
+ * that the next column starts as aligned as this one.
+ *
+ * \param fp The file to write to.
+ * \param col The column.
+ * \param num The number of elements in the column.
+ * \param stride The number of elements to write.
+ *
+ * \return 1 on success, 0 o.w.
+ */
+int stroke_bin_write_column(FILE* fp, const void* col, uint64_t num,
+                            uint64_t stride);
+
+/*! Checks the preamble of a binary header: its magic bytes, byte order and
+ * version, and that `header_size` is aligned and within the file.
+ *
+ * \param header The header; it starts with a `stroke_bin_preamble_t`.
+ * \param magic The expected magic bytes.
+ * \param version The expected version.
+ * \param min_size The size of the full header struct.
+ * \param len The length of the file.
+ * \param kind What the file should be (for error messages).
+ * \param fname The name of the file (for error messages).
+ *
+ * \return 1 if valid, 0 o.w.
+ */
+int stroke_bin_check_preamble(const void* header, const char* magic,
+                              uint32_t version, size_t min_size, size_t len,
+                              const char* kind, const char* fname);
+
+/*! Saves a SoA stroke to disk in the binary stroke format.
+ *
+ * \param self The stroke to save.
+ * \param fname The file to save it to.
+ *
+ * \return 1 on success, 0 o.w.
+ */
+int stroke_soa_save_bin(const stroke_soa_t* self, const char* fname);
+
+/*! Saves a stroke to disk in the binary stroke format.
+ *
+ * \param self The stroke to save.
+ * \param fname The file to save it to.
+ *
+ * \return 1 on success, 0 o.w.
+ */
+int stroke_save_bin(const stroke_t* self, const char* fname);
+
+/*! Maps a binary stroke file into memory.  The header is validated, but the
+ * points are neither parsed nor copied.  The view must not be modified or
+ * passed to `stroke_soa_destroy()`.
+ *
+ * \param fname The name of the file to map.
+ *
+ * \return The mapped stroke, or \c NULL on error.
+ */
+stroke_map_t* stroke_map(const char* fname);
+
+/*! Unmaps a stroke mapped with [\ref stroke_map(const char*)].
+ *
+ * \param self The mapped stroke.
+ */
+void stroke_unmap(stroke_map_t* self);
+
+/*! Converts a stroke saved with `stroke_save()` into the binary stroke format.
+ *
+ * \param text_fname The text file to read.
+ * \param bin_fname The binary file to write.
+ *
+ * \return 1 on success, 0 o.w.
+ */
+int stroke_text_to_bin(const char* text_fname, const char* bin_fname);
+
+#endif  // __stroke_bin_h__
+
+/*! \} */
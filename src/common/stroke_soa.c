@@ -0,0 +1,256 @@
+/*!
+ * \addtogroup common
+ * \{
+ *
+ * \file stroke_soa.c
+ * Implementation of interface defined in stroke_soa.h.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <values.h>
+
+#include "stroke_soa.h"
+#include "util.h"
+
+
+
+/*! Rounds `num` up to a valid column size.
+ *
+ * \param num The number of points needed.
+ *
+ * \return The padded size; at least `STROKE_SOA_PAD`.
+ */
+static inline long _padded(long num) {
+  if (num < 1) {
+    num = 1;
+  }
+  return (num + STROKE_SOA_PAD - 1) / STROKE_SOA_PAD * STROKE_SOA_PAD;
+}
+
+/*! Allocates (zeroed) columns of the given size and points `self`'s columns at
+ * them.  Does not free the old columns.
+ *
+ * \param self The stroke.
+ * \param size The column size; must be a multiple of `STROKE_SOA_PAD`.
+ *
+ * \return 1 on success, 0 o.w.
+ */
+static inline int _alloc_columns(stroke_soa_t* self, long size) {
+  assert(size % STROKE_SOA_PAD == 0);
+  assert(sizeof(long) == sizeof(double));
+
+  void* mem = NULL;
+  const size_t bytes = 3 * size * sizeof(double);
+  if (posix_memalign(&mem, STROKE_SOA_ALIGN, bytes)) {
+    fprintf(stderr, "Error: could not allocate %zd bytes.\n", bytes);
+    return 0;
+  }
+  bzero(mem, bytes);
+
+  self->mem = mem;
+  self->size = size;
+  self->x = (double*)mem;
+  self->y = self->x + size;
+  self->t = (long*)(self->y + size);
+  return 1;
+}
+
+stroke_soa_t* stroke_soa_create(long size) {
+  stroke_soa_t* self = calloc(1, sizeof(stroke_soa_t));
+  if (!_alloc_columns(self, _padded(size))) {
+    free(self);
+    return NULL;
+  }
+  return self;
+}
+
+stroke_soa_t* stroke_soa_from_stroke(const stroke_t* strk) {
+  stroke_soa_t* self = stroke_soa_create(strk->num);
+  if (self == NULL) {
+    return NULL;
+  }
+
+  for (long i = 0; i < strk->num; i++) {
+    self->x[i] = strk->pts[i].x;
+    self->y[i] = strk->pts[i].y;
+    self->t[i] = strk->pts[i].t;
+  }
+  self->num = strk->num;
+  return self;
+}
+
+stroke_t* stroke_soa_to_stroke(const stroke_soa_t* self) {
+  stroke_t* strk = stroke_create(self->num);
+  for (long i = 0; i < self->num; i++) {
+    strk->pts[i].x = self->x[i];
+    strk->pts[i].y = self->y[i];
+    strk->pts[i].t = self->t[i];
+    strk->pts[i].i = i;
+  }
+  strk->num = self->num;
+  return strk;
+}
+
+stroke_soa_t* stroke_soa_clone(const stroke_soa_t* self) {
+  stroke_soa_t* clone = stroke_soa_create(self->num);
+  if (clone == NULL) {
+    return NULL;
+  }
+
+  memcpy(clone->x, self->x, self->num * sizeof(double));
+  memcpy(clone->y, self->y, self->num * sizeof(double));
+  memcpy(clone->t, self->t, self->num * sizeof(long));
+  clone->num = self->num;
+  return clone;
+}
+
+void stroke_soa_add_timed(stroke_soa_t* self, double x, double y, long t) {
+  if (self->num >= self->size || self->mem == NULL) {
+    stroke_soa_t old = *self;
+    if (!_alloc_columns(self, _padded(MAX(2 * old.size, self->num + 1)))) {
+      *self = old;
+      return;
+    }
+    memcpy(self->x, old.x, old.num * sizeof(double));
+    memcpy(self->y, old.y, old.num * sizeof(double));
+    memcpy(self->t, old.t, old.num * sizeof(long));
+    free(old.mem);
+  }
+
+  self->x[self->num] = x;
+  self->y[self->num] = y;
+  self->t[self->num] = t;
+  self->num++;
+}
+
+void stroke_soa_destroy(stroke_soa_t* self) {
+  free(self->mem);
+  bzero(self, sizeof(stroke_soa_t));
+  free(self);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ------------------------------- Primitives ------------------------------- //
+////////////////////////////////////////////////////////////////////////////////
+
+// The loops below are written against local, `restrict`-qualified column
+// pointers with no early exits so the compiler can vectorize them.
+
+double stroke_soa_path_length(const stroke_soa_t* self) {
+  const double* restrict x = self->x;
+  const double* restrict y = self->y;
+  double len = 0;
+  for (long i = 1; i < self->num; i++) {
+    const double dx = x[i] - x[i-1];
+    const double dy = y[i] - y[i-1];
+    len += sqrt(dx * dx + dy * dy);
+  }
+  return len;
+}
+
+void stroke_soa_bbox(const stroke_soa_t* self, point2d_t* min, point2d_t* max) {
+  if (self->num <= 0) {
+    min->x = min->y = max->x = max->y = 0;
+    return;
+  }
+
+  const double* restrict x = self->x;
+  const double* restrict y = self->y;
+  double min_x = x[0], min_y = y[0];
+  double max_x = x[0], max_y = y[0];
+  for (long i = 1; i < self->num; i++) {
+    min_x = x[i] < min_x ? x[i] : min_x;
+    min_y = y[i] < min_y ? y[i] : min_y;
+    max_x = x[i] > max_x ? x[i] : max_x;
+    max_y = y[i] > max_y ? y[i] : max_y;
+  }
+  min->x = min_x;
+  min->y = min_y;
+  max->x = max_x;
+  max->y = max_y;
+}
+
+void stroke_soa_centroid(const stroke_soa_t* self, point2d_t* c) {
+  if (self->num <= 0) {
+    c->x = c->y = 0;
+    return;
+  }
+
+  const double* restrict x = self->x;
+  const double* restrict y = self->y;
+  double sum_x = 0, sum_y = 0;
+  for (long i = 0; i < self->num; i++) {
+    sum_x += x[i];
+    sum_y += y[i];
+  }
+  c->x = sum_x / self->num;
+  c->y = sum_y / self->num;
+}
+
+void stroke_soa_translate(stroke_soa_t* self, double dx, double dy) {
+  double* restrict x = self->x;
+  double* restrict y = self->y;
+  for (long i = 0; i < self->num; i++) {
+    x[i] += dx;
+    y[i] += dy;
+  }
+}
+
+void stroke_soa_scale(stroke_soa_t* self, double s) {
+  double* restrict x = self->x;
+  double* restrict y = self->y;
+  for (long i = 0; i < self->num; i++) {
+    x[i] *= s;
+    y[i] *= s;
+  }
+}
+
+void stroke_soa_sq_dists(const stroke_soa_t* self, double px, double py,
+                         double* out) {
+  const double* restrict x = self->x;
+  const double* restrict y = self->y;
+  double* restrict o = out;
+  for (long i = 0; i < self->num; i++) {
+    const double dx = x[i] - px;
+    const double dy = y[i] - py;
+    o[i] = dx * dx + dy * dy;
+  }
+}
+
+void stroke_soa_sq_dist_matrix(const stroke_soa_t* a, const stroke_soa_t* b,
+                               double* out, double* out_t) {
+  const long m = a->num;
+  const long n = b->num;
+  const double* restrict bx = b->x;
+  const double* restrict by = b->y;
+  for (long ib = 0; ib < m; ib += STROKE_SOA_TILE) {
+    const long ie = MIN(ib + STROKE_SOA_TILE, m);
+    for (long jb = 0; jb < n; jb += STROKE_SOA_TILE) {
+      const long je = MIN(jb + STROKE_SOA_TILE, n);
+      for (long i = ib; i < ie; i++) {
+        const double px = a->x[i];
+        const double py = a->y[i];
+        double* restrict row = out + i * n;
+        for (long j = jb; j < je; j++) {
+          const double dx = bx[j] - px;
+          const double dy = by[j] - py;
+          row[j] = dx * dx + dy * dy;
+        }
+      }
+      if (out_t) {
+        for (long j = jb; j < je; j++) {
+          for (long i = ib; i < ie; i++) {
+            out_t[j * m + i] = out[i * n + j];
+          }
+        }
+      }
+    }
+  }
+}
+
+/*! \} */
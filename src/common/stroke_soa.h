@@ -0,0 +1,204 @@
+/*!
+ * \addtogroup common
+ * \{
+ *
+ * \file stroke_soa.h
+ * Creates an object-like `stroke_soa_t` structure: a stroke stored as a
+ * structure of arrays.
+ *
+ * A `stroke_t` interleaves \c x, \c y, \c t, and \c i in every `point_t`, but
+ * most hot loops only read \c x and \c y, so half of every cache line they
+ * touch is wasted.  A `stroke_soa_t` stores each coordinate in its own aligned,
+ * padded column instead, so that loops over a column are contiguous and can be
+ * auto-vectorized by the compiler.
+ *
+ * Use `stroke_soa_from_stroke()` and `stroke_soa_to_stroke()` to convert
+ * between the two representations.
+ */
+
+#ifndef __stroke_soa_h__
+#define __stroke_soa_h__
+
+#include "point.h"
+#include "stroke.h"
+
+//! Alignment (in bytes) of every column in a `stroke_soa_t`.
+#define STROKE_SOA_ALIGN 64
+
+//! Columns are padded to a multiple of this many elements.
+#define STROKE_SOA_PAD (STROKE_SOA_ALIGN / sizeof(double))
+
+/*! A stroke stored as a structure of arrays.
+ *
+ * Each column holds `size` elements (a multiple of `STROKE_SOA_PAD`) and starts
+ * on a `STROKE_SOA_ALIGN`-byte boundary.  Elements past `num` are zero.  The
+ * index of a point is its position in the columns.
+ */
+typedef struct {
+  long num;      //!< Number of points.
+  long size;     //!< Capacity of each column.
+  double* x;     //!< The X-coordinates.
+  double* y;     //!< The Y-coordinates.
+  long* t;       //!< The times.
+  void* mem;     //!< Block owning the columns; \c NULL if not owned.
+} stroke_soa_t;
+
+/*! Creates a stroke with no points and room for at least `size` points.  The
+ * caller must call [\ref stroke_soa_destroy(stroke_soa_t*)] to free it.
+ *
+ * \param size The number of points to make room for.
+ *
+ * \return The (empty) stroke.
+ */
+stroke_soa_t* stroke_soa_create(long size);
+
+/*! Creates a SoA copy of a stroke.
+ *
+ * \param strk The stroke to copy.
+ *
+ * \return The new stroke.
+ */
+stroke_soa_t* stroke_soa_from_stroke(const stroke_t* strk);
+
+/*! Creates a `stroke_t` copy of a SoA stroke.  Point indices are set to their
+ * position in the stroke.
+ *
+ * \param self The stroke to copy.
+ *
+ * \return The new stroke; must be freed with `stroke_destroy()`.
+ */
+stroke_t* stroke_soa_to_stroke(const stroke_soa_t* self);
+
+/*! Performs a deep copy of the stroke.
+ *
+ * \param self The stroke to clone.
+ *
+ * \return The clone.
+ */
+stroke_soa_t* stroke_soa_clone(const stroke_soa_t* self);
+
+/*! Adds a point to the end of the stroke, growing it if necessary.
+ *
+ * \param self The stroke to add to.
+ * \param x The X-coordinate.
+ * \param y The Y-coordinate.
+ * \param t The time of the point.
+ */
+void stroke_soa_add_timed(stroke_soa_t* self, double x, double y, long t);
+
+/*! Destroys the stroke, freeing its columns if it owns them.
+ *
+ * \param self The stroke to destroy.
+ */
+void stroke_soa_destroy(stroke_soa_t* self);
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ------------------------------- Primitives ------------------------------- //
+////////////////////////////////////////////////////////////////////////////////
+
+/*! Finds the length of the path along the stroke.
+ *
+ * \param self The stroke.
+ *
+ * \return The length along the stroke.
+ */
+double stroke_soa_path_length(const stroke_soa_t* self);
+
+/*! Finds the bounding box of the stroke.  An empty stroke has the bounding box
+ * \f$(0,0)\f$-\f$(0,0)\f$.
+ *
+ * \param self The stroke.
+ * \param min The minimum X and Y coordinates.
+ * \param max The maximum X and Y coordinates.
+ */
+void stroke_soa_bbox(const stroke_soa_t* self, point2d_t* min, point2d_t* max);
+
+/*! Finds the centroid (the mean point) of the stroke.  An empty stroke has its
+ * centroid at \f$(0,0)\f$.
+ *
+ * \param self The stroke.
+ * \param c The centroid.
+ */
+void stroke_soa_centroid(const stroke_soa_t* self, point2d_t* c);
+
+/*! Moves every point in the stroke by \f$(dx,dy)\f$.
+ *
+ * \param self The stroke.
+ * \param dx The amount to move in X.
+ * \param dy The amount to move in Y.
+ */
+void stroke_soa_translate(stroke_soa_t* self, double dx, double dy);
+
+/*! Scales every point in the stroke by `s` about the origin.
+ *
+ * \param self The stroke.
+ * \param s The scale factor.
+ */
+void stroke_soa_scale(stroke_soa_t* self, double s);
+
+/*! Computes the squared distance from \f$(x,y)\f$ to every point in the stroke.
+ *
+ * \param self The stroke.
+ * \param x The X-coordinate of the point.
+ * \param y The Y-coordinate of the point.
+ * \param out Gets the `self->num` squared distances.
+ */
+void stroke_soa_sq_dists(const stroke_soa_t* self, double x, double y,
+                         double* out);
+
+//! Edge length of the tiles `stroke_soa_sq_dist_matrix()` works in.
+#define STROKE_SOA_TILE 16
+
+/*! Computes the squared distance between every point in `a` and every point in
+ * `b`.  `out[i * b->num + j]` gets the squared distance between the `i`th point
+ * of `a` and the `j`th point of `b`.  If `out_t` is not \c NULL, it gets the
+ * transpose of `out`, so that both directions can be read row by row.
+ *
+ * The matrix is filled in `STROKE_SOA_TILE` square tiles so that the rows of
+ * `out` and `out_t` written by a tile stay in cache together.
+ *
+ * \param a A stroke.
+ * \param b Another stroke.
+ * \param out Gets the `a->num` by `b->num` matrix.
+ * \param out_t If not \c NULL, gets the `b->num` by `a->num` transpose.
+ */
+void stroke_soa_sq_dist_matrix(const stroke_soa_t* a, const stroke_soa_t* b,
+                               double* out, double* out_t);
+
+/*! Computes the squared distance between the `i`th point in `a` and the `j`th
+ * point in `b`.
+ *
+ * \param a A stroke.
+ * \param i The index of the point in `a`.
+ * \param b Another stroke.
+ * \param j The index of the point in `b`.
+ *
+ * \return The squared distance.
+ */
+static inline double stroke_soa_sq_distance(
+    const stroke_soa_t* a, long i, const stroke_soa_t* b, long j) {
+  const double dx = a->x[i] - b->x[j];
+  const double dy = a->y[i] - b->y[j];
+  return dx * dx + dy * dy;
+}
+
+/*! Computes the distance between the `i`th point in `a` and the `j`th point in
+ * `b`.
+ *
+ * \param a A stroke.
+ * \param i The index of the point in `a`.
+ * \param b Another stroke.
+ * \param j The index of the point in `b`.
+ *
+ * \return The distance.
+ */
+static inline double stroke_soa_distance(
+    const stroke_soa_t* a, long i, const stroke_soa_t* b, long j) {
+  return sqrt(stroke_soa_sq_distance(a, i, b, j));
+}
+
+#endif  // __stroke_soa_h__
+
+/*! \} */
@@ -1,146 +1,465 @@
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <values.h>
 
 #include "common/geom.h"
+#include "common/srz.h"
 #include "dollarp.h"
 
 /*! Moves the stroke to be centered at the origin, \f$(0,0)\f$.
  *
  * \param strk The stroke.
  */
-static inline void _translate_to_origin(stroke_t* strk) {
+static inline void _translate_to_origin(stroke_soa_t* strk) {
   EN("_translate_to_origin(strk<%ld>)\n", strk->num);
-  point2d_t c = { 0, 0 };
-  for (int i = 0; i < strk->num; i++) {
-    c.x += strk->pts[i].x;
-    c.y += strk->pts[i].y;
-  }
-
-  c.x /= strk->num;
-  c.y /= strk->num;
-
-  for (int i = 0; i < strk->num; i++) {
-    strk->pts[i].x -= c.x;
-    strk->pts[i].y -= c.y;
-  }
+  point2d_t c;
+  stroke_soa_centroid(strk, &c);
+  stroke_soa_translate(strk, -c.x, -c.y);
   EX("_translate_to_origin(strk<%ld>)\n", strk->num);
 }
 
-/*! Scales the stroke, i.e., normalizes the size.
+/*! Scales the stroke, i.e., normalizes the size.  A stroke with no extent (one
+ * point, or all its points the same) is only translated.
  *
  * \param strk The stroke to normalize.
  */
-static inline void _scale(stroke_t* strk) {
+static inline void _scale(stroke_soa_t* strk) {
   EN("_scale(strk<%ld>)\n", strk->num);
-  point2d_t min = { DBL_MAX, DBL_MAX };
-  point2d_t max = { 0, 0 };
-
-  for (int i = 0; i < strk->num; i++) {
-    min.x = MIN(min.x, strk->pts[i].x);
-    min.y = MIN(min.y, strk->pts[i].y);
-    max.x = MAX(max.x, strk->pts[i].x);
-    max.y = MAX(max.y, strk->pts[i].y);
-  }
+  point2d_t min, max;
+  stroke_soa_bbox(strk, &min, &max);
 
   double scale = MAX(max.x - min.x, max.y - min.y);
-  for (int i = 0; i < strk->num; i++) {
-    strk->pts[i].x = (strk->pts[i].x - min.x) / scale;
-    strk->pts[i].y = (strk->pts[i].y - min.y) / scale;
+  stroke_soa_translate(strk, -min.x, -min.y);
+  if (scale > 0) {
+    stroke_soa_scale(strk, 1 / scale);
   }
   EX("_scale(strk<%ld>)\n", strk->num);
 }
 
-/*! Finds the length of the path along the stroke.
+/*! Read-only points, either from a `stroke_t` or a `stroke_soa_t`: the `i`th
+ * point's coordinates are `stride` bytes after the `i-1`th's.
+ */
+typedef struct {
+  const double* x;        //!< The first X-coordinate.
+  const double* y;        //!< The first Y-coordinate.
+  const long* t;          //!< The first time, or \c NULL if there are none.
+  size_t stride;          //!< Bytes between consecutive points.
+  long num;               //!< Number of points.
+} _dp_pts_t;
+
+//! The `i`th element of `col`, `stride` bytes apart.
+#define _AT(col, i, stride) \
+  (*(typeof(col))((const char*)(col) + (i) * (stride)))
+
+/*! Views the points of a stroke.
+ *
+ * \param strk The stroke.
+ *
+ * \return The points.
+ */
+static inline _dp_pts_t _stroke_pts(const stroke_t* strk) {
+  _dp_pts_t pts = {
+    &strk->pts[0].x, &strk->pts[0].y, &strk->pts[0].t, sizeof(point_t),
+    strk->num
+  };
+  return pts;
+}
+
+/*! Views the points of a SoA stroke.
+ *
  * \param strk The stroke.
- * \return The length along the stroke.
+ *
+ * \return The points.
+ */
+static inline _dp_pts_t _soa_pts(const stroke_soa_t* strk) {
+  _dp_pts_t pts = { strk->x, strk->y, strk->t, sizeof(double), strk->num };
+  return pts;
+}
+
+/*! Finds the length of the path along the points.
+ *
+ * \param pts The points.
+ *
+ * \return The length along the points.
  */
-static inline double _path_length(const stroke_t* strk) {
-  EN("_path_length(strk<%ld>)\n", strk->num);
+static inline double _path_length(const _dp_pts_t* pts) {
+  const size_t stride = pts->stride;
   double len = 0;
-  debug("Should do %ld iterations ...\n", strk->num - 1);
-  for (int i = 1; i < strk->num; i++) {
-    debug("%d: comparing (%.2f,%.2f) & (%.2f,%.2f)\n", i,
-        strk->pts[i].p2d.x, strk->pts[i].p2d.y,
-        strk->pts[i-i].p2d.x, strk->pts[i-1].p2d.y);
-    double delta = point2d_distance(&strk->pts[i].p2d, &strk->pts[i-1].p2d);
-    len += delta;
-    debug("    +%.2f = %.2f\n", delta, len);
-  }
-  EX("_path_length(strk<%ld>):%.2f\n", strk->num, len);
+  for (long i = 1; i < pts->num; i++) {
+    const double dx = _AT(pts->x, i, stride) - _AT(pts->x, i-1, stride);
+    const double dy = _AT(pts->y, i, stride) - _AT(pts->y, i-1, stride);
+    len += sqrt(dx * dx + dy * dy);
+  }
   return len;
 }
 
-/*! Resamples the stroke to have `n` points.
- *
- * The passed stroke is resampled inline.  If the passed stroke does not have at
- * least 2 points, this returns without doing anything.
+/*! A walk along the points of one or more strokes that resamples them into
+ * `n` equidistant points; see `_resample()`.  The distance walked since the
+ * last resampled point carries over from one stroke to the next, but the gaps
+ * between strokes are not walked.
+ */
+typedef struct {
+  stroke_soa_t* out;      //!< Gets the resampled points.
+  int* ids;               //!< Gets the stroke of each point, or \c NULL.
+  int n;                  //!< The number of points to resample to.
+  int k;                  //!< The number of points resampled so far.
+  double I;               //!< The distance between resampled points.
+  double D;               //!< The distance walked since the last one.
+} _dp_walk_t;
+
+/*! Starts a walk at the first of the points.
  *
- * \param strk The stroke to resample.
- * \param n The number of points the stroke should have.
+ * \param w The walk.
+ * \param pts The first (non-empty) stroke's points.
+ * \param id The ID of the stroke.
+ * \param n The number of points to resample to.
+ * \param len The length of the path along every stroke.
+ * \param out Gets the resampled points; must have room for `n` points.
+ * \param ids Gets the stroke ID of each resampled point, or \c NULL.
  */
-static inline void _resample(stroke_t* strk, int n) {
-  EN("_resample(strk<%ld>, %d)\n", strk->num, n);
+static inline void _walk_begin(_dp_walk_t* w, const _dp_pts_t* pts, int id,
+                               int n, double len, stroke_soa_t* out,
+                               int* ids) {
+  assert(out->size >= n);
+  w->out = out;
+  w->ids = ids;
+  w->n = n;
+  w->I = len / (n - 1);
+  w->D = 0;
+  debug("I:%.2f  D:%.2f\n", w->I, w->D);
 
-  if (strk->num < 2) {
-    debug("Too few elements in strk.  Returning.\n");
-    return;
+  out->x[0] = pts->x[0];
+  out->y[0] = pts->y[0];
+  out->t[0] = pts->t ? pts->t[0] : 0;
+  if (ids) {
+    ids[0] = id;
   }
+  w->k = 1;
+}
+
+/*! Walks along a stroke's points, resampling every point that falls on them.
+ *
+ * \param w The walk.
+ * \param pts The stroke's points.
+ * \param id The ID of the stroke.
+ */
+static inline void _walk(_dp_walk_t* w, const _dp_pts_t* pts, int id) {
+  double* restrict x = w->out->x;
+  double* restrict y = w->out->y;
+  long* restrict t = w->out->t;
+  const size_t stride = pts->stride;
+  const long* in_t = pts->t;
+  const int n = w->n;
+  const double I = w->I;
+  double D = w->D;
+  int k = w->k;
+
+  double px = pts->x[0];
+  double py = pts->y[0];
+  for (long i = 1; i < pts->num && k < n - 1; i++) {
+    const double cx = _AT(pts->x, i, stride);
+    const double cy = _AT(pts->y, i, stride);
+    const long ct = in_t ? _AT(in_t, i, stride) : 0;
+    double d = sqrt((cx - px) * (cx - px) + (cy - py) * (cy - py));
 
-  double I = _path_length(strk) / (n - 1);
-  double D = 0;
-  debug("I:%.2f  D:%.2f\n", I, D);
-
-  stroke_t* r_strk = stroke_create(n);
-  stroke_add_coords(r_strk, strk->pts[0].x, strk->pts[0].y);
-  debug("Added coords: %.2f, %.2f\n", strk->pts[0].x, strk->pts[0].y);
-  for (int i = 1; i < strk->num; i++) {
-    point2d_t* curr = &strk->pts[i].p2d;
-    point2d_t* prev = &strk->pts[i-1].p2d;
-    debug("%d: curr:(%.2f,%.2f)  prev:(%.2f,%.2f)\n",
-        i, curr->x, curr->y, prev->x, prev->y);
-    double d = point2d_distance(curr, prev);
-    debug("  d:%.2f\n", d);
-    if (D + d >= I) {
-      point2d_t q = {
-        prev->x + ((I - D) / d) * (curr->x - prev->x),
-        prev->y + ((I - D) / d) * (curr->y - prev->y)
-      };
-      debug("  q:(%.2f,%.2f)\n", q.x, q.y);
-
-      stroke_add_coords(r_strk, q.x, q.y);
+    // Emit every sample that falls on the segment prev->curr.
+    while (D + d >= I && d > 0 && k < n - 1) {
+      const double r = (I - D) / d;
+      px += r * (cx - px);
+      py += r * (cy - py);
+      if (w->ids) {
+        w->ids[k] = id;
+      }
+      x[k] = px;
+      y[k] = py;
+      t[k++] = ct;
+      debug("  q:(%.2f,%.2f)\n", px, py);
+
+      d = sqrt((cx - px) * (cx - px) + (cy - py) * (cy - py));
       D = 0;
+    }
+    D += d;
+    px = cx;
+    py = cy;
+  }
 
-      // Set up for the next curr/prev pair to be q and i-1.
-      stroke_insert_at(strk, i, q.x, q.y);
-      i--;
-    } else {
-      D += d;
+  w->D = D;
+  w->k = k;
+}
+
+/*! Ends a walk, filling in any points lost to floating point error with the
+ * last of the points.
+ *
+ * \param w The walk.
+ * \param pts The last (non-empty) stroke's points.
+ * \param id The ID of the stroke.
+ */
+static inline void _walk_end(_dp_walk_t* w, const _dp_pts_t* pts, int id) {
+  stroke_soa_t* out = w->out;
+  const size_t stride = pts->stride;
+  const long last = pts->num - 1;
+  for (; w->k < w->n; w->k++) {
+    out->x[w->k] = _AT(pts->x, last, stride);
+    out->y[w->k] = _AT(pts->y, last, stride);
+    out->t[w->k] = pts->t ? _AT(pts->t, last, stride) : 0;
+    if (w->ids) {
+      w->ids[w->k] = id;
     }
-    debug("  D:%.2f\n", D);
+  }
+  out->num = w->n;
+}
+
+/*! Resamples the points into `n` equidistant points.
+ *
+ * Walks the points once, given their length, writing exactly `n` points into
+ * `out`, which must have room for them.  The input is not modified.  Points
+ * lost to floating point error at the end of the path are filled in with the
+ * last point.  No points resample to an empty cloud.
+ *
+ * \param pts The points to resample.
+ * \param n The number of points to resample to.
+ * \param len The length of the path along the points; see `_path_length()`.
+ * \param out Gets the resampled points.
+ */
+static inline void
+_resample(const _dp_pts_t* pts, int n, double len, stroke_soa_t* out) {
+  EN("_resample(pts<%ld>, %d)\n", pts->num, n);
+  out->num = 0;
+  if (pts->num < 1) {
+    debug("Too few elements in pts.  Returning.\n");
+    EX("_resample(pts<%ld>, %d)\n", pts->num, n);
+    return;
   }
 
-  // Copy the computed resampled stroke to the input stroke and clean up.
-  memcpy(strk, r_strk, sizeof(stroke_t));
-  stroke_destroy(r_strk);
-  EX("_resample(strk<%ld>, %d)\n", strk->num, n);
+  _dp_walk_t w;
+  _walk_begin(&w, pts, 0, n, len, out, NULL);
+  _walk(&w, pts, 0);
+  _walk_end(&w, pts, 0);
+  EX("_resample(pts<%ld>, %d)\n", pts->num, n);
 }
 
+#undef _AT
+
 /*! "Normalizes" the stroke to have just `n` points in it centered at the
- * origin.  Note that this mutates `strk`.
+ * origin, given the length of its path.
  *
  * \param strk The stroke to normalize
+ * \param len The length of the stroke's path; see `_path_length()`.
  * \param n The number of points to keep in the stroke.
+ * \param cloud Gets the normalized point cloud; must have room for `n` points.
  */
-static inline void _normalize(stroke_t* strk, int n) {
+static inline void _normalize_len(const stroke_t* strk, double len, int n,
+                                  stroke_soa_t* cloud) {
   EN("_normalize(strk<%ld>, %d)\n", strk->num, n);
-  _resample(strk, n);
-  _scale(strk);
-  _translate_to_origin(strk);
+  const _dp_pts_t pts = _stroke_pts(strk);
+  _resample(&pts, n, len, cloud);
+  _scale(cloud);
+  _translate_to_origin(cloud);
   EX("_normalize(strk<%ld>, %d)\n", strk->num, n);
 }
 
+/*! "Normalizes" the stroke to have just `n` points in it centered at the
+ * origin.
+ *
+ * \param strk The stroke to normalize
+ * \param n The number of points to keep in the stroke.
+ * \param cloud Gets the normalized point cloud; must have room for `n` points.
+ */
+static inline void
+_normalize(const stroke_t* strk, int n, stroke_soa_t* cloud) {
+  const _dp_pts_t pts = _stroke_pts(strk);
+  _normalize_len(strk, _path_length(&pts), n, cloud);
+}
+
+/*! "Normalizes" several strokes, as one, to have just `n` points in them
+ * centered at the origin.  The strokes are walked in place, one after the
+ * other, as $P walks a multistroke's points; the gaps between them are not
+ * part of the path.  One stroke normalizes just as with `_normalize()`.
+ *
+ * \param strks The strokes to normalize.
+ * \param num The number of strokes.
+ * \param n The number of points to keep in the strokes.
+ * \param cloud Gets the normalized point cloud; must have room for `n` points.
+ * \param ids Gets the index (into `strks`) of the stroke each point of `cloud`
+ *   was resampled from, or \c NULL.
+ */
+static inline void
+_normalize_strokes(const stroke_t* const* strks, int num, int n,
+                   stroke_soa_t* cloud, int* ids) {
+  double len = 0;
+  int first = -1, last = -1;
+  for (int s = 0; s < num; s++) {
+    if (strks[s]->num > 0) {
+      const _dp_pts_t pts = _stroke_pts(strks[s]);
+      len += _path_length(&pts);
+      first = (first < 0) ? s : first;
+      last = s;
+    }
+  }
+  cloud->num = 0;
+  if (first < 0) {
+    return;
+  }
+
+  _dp_walk_t w;
+  _dp_pts_t pts = _stroke_pts(strks[first]);
+  _walk_begin(&w, &pts, first, n, len, cloud, ids);
+  for (int s = first; s <= last; s++) {
+    if (strks[s]->num > 0) {
+      pts = _stroke_pts(strks[s]);
+      _walk(&w, &pts, s);
+    }
+  }
+  pts = _stroke_pts(strks[last]);
+  _walk_end(&w, &pts, last);
+  _scale(cloud);
+  _translate_to_origin(cloud);
+}
+
+/*! Resamples a normalized cloud to `n` points and normalizes it again, for
+ * the coarse pass of the cascade.
+ *
+ * \param cloud The normalized cloud.
+ * \param n The number of points to resample to.
+ * \param coarse Gets the coarse cloud; must have room for `n` points.
+ */
+static inline void
+_coarsen(const stroke_soa_t* cloud, int n, stroke_soa_t* coarse) {
+  const _dp_pts_t pts = _soa_pts(cloud);
+  _resample(&pts, n, _path_length(&pts), coarse);
+  _scale(coarse);
+  _translate_to_origin(coarse);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Matching                                  //
+////////////////////////////////////////////////////////////////////////////////
+
+/*! Lower bounds are scaled by this before being compared to a score, so that
+ * rounding can never prune a template that would have matched.
+ */
+#define _DP_BOUND_SLACK (1 - 1e-9)
+
+//! Scratch space and counters for matching one query against the templates.
+typedef struct {
+  double* sq_dists;       //!< \f$2n^2\f$ squared distances and transpose.
+  double* mins;           //!< \f$2n\f$ nearest-point distances.
+  char* matched;          //!< `n` flags.
+  int* counts;            //!< Unmatched points in each grid cell.
+  const double* lut;      //!< The query's LUT, if `DP_PRUNE_LUT` is set.
+  const int* grid;        //!< The query's grid, if matching through grids.
+  size_t pruned;          //!< Templates skipped so far.
+  size_t abandoned;       //!< Alignments skipped or stopped early so far.
+} _dp_scratch_t;
+
+//! Number of bytes in a nearest-point LUT.
+#define _DP_LUT_BYTES (DP_LUT_SIZE * DP_LUT_SIZE * sizeof(double))
+
+/*! Fills in a nearest-point LUT (see `dp_template_t.lut`) for a cloud.
+ *
+ * \param cloud The normalized cloud.
+ * \param lut Gets the LUT.
+ */
+static void _lut_fill(const stroke_soa_t* cloud, double* lut) {
+  const double h = 2.0 / DP_LUT_SIZE;
+  for (int r = 0; r < DP_LUT_SIZE; r++) {
+    const double cy = -1 + (r + 0.5) * h;
+    for (int c = 0; c < DP_LUT_SIZE; c++) {
+      const double cx = -1 + (c + 0.5) * h;
+      double min = DBL_MAX;
+      for (long j = 0; j < cloud->num; j++) {
+        const double dx = cloud->x[j] - cx;
+        const double dy = cloud->y[j] - cy;
+        min = MIN(min, dx * dx + dy * dy);
+      }
+      lut[r * DP_LUT_SIZE + c] = sqrt(min);
+    }
+  }
+}
+
+/*! Builds a nearest-point LUT (see `dp_template_t.lut`) for a cloud.
+ *
+ * \param cloud The normalized cloud.
+ *
+ * \return The LUT; free with `free()`.
+ */
+static inline double* _lut_create(const stroke_soa_t* cloud) {
+  double* lut = malloc(_DP_LUT_BYTES);
+  _lut_fill(cloud, lut);
+  return lut;
+}
+
+/*! Finds a lower bound on the distance from a point to the nearest point of
+ * the cloud a LUT was built from.  Since the cell's center is `lut[cell]` from
+ * the cloud, the point is at least that, less its distance to the center.
+ *
+ * \param lut The LUT.
+ * \param x The X-coordinate of the point.
+ * \param y The Y-coordinate of the point.
+ *
+ * \return The lower bound.
+ */
+static inline double _lut_dist(const double* lut, double x, double y) {
+  const double h = 2.0 / DP_LUT_SIZE;
+  const int c = MAX(0, MIN(DP_LUT_SIZE - 1, (int)floor((x + 1) / h)));
+  const int r = MAX(0, MIN(DP_LUT_SIZE - 1, (int)floor((y + 1) / h)));
+  const double dx = x - (-1 + (c + 0.5) * h);
+  const double dy = y - (-1 + (r + 0.5) * h);
+  return MAX(0, lut[r * DP_LUT_SIZE + c] - sqrt(dx * dx + dy * dy));
+}
+
+/*! Finds a lower bound on `_cloud_dist()` from the distance of each point to
+ * its nearest neighbour, ignoring which points were already matched.
+ *
+ * \param mins The `n` nearest-neighbour distances.
+ * \param n The size of the clouds.
+ * \param start The start index of the alignment.
+ *
+ * \return The lower bound.
+ */
+static inline double _cloud_bound(const double* mins, int n, int start) {
+  const double w = 1.0 / n;
+  double sum = 0;
+  for (int k = 0; k < n - start; k++) {
+    sum += (1 - k * w) * mins[start + k];
+  }
+  for (int k = n - start; k < n; k++) {
+    sum += (1 - k * w) * mins[start + k - n];
+  }
+  return sum;
+}
+
+/*! Finds the smallest lower bound over every alignment tested by
+ * `_greedy_match()`.
+ *
+ * \param self The $P context.
+ * \param mins The \f$2n\f$ nearest-neighbour distances: `n` for each
+ *   direction.
+ *
+ * \return The lower bound.
+ */
+static inline double _match_bound(const dp_context_t* self,
+                                  const double* mins) {
+  const int n = self->n;
+  double min = DBL_MAX;
+  for (double i = 0; i < n; i += self->step) {
+    const int start = (int)round(i) % n;
+    min = MIN(min, _cloud_bound(mins, n, start));
+    min = MIN(min, _cloud_bound(mins + n, n, start));
+  }
+  return min;
+}
+
 /*! Finds the distance between two clouds.
  *
  * From the paper:
@@ -150,143 +469,2654 @@ static inline void _normalize(stroke_t* strk, int n) {
  * weights \f$\in [0,1]\f$ to point matchings.
  * </blockquote>
  *
- * \param c1 One point cloud.
- * \param c2 Another point cloud.
+ * Rather than the clouds themselves, this takes the matrix of squared distances
+ * between them, so that every alignment reuses the same distances.  Only the
+ * distance of each match is square rooted.
+ *
+ * Gives up as soon as the sum exceeds `bound`, since the alignment can no
+ * longer match it.
+ *
+ * \param sq_dists The `n` by `n` matrix of squared distances; row `i` holds
+ *   the squared distances from the `i`th point of one cloud to every point of
+ *   the other.
+ * \param n The size of the clouds.
  * \param start The start index to search from.
- * \param n The size of the strokes.
+ * \param bound The sum at which to give up.
+ * \param scr The scratch space.
  *
- * \return The distance between the clouds.
+ * \return The distance between the clouds, or a value greater than `bound` if
+ *   the alignment was abandoned.
  */
-static inline double
-_cloud_dist(const stroke_t* c1, const stroke_t* c2, int start) {
-  // Effective array of booleans.
-  int* matched = calloc(c1->num, sizeof(char));
+static inline double _cloud_dist(const double* sq_dists, int n, int start,
+                                 double bound, _dp_scratch_t* scr) {
+  char* matched = scr->matched;
+  memset(matched, 0, n);
   double sum = 0;
-  int i = 0;
-  int index = -1;
+  int i = start;
   do {
+    const double* restrict row = sq_dists + i * n;
     double min = DBL_MAX;
-    for (int j = 0; j < c1->num; j++) {
-      if (!matched[j]) {
-        double d = point2d_distance(&c1->pts[i].p2d, &c2->pts[j].p2d);
-        if (d < min) {
-          min = d;
-          index = j;
-        }
+    int index = -1;
+    for (int j = 0; j < n; j++) {
+      if (!matched[j] && row[j] < min) {
+        min = row[j];
+        index = j;
       }
     }
 
-    matched[index] = 1;
-    double weight = 1 - ((i - start + c1->num) % c1->num) / c1->num;
-    sum += weight * min;
-    i = (i + 1) % c1->num;
+    if (index >= 0) {  // else, no distance is a number.
+      matched[index] = 1;
+    }
+    double weight = 1 - ((i - start + n) % n) / (double)n;
+    sum += weight * sqrt(min);
+    i = (i + 1) % n;
+    if (sum > bound && i != start) {
+      scr->abandoned++;
+      break;
+    }
   } while (i != start);
 
   return sum;
 }
 
-/*! Attempt to match two point clouds.
+/*! Fills `scr->mins` with the distance from each point of one cloud to the
+ * nearest point of the other: the row minima of `scr->sq_dists`, then its
+ * column minima.
  *
- * From the article:
- * <blockquote>
- * Cloud matching function. Match two clouds (points and template) by performing
- * repeated alignments between their points (each new alignment starts with a
- * different starting point index \f$i\f$).  Parameter \f$\varepsilon \in
- * [0,1]\f$ controls the number of tested alignments (\f$n^\varepsilon \in \{1,
- * 2, \ldots, n\}\f$). Returns the minimum alignment cost.
- * </blockquote>
+ * \param scr The scratch space, with `sq_dists` filled in.
+ * \param n The size of the clouds.
+ */
+static inline void _nearest_dists(_dp_scratch_t* scr, int n) {
+  const double* restrict d = scr->sq_dists;
+  double* restrict rows = scr->mins;
+  double* restrict cols = scr->mins + n;
+  for (int j = 0; j < n; j++) {
+    cols[j] = DBL_MAX;
+  }
+  for (int i = 0; i < n; i++) {
+    double min = DBL_MAX;
+    for (int j = 0; j < n; j++) {
+      min = MIN(min, d[i * n + j]);
+      cols[j] = MIN(cols[j], d[i * n + j]);
+    }
+    rows[i] = min;
+  }
+  for (int i = 0; i < 2 * n; i++) {
+    rows[i] = sqrt(rows[i]);
+  }
+}
+
+/*! Defines `_cloud_dist_N()` and `_nearest_dists_N()`, versions of
+ * `_cloud_dist()` and `_nearest_dists()` for clouds of exactly `N` points.
+ * With `N` a constant the compiler can unroll and vectorize their loops.
+ * `_cloud_dist_N()` keeps the unmatched points in a `mask_t` bitmask (which
+ * lives in a register) instead of the scratch space, and visits only those
+ * points, which halves the comparisons of an alignment.  Points are still
+ * visited in order, so the results are identical.
  *
- * \param self The $P context.
- * \param c1 A point cloud to compare.
- * \param c2 Another point cloud to compare.
+ * \param N The number of points.
+ * \param mask_t An unsigned type with exactly `N` bits.
  */
-static inline double
-_greedy_cloud_match(const dp_context_t* self, const stroke_t* c1,
-                    const stroke_t* c2) {
-  assert(c1->num == c2->num);
+#define _DP_FIXED_N_KERNELS(N, mask_t)                                        \
+  static inline double _cloud_dist_##N(const double* sq_dists, int start,    \
+                                       double bound, _dp_scratch_t* scr) {   \
+    mask_t unmatched = ~(mask_t)0;                                            \
+    double sum = 0;                                                           \
+    int i = start;                                                            \
+    do {                                                                      \
+      const double* restrict row = sq_dists + i * N;                          \
+      double min = DBL_MAX;                                                   \
+      int index = 0;                                                          \
+      for (mask_t u = unmatched; u; u &= u - 1) {                             \
+        const int j = __builtin_ctzll(u);                                     \
+        if (row[j] < min) {                                                   \
+          min = row[j];                                                       \
+          index = j;                                                          \
+        }                                                                     \
+      }                                                                       \
+                                                                              \
+      unmatched &= ~((mask_t)1 << index);                                     \
+      double weight = 1 - ((i - start + N) % N) / (double)N;                  \
+      sum += weight * sqrt(min);                                              \
+      i = (i + 1) % N;                                                        \
+      if (sum > bound && i != start) {                                        \
+        scr->abandoned++;                                                     \
+        break;                                                                \
+      }                                                                       \
+    } while (i != start);                                                     \
+                                                                              \
+    return sum;                                                               \
+  }                                                                           \
+                                                                              \
+  static inline void _nearest_dists_##N(_dp_scratch_t* scr) {                \
+    const double* restrict d = scr->sq_dists;                                 \
+    double* restrict rows = scr->mins;                                        \
+    double* restrict cols = scr->mins + N;                                    \
+    for (int j = 0; j < N; j++) {                                             \
+      cols[j] = DBL_MAX;                                                      \
+    }                                                                         \
+    for (int i = 0; i < N; i++) {                                             \
+      double min = DBL_MAX;                                                   \
+      for (int j = 0; j < N; j++) {                                           \
+        min = MIN(min, d[i * N + j]);                                         \
+        cols[j] = MIN(cols[j], d[i * N + j]);                                 \
+      }                                                                       \
+      rows[i] = min;                                                          \
+    }                                                                         \
+    for (int i = 0; i < 2 * N; i++) {                                         \
+      rows[i] = sqrt(rows[i]);                                                \
+    }                                                                         \
+  }
 
-  double min = DBL_MAX;
-  for (double i = 0; i < self->n; i += self->step) {
-    double d[] = {
-      _cloud_dist(c1, c2, (int)round(i)),
-      _cloud_dist(c2, c1, (int)round(i))
-    };
-    min = MIN(d[0], d[1]);
+_DP_FIXED_N_KERNELS(16, uint16_t)
+_DP_FIXED_N_KERNELS(32, uint32_t)
+_DP_FIXED_N_KERNELS(64, uint64_t)
+
+#undef _DP_FIXED_N_KERNELS
+
+/*! Calls `_cloud_dist_N()` if there is one for `n`, else `_cloud_dist()`.
+ *
+ * \param sq_dists The `n` by `n` matrix of squared distances.
+ * \param n The size of the clouds.
+ * \param start The start index to search from.
+ * \param bound The sum at which to give up.
+ * \param scr The scratch space.
+ *
+ * \return The distance between the clouds, or a value greater than `bound` if
+ *   the alignment was abandoned.
+ */
+static inline double _cloud_dist_any(const double* sq_dists, int n, int start,
+                                     double bound, _dp_scratch_t* scr) {
+  switch (n) {
+    case 16: return _cloud_dist_16(sq_dists, start, bound, scr);
+    case 32: return _cloud_dist_32(sq_dists, start, bound, scr);
+    case 64: return _cloud_dist_64(sq_dists, start, bound, scr);
+    default: return _cloud_dist(sq_dists, n, start, bound, scr);
   }
-  return min;
 }
 
+/*! Calls `_nearest_dists_N()` if there is one for `n`, else
+ * `_nearest_dists()`.
+ *
+ * \param scr The scratch space, with `sq_dists` filled in.
+ * \param n The size of the clouds.
+ */
+static inline void _nearest_dists_any(_dp_scratch_t* scr, int n) {
+  switch (n) {
+    case 16: _nearest_dists_16(scr); break;
+    case 32: _nearest_dists_32(scr); break;
+    case 64: _nearest_dists_64(scr); break;
+    default: _nearest_dists(scr, n); break;
+  }
+}
 
+/*! Slack subtracted from how close an unsearched grid cell can be, so that
+ * rounding a point into the wrong cell can never hide it.
+ */
+#define _DP_GRID_SLACK 1e-9
 
-////////////////////////////////////////////////////////////////////////////////
-//                             "Public" Functions                             //
-////////////////////////////////////////////////////////////////////////////////
+//! Two clouds to match through their grids rather than their distances.
+typedef struct {
+  const stroke_soa_t* clouds[2];  //!< The query and the template.
+  const int* grids[2];            //!< Their grids.
+} _dp_grid_pair_t;
 
-//! The amount to increase the template size by, each time it needs increasing.
-#define _DP_TMPL_INC 100
+/*! Finds the number of cells along each side of the grid of a cloud: enough
+ * for about one point per cell.
+ *
+ * \param n The size of the cloud.
+ *
+ * \return The number of cells.
+ */
+static inline int _grid_side(int n) {
+  return MAX(1, (int)ceil(sqrt(n)));
+}
 
-dp_context_t* dp_create() {
-  dp_context_t* self = calloc(1, sizeof(dp_context_t));
-  self->n = DP_DEFAULT_N;
-  dp_set_epsilon(self, DP_DEFAULT_EPSILON);
-  self->tmpls = calloc(self->cap = _DP_TMPL_INC, sizeof(dp_template_t));
-  return self;
+/*! Finds the number of `int`s in the grid of a cloud.
+ *
+ * \param n The size of the cloud.
+ *
+ * \return The number of `int`s.
+ */
+static inline size_t _grid_ints(int n) {
+  const int g = _grid_side(n);
+  return g * g + 1 + n;
 }
 
-// Adds a template.  Copies the stroke and name.
-void dp_add_template(dp_context_t* self, const stroke_t* strk, const char* name) {
-  EN("dp_add_template(self, strk<%ld>, \"%s\"\n", strk->num, name);
+/*! Finds the row or column of the grid cell that a coordinate falls in.
+ *
+ * \param v The coordinate.
+ * \param g The number of cells along each side.
+ *
+ * \return The row or column.
+ */
+static inline int _grid_cell(double v, int g) {
+  return MAX(0, MIN(g - 1, (int)floor((v + 1) * g / 2)));
+}
 
-  // Ensure we have enough space.
-  if (self->num >= self->cap) {
-    self->cap += _DP_TMPL_INC;
-    self->tmpls = realloc(self->tmpls, self->cap * sizeof(dp_template_t));
-    debug("Reallocated self->tmpls to cap: %ld\n", self->cap);
+/*! Fills in the grid (see `dp_template_t.grid`) of a cloud.  Each cell lists
+ * its points in increasing order.
+ *
+ * \param cloud The normalized cloud.
+ * \param grid Gets the grid; `_grid_ints()` long.
+ */
+static void _grid_fill(const stroke_soa_t* cloud, int* grid) {
+  const int n = cloud->num;
+  const int g = _grid_side(n);
+  int* start = grid;
+  int* pts = grid + g * g + 1;
+  memset(start, 0, (g * g + 1) * sizeof(int));
+  for (int j = 0; j < n; j++) {
+    start[_grid_cell(cloud->y[j], g) * g + _grid_cell(cloud->x[j], g) + 1]++;
+  }
+  for (int c = 0; c < g * g; c++) {
+    start[c + 1] += start[c];
   }
 
-  stroke_t* clone = stroke_clone(strk);
-  _normalize(clone, self->n);
+  // Each cell's start moves to its end as its points are placed.
+  for (int j = 0; j < n; j++) {
+    pts[start[_grid_cell(cloud->y[j], g) * g + _grid_cell(cloud->x[j], g)]++]
+      = j;
+  }
+  for (int c = g * g; c > 0; c--) {
+    start[c] = start[c - 1];
+  }
+  start[0] = 0;
+}
 
-  // Add this template.
-  dp_template_t* next = &self->tmpls[self->num++];
-  next->strk = clone;
-  strncpy(next->name, name, DP_MAX_TMPL_NAME_LEN);
+/*! Builds the grid (see `dp_template_t.grid`) of a cloud.
+ *
+ * \param cloud The normalized cloud.
+ *
+ * \return The grid; free with `free()`.
+ */
+static inline int* _grid_create(const stroke_soa_t* cloud) {
+  int* grid = malloc(_grid_ints(cloud->num) * sizeof(int));
+  _grid_fill(cloud, grid);
+  return grid;
+}
 
-  EX("dp_add_template(self, strk<%ld>, \"%s\"\n", strk->num, name);
+/*! Checks the unmatched points of one grid cell for one nearer to a point
+ * than the nearest so far.
+ *
+ * \param cloud The cloud.
+ * \param grid The cloud's grid.
+ * \param c The cell.
+ * \param counts The number of unmatched points in each cell, or \c NULL.
+ * \param matched Flags of the matched points, or \c NULL.
+ * \param x The X-coordinate of the point.
+ * \param y The Y-coordinate of the point.
+ * \param min The squared distance to the nearest point so far.
+ * \param index The index of the nearest point so far, or -1.
+ */
+static inline void _grid_visit(const stroke_soa_t* cloud, const int* grid,
+                               int c, const int* counts, const char* matched,
+                               double x, double y, double* min, int* index) {
+  if (counts && !counts[c]) {
+    return;
+  }
+  const int g = _grid_side(cloud->num);
+  const int* pts = grid + g * g + 1;
+  for (int k = grid[c]; k < grid[c + 1]; k++) {
+    const int j = pts[k];
+    if (matched && matched[j]) {
+      continue;
+    }
+    const double dx = cloud->x[j] - x;
+    const double dy = cloud->y[j] - y;
+    const double d = dx * dx + dy * dy;
+    if (d < *min || (d == *min && j < *index)) {
+      *min = d;
+      *index = j;
+    }
+  }
 }
 
-dp_result_t dp_recognize(const dp_context_t* self, stroke_t* strk) {
-  // Init for recognition.
-  _normalize(strk, self->n);
+/*! Finds the nearest unmatched point of a cloud to a point, by searching the
+ * cloud's grid in square rings of cells around the point's cell.  The search
+ * stops as soon as no cell left can hold a nearer point.  The squared
+ * distances are computed just as in `stroke_soa_sq_dist_matrix()`, and ties
+ * go to the lowest index, so the point found is the one a scan of the
+ * distances would find.
+ *
+ * \param cloud The cloud.
+ * \param grid The cloud's grid.
+ * \param counts The number of unmatched points in each cell, or \c NULL if
+ *   none are matched.
+ * \param matched Flags of the matched points, or \c NULL.
+ * \param x The X-coordinate of the point.
+ * \param y The Y-coordinate of the point.
+ * \param sq_dist Gets the squared distance to the nearest point.
+ *
+ * \return The index of the nearest point, or -1 if no distance is a number.
+ */
+static int _grid_nearest(const stroke_soa_t* cloud, const int* grid,
+                         const int* counts, const char* matched, double x,
+                         double y, double* sq_dist) {
+  const int g = _grid_side(cloud->num);
+  const double h = 2.0 / g;
+  const int cx = _grid_cell(x, g);
+  const int cy = _grid_cell(y, g);
+  double min = DBL_MAX;
+  int index = -1;
+  for (int r = 0; ; r++) {
+    const int x0 = cx - r, x1 = cx + r, y0 = cy - r, y1 = cy + r;
+    for (int row = MAX(0, y0); row <= MIN(g - 1, y1); row++) {
+      if (row == y0 || row == y1) {
+        for (int col = MAX(0, x0); col <= MIN(g - 1, x1); col++) {
+          _grid_visit(cloud, grid, row * g + col, counts, matched, x, y, &min,
+                      &index);
+        }
+        continue;
+      }
+      if (x0 >= 0) {
+        _grid_visit(cloud, grid, row * g + x0, counts, matched, x, y, &min,
+                    &index);
+      }
+      if (x1 < g) {
+        _grid_visit(cloud, grid, row * g + x1, counts, matched, x, y, &min,
+                    &index);
+      }
+    }
 
-  // Try each template, see which one works.
-  dp_template_t* tmpl = NULL;
-  double score = DBL_MAX;
-  for (int i = 0; i < self->num; i++) {
-    double d = _greedy_cloud_match(self, strk, self->tmpls[i].strk);
-    if (score > d) {
-      score = d;
-      tmpl = &self->tmpls[i];
+    // The nearest any cell outside the rings so far can be.
+    double reach = DBL_MAX;
+    if (x0 > 0) {
+      reach = MIN(reach, x - (-1 + x0 * h));
+    }
+    if (x1 < g - 1) {
+      reach = MIN(reach, -1 + (x1 + 1) * h - x);
+    }
+    if (y0 > 0) {
+      reach = MIN(reach, y - (-1 + y0 * h));
+    }
+    if (y1 < g - 1) {
+      reach = MIN(reach, -1 + (y1 + 1) * h - y);
+    }
+    if (reach == DBL_MAX) {
+      break;
+    }
+    reach = MAX(0, reach - _DP_GRID_SLACK);
+    if (index >= 0 && min < reach * reach) {
+      break;
     }
   }
-
-  // Normalize score in [0,1] and return the result.
-  dp_result_t result = { tmpl, MAX((2.0 - score) / 2.0, 0) };
-  return result;
+  *sq_dist = min;
+  return index;
 }
 
-void dp_destroy(dp_context_t* self) {
-  debug("Freeing templates:\n");
-  for (int i = 0; i < self->num; i++) {
-    debug("  Freeing self->tmpls[%d].strk: %p ...\n", i, self->tmpls[i].strk);
-    stroke_destroy(self->tmpls[i].strk);
+/*! Finds the distance between two clouds, like `_cloud_dist()`, but finds
+ * the nearest unmatched point through the grid of the second cloud.
+ *
+ * \param pair The clouds and their grids.
+ * \param dir 0 to align the query to the template, 1 for the other way.
+ * \param start The start index to search from.
+ * \param bound The sum at which to give up.
+ * \param scr The scratch space.
+ *
+ * \return The distance between the clouds, or a value greater than `bound` if
+ *   the alignment was abandoned.
+ */
+static double _grid_cloud_dist(const _dp_grid_pair_t* pair, int dir,
+                               int start, double bound, _dp_scratch_t* scr) {
+  const stroke_soa_t* c1 = pair->clouds[dir];
+  const stroke_soa_t* c2 = pair->clouds[1 - dir];
+  const int* grid = pair->grids[1 - dir];
+  const int n = c1->num;
+  const int g = _grid_side(n);
+  char* matched = scr->matched;
+  memset(matched, 0, n);
+  for (int c = 0; c < g * g; c++) {
+    scr->counts[c] = grid[c + 1] - grid[c];
   }
-  debug("  Freeing self->tmpls: %p\n", self->tmpls);
-  free(self->tmpls);
 
-  debug("Zero-ing out self: %p ...\n", self);
-  bzero(self, sizeof(dp_context_t));
+  double sum = 0;
+  int i = start;
+  do {
+    double min;
+    const int index = _grid_nearest(c2, grid, scr->counts, matched, c1->x[i],
+                                    c1->y[i], &min);
+    if (index >= 0) {  // else, no distance is a number.
+      matched[index] = 1;
+      scr->counts[_grid_cell(c2->y[index], g) * g +
+                  _grid_cell(c2->x[index], g)]--;
+    }
+    double weight = 1 - ((i - start + n) % n) / (double)n;
+    sum += weight * sqrt(min);
+    i = (i + 1) % n;
+    if (sum > bound && i != start) {
+      scr->abandoned++;
+      break;
+    }
+  } while (i != start);
 
-  debug("Freeing self...\n");
-  free(self);
+  return sum;
+}
+
+/*! Fills `scr->mins` like `_nearest_dists()`, through the clouds' grids.
+ *
+ * \param pair The clouds and their grids.
+ * \param scr The scratch space.
+ */
+static void _grid_nearest_dists(const _dp_grid_pair_t* pair,
+                                _dp_scratch_t* scr) {
+  const int n = pair->clouds[0]->num;
+  for (int dir = 0; dir < 2; dir++) {
+    const stroke_soa_t* c1 = pair->clouds[dir];
+    for (int i = 0; i < n; i++) {
+      double min;
+      _grid_nearest(pair->clouds[1 - dir], pair->grids[1 - dir], NULL, NULL,
+                    c1->x[i], c1->y[i], &min);
+      scr->mins[dir * n + i] = sqrt(min);
+    }
+  }
 }
+
+/*! Attempt to match two point clouds, given the squared distances between
+ * them.
+ *
+ * From the article:
+ * <blockquote>
+ * Cloud matching function. Match two clouds (points and template) by performing
+ * repeated alignments between their points (each new alignment starts with a
+ * different starting point index \f$i\f$).  Parameter \f$\varepsilon \in
+ * [0,1]\f$ controls the number of tested alignments (\f$n^\varepsilon \in \{1,
+ * 2, \ldots, n\}\f$). Returns the minimum alignment cost.
+ * </blockquote>
+ *
+ * The squared distances between the clouds are computed once, into
+ * `scr->sq_dists` (and their transpose, for matching in the other direction),
+ * by the caller, and shared by every alignment.  Alignments that can't get
+ * down to `bound`
+ * are skipped or abandoned, as allowed by `self->prune`.  Since only
+ * alignments that are certain to exceed `bound` are cut short, a result no
+ * greater than `bound` is exact.
+ *
+ * Given `pair`, the clouds are matched through their grids instead, and
+ * `sq_dists` is not used.
+ *
+ * \param self The $P context.
+ * \param n The size of the clouds.
+ * \param step The step between the start indices of the alignments.
+ * \param bound The best score so far.
+ * \param pair The clouds and their grids, or \c NULL.
+ * \param scr The scratch space, with `sq_dists` filled in.
+ *
+ * \return The minimum alignment cost, or a value greater than `bound` if no
+ *   alignment gets down to it.
+ */
+static inline double _greedy_match(const dp_context_t* self, int n,
+                                   double step, double bound,
+                                   const _dp_grid_pair_t* pair,
+                                   _dp_scratch_t* scr) {
+  const double* sq_dists = scr->sq_dists;
+  const double* sq_dists_t = sq_dists + n * n;
+  const int use_bound = self->prune & DP_PRUNE_BOUND;
+  if (use_bound && pair) {
+    _grid_nearest_dists(pair, scr);
+  } else if (use_bound) {
+    _nearest_dists_any(scr, n);
+  }
+
+  double min = DBL_MAX;
+  int tested = 0;
+  for (double i = 0; i < n; i += step) {
+    const int start = (int)round(i) % n;
+    const double* sq[] = { sq_dists, sq_dists_t };
+    for (int dir = 0; dir < 2; dir++) {
+      const double best = MIN(min, bound);
+      if (use_bound && best < DBL_MAX &&
+          _cloud_bound(scr->mins + dir * n, n, start) * _DP_BOUND_SLACK
+          > best) {
+        scr->abandoned++;
+        continue;
+      }
+      const double abandon =
+        (self->prune & DP_PRUNE_ABANDON) ? best : DBL_MAX;
+      const double d = pair
+        ? _grid_cloud_dist(pair, dir, start, abandon, scr)
+        : _cloud_dist_any(sq[dir], n, start, abandon, scr);
+      min = MIN(min, d);
+      tested++;
+    }
+  }
+  if (!tested) {
+    scr->pruned++;
+  }
+  return min;
+}
+
+/*! Attempt to match two point clouds; see `_greedy_match()`.
+ *
+ * \param self The $P context.
+ * \param c1 A point cloud to compare.
+ * \param c2 Another point cloud to compare.
+ * \param step The step between the start indices of the alignments.
+ * \param bound The best score so far.
+ * \param scr The scratch space.
+ *
+ * \return The minimum alignment cost, or a value greater than `bound` if no
+ *   alignment gets down to it.
+ */
+static inline double
+_greedy_cloud_match(const dp_context_t* self, const stroke_soa_t* c1,
+                    const stroke_soa_t* c2, double step, double bound,
+                    _dp_scratch_t* scr) {
+  assert(c1->num == c2->num);
+  const int n = c1->num;
+  stroke_soa_sq_dist_matrix(c1, c2, scr->sq_dists, scr->sq_dists + n * n);
+  return _greedy_match(self, n, step, bound, NULL, scr);
+}
+
+/*! Fills in the squared distances from a cloud to a `float` packed cloud, and
+ * their transpose.  The packed coordinates are widened to `double`, so the
+ * only error is the packing's.
+ *
+ * \param cloud The query cloud.
+ * \param packed The packed cloud, of the same size.
+ * \param out Gets the squared distances.
+ * \param out_t Gets their transpose.
+ */
+static inline void _sq_dists_float(const stroke_soa_t* cloud,
+                                   const float* packed,
+                                   double* restrict out,
+                                   double* restrict out_t) {
+  const int n = cloud->num;
+  const float* restrict tx = packed;
+  const float* restrict ty = packed + n;
+  for (int i = 0; i < n; i++) {
+    const double px = cloud->x[i];
+    const double py = cloud->y[i];
+    for (int j = 0; j < n; j++) {
+      const double dx = tx[j] - px;
+      const double dy = ty[j] - py;
+      out[i * n + j] = out_t[j * n + i] = dx * dx + dy * dy;
+    }
+  }
+}
+
+/*! Fills in the squared distances from a cloud to an `int16_t` packed cloud,
+ * and their transpose.
+ *
+ * \param cloud The query cloud.
+ * \param packed The packed cloud, of the same size.
+ * \param out Gets the squared distances.
+ * \param out_t Gets their transpose.
+ */
+static inline void _sq_dists_int16(const stroke_soa_t* cloud,
+                                   const int16_t* packed,
+                                   double* restrict out,
+                                   double* restrict out_t) {
+  const int n = cloud->num;
+  const double s = 1.0 / DP_INT16_SCALE;
+  const int16_t* restrict tx = packed;
+  const int16_t* restrict ty = packed + n;
+  for (int i = 0; i < n; i++) {
+    const double px = cloud->x[i];
+    const double py = cloud->y[i];
+    for (int j = 0; j < n; j++) {
+      const double dx = tx[j] * s - px;
+      const double dy = ty[j] * s - py;
+      out[i * n + j] = out_t[j * n + i] = dx * dx + dy * dy;
+    }
+  }
+}
+
+/*! Attempt to match a query cloud to a template, at the context's precision.
+ * Matches through the clouds' grids if both have one and the template is
+ * matched at full precision.
+ *
+ * \param self The $P context.
+ * \param cloud The query cloud.
+ * \param tmpl The template.
+ * \param bound The best score so far.
+ * \param scr The scratch space.
+ *
+ * \return The minimum alignment cost, or a value greater than `bound` if no
+ *   alignment gets down to it.
+ */
+static inline double
+_template_match(const dp_context_t* self, const stroke_soa_t* cloud,
+                const dp_template_t* tmpl, double bound, _dp_scratch_t* scr) {
+  assert(cloud->num == tmpl->strk->num);
+  const int n = self->n;
+  if (scr->grid && tmpl->grid && self->precision == DP_PRECISION_DOUBLE) {
+    const _dp_grid_pair_t pair = {
+      { cloud, tmpl->strk }, { scr->grid, tmpl->grid }
+    };
+    return _greedy_match(self, n, self->step, bound, &pair, scr);
+  }
+
+  double* sq_dists_t = scr->sq_dists + n * n;
+  switch (self->precision) {
+    case DP_PRECISION_FLOAT:
+      _sq_dists_float(cloud, tmpl->packed, scr->sq_dists, sq_dists_t);
+      break;
+
+    case DP_PRECISION_INT16:
+      _sq_dists_int16(cloud, tmpl->packed, scr->sq_dists, sq_dists_t);
+      break;
+
+    default:
+      stroke_soa_sq_dist_matrix(cloud, tmpl->strk, scr->sq_dists, sq_dists_t);
+      break;
+  }
+  return _greedy_match(self, n, self->step, bound, NULL, scr);
+}
+
+/*! Gets a point of a template's cloud, at the context's precision.
+ *
+ * \param self The $P context.
+ * \param tmpl The template.
+ * \param i The index of the point.
+ * \param x Gets the X-coordinate.
+ * \param y Gets the Y-coordinate.
+ */
+static inline void _template_point(const dp_context_t* self,
+                                   const dp_template_t* tmpl, int i,
+                                   double* x, double* y) {
+  const int n = self->n;
+  switch (self->precision) {
+    case DP_PRECISION_FLOAT:
+      *x = ((const float*)tmpl->packed)[i];
+      *y = ((const float*)tmpl->packed)[n + i];
+      break;
+
+    case DP_PRECISION_INT16:
+      *x = ((const int16_t*)tmpl->packed)[i] * (1.0 / DP_INT16_SCALE);
+      *y = ((const int16_t*)tmpl->packed)[n + i] * (1.0 / DP_INT16_SCALE);
+      break;
+
+    default:
+      *x = tmpl->strk->x[i];
+      *y = tmpl->strk->y[i];
+      break;
+  }
+}
+
+/*! Finds how far packing can move a point of a normalized cloud.
+ *
+ * \param precision The precision of the packed cloud.
+ *
+ * \return The largest distance between a point and its packed self.
+ */
+static inline double _packing_error(dp_precision_e precision) {
+  switch (precision) {
+    case DP_PRECISION_FLOAT: return FLT_EPSILON;
+    case DP_PRECISION_INT16: return 1.0 / DP_INT16_SCALE;
+    default:                 return 0;
+  }
+}
+
+/*! Checks whether the LUTs rule out a template before any distances between
+ * the clouds are computed.  The template's LUT is of its `double` cloud, so
+ * its distances are lowered by how far packing may have moved the points.
+ *
+ * \param self The $P context.
+ * \param cloud The query cloud.
+ * \param tmpl The template.
+ * \param bound The best score so far.
+ * \param scr The scratch space, with the query's LUT.
+ *
+ * \return Non-zero if the template can't get down to `bound`.
+ */
+static inline int
+_lut_prunes(const dp_context_t* self, const stroke_soa_t* cloud,
+            const dp_template_t* tmpl, double bound, _dp_scratch_t* scr) {
+  if (bound == DBL_MAX || tmpl->lut == NULL) {
+    return 0;
+  }
+
+  const int n = self->n;
+  const double err = _packing_error(self->precision);
+  for (int i = 0; i < n; i++) {
+    double x, y;
+    _template_point(self, tmpl, i, &x, &y);
+    scr->mins[i] =
+      MAX(0, _lut_dist(tmpl->lut, cloud->x[i], cloud->y[i]) - err);
+    scr->mins[n + i] = _lut_dist(scr->lut, x, y);
+  }
+  return _match_bound(self, scr->mins) * _DP_BOUND_SLACK > bound;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Scanning                                  //
+////////////////////////////////////////////////////////////////////////////////
+
+//! Number of templates a worker claims at a time.
+#define _DP_SCAN_BLOCK 64
+
+//! A scan of the templates, shared by the workers.
+typedef struct {
+  const dp_context_t* ctx;    //!< The $P context.
+  const stroke_soa_t* cloud;  //!< The normalized query.
+  const double* lut;          //!< The query's LUT, or \c NULL.
+  const stroke_soa_t* coarse; //!< The query at `ctx->coarse_n` points.
+  double coarse_step;         //!< The alignment step at `ctx->coarse_n`.
+  size_t next;                //!< Next unclaimed template; atomic.
+  double best;                //!< Best score found by any worker; atomic.
+  size_t k;                   //!< The number of results of a top-k scan.
+  int per_class;              //!< Non-zero for a top-k of template names.
+  const int* grid;            //!< The query's grid, or \c NULL.
+} _dp_scan_t;
+
+//! A template that made a shortlist (or a top-k).
+typedef struct {
+  double score;             //!< Its score.
+  long index;               //!< Its index.
+} _dp_cand_t;
+
+//! One worker's part of a scan.
+typedef struct {
+  _dp_scan_t* scan;         //!< The shared scan.
+  _dp_scratch_t scr;        //!< The worker's scratch space.
+  double score;             //!< Best score found by this worker.
+  long index;               //!< Index of that template, or -1.
+  _dp_cand_t* cands;        //!< Max-heap of this worker's shortlist/top-k.
+  size_t num_cands;         //!< Number of candidates in `cands`.
+} _dp_worker_t;
+
+/*! Lowers the shared best score to `score`, unless it's already lower.
+ *
+ * \param scan The scan.
+ * \param score The score.
+ */
+static inline void _scan_publish(_dp_scan_t* scan, double score) {
+  double best;
+  __atomic_load(&scan->best, &best, __ATOMIC_RELAXED);
+  while (score < best &&
+         !__atomic_compare_exchange(&scan->best, &best, &score, 1,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+/*! Matches the query against blocks of templates until there are none left.
+ *
+ * Templates are claimed in increasing order, so ties within a worker go to the
+ * lower index.  Every bound used for pruning is a score some template really
+ * has, and templates are only cut short when they exceed a bound, so the best
+ * template (and every template that ties it) is always scored exactly.
+ *
+ * \param arg The `_dp_worker_t`.
+ *
+ * \return \c NULL
+ */
+static void* _scan_run(void* arg) {
+  _dp_worker_t* w = arg;
+  _dp_scan_t* scan = w->scan;
+  const dp_context_t* self = scan->ctx;
+
+  size_t i;
+  while ((i = __atomic_fetch_add(&scan->next, _DP_SCAN_BLOCK,
+                                 __ATOMIC_RELAXED)) < self->num) {
+    const size_t end = MIN(i + _DP_SCAN_BLOCK, self->num);
+    for (; i < end; i++) {
+      double bound;
+      __atomic_load(&scan->best, &bound, __ATOMIC_RELAXED);
+      bound = MIN(bound, w->score);
+
+      const dp_template_t* tmpl = &self->tmpls[i];
+      if (w->scr.lut && _lut_prunes(self, scan->cloud, tmpl, bound, &w->scr)) {
+        w->scr.pruned++;
+        continue;
+      }
+      double d = _template_match(self, scan->cloud, tmpl, bound, &w->scr);
+      if (d <= bound && d < w->score) {
+        w->score = d;
+        w->index = i;
+        _scan_publish(scan, d);
+      }
+    }
+  }
+  return NULL;
+}
+
+/*! Orders candidates by score, then by index.
+ *
+ * \param a A candidate.
+ * \param b Another candidate.
+ *
+ * \return Non-zero if `a` comes after `b`.
+ */
+static inline int _cand_after(const _dp_cand_t* a, const _dp_cand_t* b) {
+  return a->score > b->score || (a->score == b->score && a->index > b->index);
+}
+
+/*! Puts a candidate in a max-heap at `i`, in place of one that comes after
+ * it, and sifts it down.
+ *
+ * \param heap The heap; its last candidate is first.
+ * \param num The number of candidates in the heap.
+ * \param i Where to put the candidate.
+ * \param c The candidate.
+ */
+static void _heap_sift_down(_dp_cand_t* heap, size_t num, size_t i,
+                            _dp_cand_t c) {
+  while (2 * i + 1 < num) {
+    size_t child = 2 * i + 1;
+    if (child + 1 < num && _cand_after(&heap[child + 1], &heap[child])) {
+      child++;
+    }
+    if (!_cand_after(&heap[child], &c)) {
+      break;
+    }
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = c;
+}
+
+/*! Offers a candidate to a bounded max-heap that keeps the first `cap`
+ * candidates (see `_cand_after()`).
+ *
+ * \param heap The heap; its last candidate is first.
+ * \param num The number of candidates in the heap.
+ * \param cap The capacity of the heap.
+ * \param c The candidate.
+ */
+static void
+_heap_offer(_dp_cand_t* heap, size_t* num, size_t cap, _dp_cand_t c) {
+  if (*num < cap) {
+    // Sift up from the end.
+    size_t i;
+    for (i = (*num)++; i > 0 && _cand_after(&c, &heap[(i - 1) / 2]);
+         i = (i - 1) / 2) {
+      heap[i] = heap[(i - 1) / 2];
+    }
+    heap[i] = c;
+  } else if (cap > 0 && _cand_after(&heap[0], &c)) {
+    // Replace the root and sift down.
+    _heap_sift_down(heap, cap, 0, c);
+  }
+}
+
+/*! Compares candidates for `qsort()` with `_cand_after()`.
+ *
+ * \param a A candidate.
+ * \param b Another candidate.
+ *
+ * \return Less than, equal to, or greater than 0 as `a` comes before, with,
+ *   or after `b`.
+ */
+static int _cand_cmp(const void* a, const void* b) {
+  return _cand_after(a, b) - _cand_after(b, a);
+}
+
+/*! Compares candidates by index for `qsort()`.
+ *
+ * \param a A candidate.
+ * \param b Another candidate.
+ *
+ * \return Less than, equal to, or greater than 0 as `a`'s index is.
+ */
+static int _cand_index_cmp(const void* a, const void* b) {
+  const long i = ((const _dp_cand_t*)a)->index;
+  const long j = ((const _dp_cand_t*)b)->index;
+  return (i > j) - (i < j);
+}
+
+/*! Shortlists templates from their coarse clouds until there are none left.
+ * Each worker keeps its own `ctx->shortlist` best; since a template is only cut
+ * short when it exceeds the worker's worst candidate, every template that
+ * belongs on the overall shortlist is scored exactly by its worker.
+ *
+ * \param arg The `_dp_worker_t`.
+ *
+ * \return \c NULL
+ */
+static void* _scan_coarse_run(void* arg) {
+  _dp_worker_t* w = arg;
+  _dp_scan_t* scan = w->scan;
+  const dp_context_t* self = scan->ctx;
+  const size_t k = self->shortlist;
+
+  size_t i;
+  while ((i = __atomic_fetch_add(&scan->next, _DP_SCAN_BLOCK,
+                                 __ATOMIC_RELAXED)) < self->num) {
+    const size_t end = MIN(i + _DP_SCAN_BLOCK, self->num);
+    for (; i < end; i++) {
+      const double bound = (w->num_cands < k) ? DBL_MAX : w->cands[0].score;
+      double d = _greedy_cloud_match(self, scan->coarse, self->tmpls[i].coarse,
+                                     scan->coarse_step, bound, &w->scr);
+      if (d <= bound) {
+        _dp_cand_t c = { d, i };
+        _heap_offer(w->cands, &w->num_cands, k, c);
+      }
+    }
+  }
+  return NULL;
+}
+
+/*! Matches the query against a template for a top-k, and offers the template
+ * to the worker's heap.  The heap's last candidate bounds the match; in a
+ * top-k of names, so does the candidate with the template's name, if any,
+ * which the template replaces if it comes before it.
+ *
+ * \param w The worker.
+ * \param i The index of the template.
+ */
+static inline void _topk_match(_dp_worker_t* w, long i) {
+  _dp_scan_t* scan = w->scan;
+  const dp_context_t* self = scan->ctx;
+  const dp_template_t* tmpl = &self->tmpls[i];
+  size_t slot = w->num_cands;
+  double bound = (w->num_cands < scan->k) ? DBL_MAX : w->cands[0].score;
+  if (scan->per_class) {
+    for (size_t c = 0; c < w->num_cands; c++) {
+      if (self->tmpls[w->cands[c].index].label == tmpl->label) {
+        slot = c;
+        bound = w->cands[c].score;
+        break;
+      }
+    }
+  }
+
+  if (w->scr.lut && _lut_prunes(self, scan->cloud, tmpl, bound, &w->scr)) {
+    w->scr.pruned++;
+    return;
+  }
+  const double d = _template_match(self, scan->cloud, tmpl, bound, &w->scr);
+  if (d > bound) {
+    return;
+  }
+  _dp_cand_t c = { d, i };
+  if (slot == w->num_cands) {
+    _heap_offer(w->cands, &w->num_cands, scan->k, c);
+  } else if (_cand_after(&w->cands[slot], &c)) {
+    _heap_sift_down(w->cands, w->num_cands, slot, c);
+  }
+}
+
+/*! Keeps each worker's top `scan->k` templates until there are none left.
+ * As with `_scan_coarse_run()`, every template that belongs in the overall
+ * top-k is in its worker's, and is scored exactly.
+ *
+ * \param arg The `_dp_worker_t`.
+ *
+ * \return \c NULL
+ */
+static void* _scan_topk_run(void* arg) {
+  _dp_worker_t* w = arg;
+  _dp_scan_t* scan = w->scan;
+  const dp_context_t* self = scan->ctx;
+
+  size_t i;
+  while ((i = __atomic_fetch_add(&scan->next, _DP_SCAN_BLOCK,
+                                 __ATOMIC_RELAXED)) < self->num) {
+    const size_t end = MIN(i + _DP_SCAN_BLOCK, self->num);
+    for (; i < end; i++) {
+      _topk_match(w, i);
+    }
+  }
+  return NULL;
+}
+
+/*! Allocates scratch space.
+ *
+ * \param scr The scratch space.
+ * \param n The size of the largest clouds.
+ */
+static inline void _scratch_init(_dp_scratch_t* scr, size_t n) {
+  scr->sq_dists = malloc(2 * n * n * sizeof(double));
+  scr->mins = malloc(2 * n * sizeof(double));
+  scr->matched = malloc(n);
+  scr->counts = malloc(_grid_side(n) * _grid_side(n) * sizeof(int));
+  scr->lut = NULL;
+  scr->grid = NULL;
+  scr->pruned = 0;
+  scr->abandoned = 0;
+}
+
+/*! Frees scratch space.
+ *
+ * \param scr The scratch space.
+ */
+static inline void _scratch_free(_dp_scratch_t* scr) {
+  free(scr->counts);
+  free(scr->matched);
+  free(scr->mins);
+  free(scr->sq_dists);
+}
+
+/*! Allocates a worker's scratch space.
+ *
+ * \param w The worker.
+ * \param n The size of the largest clouds.
+ * \param num_cands The size of the shortlist or top-k.
+ */
+static inline void _worker_init(_dp_worker_t* w, size_t n, size_t num_cands) {
+  _scratch_init(&w->scr, n);
+  w->cands = malloc(MAX(1, num_cands) * sizeof(_dp_cand_t));
+}
+
+/*! Readies a worker for a scan.
+ *
+ * \param w The worker.
+ * \param scan The scan it's part of.
+ */
+static inline void _worker_reset(_dp_worker_t* w, _dp_scan_t* scan) {
+  w->scan = scan;
+  w->scr.lut = scan->lut;
+  w->scr.grid = scan->grid;
+  w->scr.pruned = 0;
+  w->scr.abandoned = 0;
+  w->score = DBL_MAX;
+  w->index = -1;
+  w->num_cands = 0;
+}
+
+/*! Frees a worker's scratch space.
+ *
+ * \param w The worker.
+ */
+static inline void _worker_free(_dp_worker_t* w) {
+  free(w->cands);
+  _scratch_free(&w->scr);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Workspaces                                 //
+////////////////////////////////////////////////////////////////////////////////
+
+//! Everything a recognition needs besides the context.
+struct dp_workspace {
+  size_t n;                 //!< The `n` it is sized for.
+  size_t coarse_n;          //!< The `coarse_n` it is sized for.
+  size_t num_cands;         //!< Candidates each worker has room for.
+  size_t num_workers;       //!< The number of workers it is sized for.
+  stroke_soa_t* cloud;      //!< The normalized query.
+  stroke_soa_t* coarse;     //!< The query at `coarse_n` points, or \c NULL.
+  double* lut;              //!< The query's LUT, or \c NULL until needed.
+  int* grid;                //!< The query's grid, or \c NULL until needed.
+  _dp_worker_t* workers;    //!< The workers.
+  pthread_t* threads;       //!< A thread for each worker but the first.
+  _dp_cand_t* cands;        //!< Every worker's candidates, merged.
+};
+
+/*! Checks whether clouds are matched through their grids.
+ *
+ * \param self The $P context.
+ *
+ * \return Non-zero if so.
+ */
+static inline int _grid_mode(const dp_context_t* self) {
+  return self->grid_n && self->n >= self->grid_n;
+}
+
+/*! Frees everything in a workspace but the workspace itself.
+ *
+ * \param self The workspace.
+ */
+static void _workspace_clear(dp_workspace_t* self) {
+  for (size_t i = 0; i < self->num_workers; i++) {
+    _worker_free(&self->workers[i]);
+  }
+  free(self->cands);
+  free(self->threads);
+  free(self->workers);
+  free(self->lut);
+  free(self->grid);
+  if (self->coarse) {
+    stroke_soa_destroy(self->coarse);
+  }
+  if (self->cloud) {
+    stroke_soa_destroy(self->cloud);
+  }
+  bzero(self, sizeof(dp_workspace_t));
+}
+
+/*! Makes sure a workspace is big enough for a recognition with the context's
+ * current settings.  Only allocates if the settings grew since the last call.
+ *
+ * \param self The workspace.
+ * \param ctx The $P context.
+ * \param k The number of results of a top-k, or 0.
+ */
+static void
+_workspace_fit(dp_workspace_t* self, const dp_context_t* ctx, size_t k) {
+  const size_t num_workers = MAX(1, ctx->threads);
+  const size_t num_cands = MAX(ctx->shortlist, k);
+  if (self->n != ctx->n || self->coarse_n != ctx->coarse_n ||
+      self->num_cands < num_cands || self->num_workers < num_workers) {
+    _workspace_clear(self);
+    self->n = ctx->n;
+    self->coarse_n = ctx->coarse_n;
+    self->num_cands = num_cands;
+    self->num_workers = num_workers;
+    self->cloud = stroke_soa_create(ctx->n);
+    if (ctx->coarse_n) {
+      self->coarse = stroke_soa_create(ctx->coarse_n);
+    }
+    self->workers = calloc(num_workers, sizeof(_dp_worker_t));
+    self->threads = calloc(num_workers, sizeof(pthread_t));
+    self->cands = malloc(MAX(1, num_workers * num_cands)
+                         * sizeof(_dp_cand_t));
+    for (size_t i = 0; i < num_workers; i++) {
+      _worker_init(&self->workers[i], MAX(ctx->n, ctx->coarse_n), num_cands);
+    }
+  }
+  if ((ctx->prune & DP_PRUNE_LUT) && self->lut == NULL) {
+    self->lut = malloc(_DP_LUT_BYTES);
+  }
+  if (_grid_mode(ctx) && self->grid == NULL) {
+    self->grid = malloc(_grid_ints(ctx->n) * sizeof(int));
+  }
+}
+
+dp_workspace_t* dp_workspace_create(const dp_context_t* ctx) {
+  dp_workspace_t* self = calloc(1, sizeof(dp_workspace_t));
+  _workspace_fit(self, ctx, 0);
+  return self;
+}
+
+void dp_workspace_destroy(dp_workspace_t* self) {
+  _workspace_clear(self);
+  free(self);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Labels                                   //
+////////////////////////////////////////////////////////////////////////////////
+
+//! The number of slots a label table starts with.
+#define _DP_LABEL_SLOTS 64
+
+/*! Hashes a name with FNV-1a, up to `DP_MAX_TMPL_NAME_LEN` characters.
+ *
+ * \param name The name.
+ *
+ * \return The hash.
+ */
+static inline uint64_t _label_hash(const char* name) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < DP_MAX_TMPL_NAME_LEN && name[i]; i++) {
+    h = (h ^ (unsigned char)name[i]) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+/*! Finds the slot of a name in a label table: the slot holding its label, or
+ * the empty slot where it would go.
+ *
+ * \param self The label table, with slots.
+ * \param name The name.
+ *
+ * \return The slot.
+ */
+static size_t _label_slot(const dp_labels_t* self, const char* name) {
+  const size_t mask = self->num_slots - 1;
+  size_t slot = _label_hash(name) & mask;
+  while (self->slots[slot] >= 0 &&
+         strncmp(self->names[self->slots[slot]], name, DP_MAX_TMPL_NAME_LEN)) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+/*! Rebuilds a label table's slots with `num_slots` slots.
+ *
+ * \param self The label table.
+ * \param num_slots The number of slots; a power of 2.
+ */
+static void _labels_rehash(dp_labels_t* self, size_t num_slots) {
+  free(self->slots);
+  self->slots = malloc(num_slots * sizeof(int));
+  self->num_slots = num_slots;
+  for (size_t i = 0; i < num_slots; i++) {
+    self->slots[i] = -1;
+  }
+  for (size_t l = 0; l < self->num; l++) {
+    self->slots[_label_slot(self, self->names[l])] = l;
+  }
+}
+
+/*! Interns a name into a label table.
+ *
+ * \param self The label table.
+ * \param name The name.
+ *
+ * \return The name's label.
+ */
+static int _label_intern(dp_labels_t* self, const char* name) {
+  if (2 * (self->num + 1) > self->num_slots) {
+    _labels_rehash(self, MAX(_DP_LABEL_SLOTS, 2 * self->num_slots));
+  }
+  const size_t slot = _label_slot(self, name);
+  if (self->slots[slot] >= 0) {
+    return self->slots[slot];
+  }
+
+  if (self->num == self->cap) {
+    self->cap = MAX(_DP_LABEL_SLOTS, 2 * self->cap);
+    self->names = realloc(self->names, self->cap * sizeof(char*));
+  }
+  self->names[self->num] = strndup(name, DP_MAX_TMPL_NAME_LEN);
+  self->slots[slot] = self->num;
+  return self->num++;
+}
+
+/*! Frees a label table's memory.
+ *
+ * \param self The label table.
+ */
+static void _labels_clear(dp_labels_t* self) {
+  for (size_t l = 0; l < self->num; l++) {
+    free(self->names[l]);
+  }
+  free(self->names);
+  free(self->slots);
+  bzero(self, sizeof(dp_labels_t));
+}
+
+int dp_label(const dp_context_t* self, const char* name) {
+  if (!self->labels.num_slots) {
+    return -1;
+  }
+  return self->labels.slots[_label_slot(&self->labels, name)];
+}
+
+#undef _DP_LABEL_SLOTS
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//                             "Public" Functions                             //
+////////////////////////////////////////////////////////////////////////////////
+
+//! The amount to increase the template size by, each time it needs increasing.
+#define _DP_TMPL_INC 100
+
+dp_context_t* dp_create() {
+  dp_context_t* self = calloc(1, sizeof(dp_context_t));
+  self->n = DP_DEFAULT_N;
+  self->prune = DP_DEFAULT_PRUNE;
+  self->threads = DP_DEFAULT_THREADS;
+  self->shortlist = DP_DEFAULT_SHORTLIST;
+  self->grid_n = DP_DEFAULT_GRID_N;
+  dp_set_epsilon(self, DP_DEFAULT_EPSILON);
+  self->tmpls = calloc(self->cap = _DP_TMPL_INC, sizeof(dp_template_t));
+  return self;
+}
+
+/*! Builds (or rebuilds) the coarse cloud of a template.
+ *
+ * \param self The $P context.
+ * \param tmpl The template.
+ */
+static void _template_coarsen(dp_context_t* self, dp_template_t* tmpl) {
+  if (tmpl->coarse && tmpl->coarse->size < self->coarse_n) {
+    stroke_soa_destroy(tmpl->coarse);
+    tmpl->coarse = NULL;
+  }
+  if (tmpl->coarse == NULL) {
+    tmpl->coarse = stroke_soa_create(self->coarse_n);
+  }
+  _coarsen(tmpl->strk, self->coarse_n, tmpl->coarse);
+}
+
+/*! Packs (or repacks) a template's cloud at the context's precision.
+ *
+ * \param self The $P context.
+ * \param tmpl The template.
+ */
+static void _template_pack(dp_context_t* self, dp_template_t* tmpl) {
+  free(tmpl->packed);
+  tmpl->packed = NULL;
+
+  const int n = self->n;
+  const stroke_soa_t* strk = tmpl->strk;
+  if (self->precision == DP_PRECISION_FLOAT) {
+    float* xy = tmpl->packed = malloc(2 * n * sizeof(float));
+    for (int i = 0; i < n; i++) {
+      xy[i] = strk->x[i];
+      xy[n + i] = strk->y[i];
+    }
+  } else if (self->precision == DP_PRECISION_INT16) {
+    int16_t* xy = tmpl->packed = malloc(2 * n * sizeof(int16_t));
+    for (int i = 0; i < n; i++) {
+      xy[i] = lrint(MAX(-1, MIN(1, strk->x[i])) * DP_INT16_SCALE);
+      xy[n + i] = lrint(MAX(-1, MIN(1, strk->y[i])) * DP_INT16_SCALE);
+    }
+  }
+}
+
+/*! Converts a minimum score to the largest distance between clouds that
+ * scores it.
+ *
+ * \param score The score, \f$\in [0,1]\f$.
+ *
+ * \return The distance.
+ */
+static inline double _score_dist(double score) {
+  return 2 - 2 * score;
+}
+
+/*! Looks for a template with the given label whose cloud is within the
+ * context's `dedup` score of a cloud.
+ *
+ * \param self The $P context.
+ * \param cloud The normalized cloud.
+ * \param label The label, or -1.
+ * \param num The number of templates to look through.
+ *
+ * \return The index of the first such template, or -1.
+ */
+static long _find_duplicate(const dp_context_t* self, const stroke_soa_t* cloud,
+                            int label, size_t num) {
+  if (label < 0) {
+    return -1;
+  }
+  const double bound = _score_dist(self->dedup);
+  _dp_scratch_t scr;
+  _scratch_init(&scr, self->n);
+  long found = -1;
+  for (size_t i = 0; i < num && found < 0; i++) {
+    const dp_template_t* tmpl = &self->tmpls[i];
+    if (tmpl->label == label &&
+        _greedy_cloud_match(self, cloud, tmpl->strk, self->step, bound, &scr)
+        <= bound) {
+      found = i;
+    }
+  }
+  _scratch_free(&scr);
+  return found;
+}
+
+/*! Frees what a template owns.  Templates mapped from a database share their
+ * cloud and (if it has them) LUT with the mapping.
+ *
+ * \param self The $P context.
+ * \param tmpl The template.
+ * \param mapped Non-zero if the template is mapped from the database.
+ */
+static void _template_free(const dp_context_t* self, dp_template_t* tmpl,
+                           int mapped) {
+  if (!mapped) {
+    debug("  Freeing template cloud: %p ...\n", tmpl->strk);
+    stroke_soa_destroy(tmpl->strk);
+    free(tmpl->ids);
+  }
+  if (!mapped || !self->db.luts) {
+    free(tmpl->lut);
+  }
+  if (tmpl->coarse) {
+    stroke_soa_destroy(tmpl->coarse);
+  }
+  free(tmpl->packed);
+  free(tmpl->grid);
+}
+
+void dp_normalize(const stroke_t* strk, size_t n, stroke_soa_t* cloud) {
+  _normalize(strk, n, cloud);
+}
+
+// Adds a template.  Copies the stroke and name.
+void dp_add_template(dp_context_t* self, const stroke_t* strk, const char* name) {
+  EN("dp_add_template(self, strk<%ld>, \"%s\"\n", strk->num, name);
+  if (strk->num < 1) {
+    fprintf(stderr, "Error: dp_add_template called with an empty stroke\n");
+    EX("dp_add_template(self, strk<%ld>, \"%s\"\n", strk->num, name);
+    return;
+  }
+
+  dp_add_template_strokes(self, &strk, 1, name);
+  EX("dp_add_template(self, strk<%ld>, \"%s\"\n", strk->num, name);
+}
+
+void dp_add_template_strokes(dp_context_t* self, const stroke_t* const* strks,
+                             size_t num, const char* name) {
+  long pts = 0;
+  for (size_t i = 0; i < num; i++) {
+    pts += strks[i]->num;
+  }
+  if (pts < 1) {
+    fprintf(stderr, "Error: dp_add_template_strokes called with no points\n");
+    return;
+  }
+
+  // Ensure we have enough space.
+  if (self->num >= self->cap) {
+    self->cap += _DP_TMPL_INC;
+    self->tmpls = realloc(self->tmpls, self->cap * sizeof(dp_template_t));
+    debug("Reallocated self->tmpls to cap: %ld\n", self->cap);
+  }
+
+  // Add this template.
+  dp_template_t* next = &self->tmpls[self->num++];
+  next->strk = stroke_soa_create(self->n);
+  next->ids = (num > 1) ? malloc(self->n * sizeof(int)) : NULL;
+  _normalize_strokes(strks, num, self->n, next->strk, next->ids);
+  if (self->dedup > 0 &&
+      _find_duplicate(self, next->strk, dp_label(self, name), self->num - 1)
+      >= 0) {
+    debug("Not adding a duplicate \"%s\" template\n", name);
+    stroke_soa_destroy(next->strk);
+    free(next->ids);
+    self->num--;
+    return;
+  }
+  next->lut = (self->prune & DP_PRUNE_LUT) ? _lut_create(next->strk) : NULL;
+  next->packed = NULL;
+  _template_pack(self, next);
+  next->coarse = NULL;
+  if (self->coarse_n) {
+    _template_coarsen(self, next);
+  }
+  next->grid = _grid_mode(self) ? _grid_create(next->strk) : NULL;
+  next->label = _label_intern(&self->labels, name);
+  next->name = self->labels.names[next->label];
+}
+
+void dp_set_prune(dp_context_t* self, int prune) {
+  self->prune = prune;
+  if (prune & DP_PRUNE_LUT) {
+    for (int i = 0; i < self->num; i++) {
+      if (self->tmpls[i].lut == NULL) {
+        self->tmpls[i].lut = _lut_create(self->tmpls[i].strk);
+      }
+    }
+  }
+}
+
+void dp_set_precision(dp_context_t* self, dp_precision_e precision) {
+  debug("dp_set_precision(%d)\n", precision);
+  self->precision = precision;
+  for (int i = 0; i < self->num; i++) {
+    _template_pack(self, &self->tmpls[i]);
+  }
+}
+
+void dp_set_coarse_n(dp_context_t* self, size_t coarse_n) {
+  debug("dp_set_coarse_n(%zd)\n", coarse_n);
+  self->coarse_n = coarse_n;
+  for (int i = 0; i < self->num; i++) {
+    if (coarse_n) {
+      _template_coarsen(self, &self->tmpls[i]);
+    } else if (self->tmpls[i].coarse) {
+      stroke_soa_destroy(self->tmpls[i].coarse);
+      self->tmpls[i].coarse = NULL;
+    }
+  }
+}
+
+void dp_set_grid_n(dp_context_t* self, size_t grid_n) {
+  debug("dp_set_grid_n(%zd)\n", grid_n);
+  self->grid_n = grid_n;
+  const int on = _grid_mode(self);
+  for (int i = 0; i < self->num; i++) {
+    dp_template_t* tmpl = &self->tmpls[i];
+    if (on && tmpl->grid == NULL) {
+      tmpl->grid = _grid_create(tmpl->strk);
+    } else if (!on) {
+      free(tmpl->grid);
+      tmpl->grid = NULL;
+    }
+  }
+}
+
+double dp_cascade_recall(const dp_context_t* self,
+                         const stroke_t* const* strks, size_t num) {
+  dp_context_t exhaustive = *self;
+  exhaustive.coarse_n = 0;
+  dp_workspace_t* ws = dp_workspace_create(self);
+
+  size_t found = 0;
+  for (size_t i = 0; i < num; i++) {
+    const dp_template_t* tmpl = dp_recognize_ws(self, ws, strks[i]).tmpl;
+    found += tmpl == dp_recognize_ws(&exhaustive, ws, strks[i]).tmpl;
+  }
+
+  dp_workspace_destroy(ws);
+  return num ? found / (double)num : 1;
+}
+
+double dp_precision_recall(const dp_context_t* self,
+                           const stroke_t* const* strks, size_t num) {
+  dp_context_t exact = *self;
+  exact.precision = DP_PRECISION_DOUBLE;
+  dp_workspace_t* ws = dp_workspace_create(self);
+
+  size_t found = 0;
+  for (size_t i = 0; i < num; i++) {
+    const dp_template_t* tmpl = dp_recognize_ws(self, ws, strks[i]).tmpl;
+    found += tmpl == dp_recognize_ws(&exact, ws, strks[i]).tmpl;
+  }
+
+  dp_workspace_destroy(ws);
+  return num ? found / (double)num : 1;
+}
+
+int dp_add_srz(dp_context_t* self, const char* fname, const char* name) {
+  srz_reader_t* srz = srz_open(fname);
+  if (srz == NULL) {
+    return -1;
+  }
+
+  // Empty strokes and (with dedup on) near-duplicates are skipped by
+  // `dp_add_template()`, so count what actually landed in the context.
+  const size_t num = self->num;
+  stroke_t* strk;
+  while ((strk = srz_next(srz, NULL, NULL))) {
+    dp_add_template(self, strk, name);
+    stroke_destroy(strk);
+  }
+  int added = (int)(self->num - num);
+  if (srz_error(srz)) {
+    fprintf(stderr, "Error: could not read all of %s; added %d templates\n",
+            fname, added);
+    added = -1;
+  }
+  srz_close(srz);
+  return added;
+}
+
+/*! Runs a scan with as many workers as the context asks for (but no more than
+ * there are blocks of templates).  The calling thread is a worker too.
+ *
+ * \param self The $P context.
+ * \param ws The workspace.
+ * \param scan The scan.
+ * \param run The worker function.
+ *
+ * \return The number of workers that ran.
+ */
+static size_t _scan(const dp_context_t* self, dp_workspace_t* ws,
+                    _dp_scan_t* scan, void* (*run)(void*)) {
+  const size_t blocks = (self->num + _DP_SCAN_BLOCK - 1) / _DP_SCAN_BLOCK;
+  const size_t num_workers = MAX(1, MIN(self->threads, blocks));
+  _dp_worker_t* workers = ws->workers;
+  for (size_t i = 0; i < num_workers; i++) {
+    _worker_reset(&workers[i], scan);
+  }
+
+  size_t started = 1;
+  for (; started < num_workers; started++) {
+    if (pthread_create(&ws->threads[started], NULL, run, &workers[started])) {
+      fprintf(stderr, "Error: could not start $P worker thread\n");
+      break;
+    }
+  }
+  run(&workers[0]);
+  for (size_t i = 1; i < started; i++) {
+    pthread_join(ws->threads[i], NULL);
+  }
+  return started;
+}
+
+/*! Shortlists templates from their coarse clouds, into `ws->cands`, in
+ * template order.
+ *
+ * \param self The $P context.
+ * \param ws The workspace.
+ * \param scan The scan.
+ * \param result Gets the pruning counters.
+ *
+ * \return The number of templates shortlisted.
+ */
+static size_t _shortlist(const dp_context_t* self, dp_workspace_t* ws,
+                         _dp_scan_t* scan, dp_result_t* result) {
+  _coarsen(scan->cloud, self->coarse_n, ws->coarse);
+  scan->coarse = ws->coarse;
+  scan->coarse_step = round(pow(self->coarse_n, 1 - self->epsilon));
+  const size_t num_workers = _scan(self, ws, scan, _scan_coarse_run);
+
+  // Merge the workers' shortlists and keep the best, in template order.
+  size_t num = 0;
+  for (size_t i = 0; i < num_workers; i++) {
+    _dp_worker_t* w = &ws->workers[i];
+    memcpy(&ws->cands[num], w->cands, w->num_cands * sizeof(_dp_cand_t));
+    num += w->num_cands;
+    result->pruned += w->scr.pruned;
+    result->abandoned += w->scr.abandoned;
+  }
+  qsort(ws->cands, num, sizeof(_dp_cand_t), _cand_cmp);
+  num = MIN(num, self->shortlist);
+  qsort(ws->cands, num, sizeof(_dp_cand_t), _cand_index_cmp);
+  return num;
+}
+
+/*! Shortlists templates from their coarse clouds, then matches the shortlist
+ * at full resolution on the calling thread.
+ *
+ * \param self The $P context.
+ * \param ws The workspace.
+ * \param scan The scan.
+ * \param result Gets the pruning counters.
+ *
+ * \return The index of the best template.
+ */
+static long _cascade(const dp_context_t* self, dp_workspace_t* ws,
+                     _dp_scan_t* scan, dp_result_t* result) {
+  const size_t num = _shortlist(self, ws, scan, result);
+  _dp_worker_t* w = &ws->workers[0];
+  _worker_reset(w, scan);
+  for (size_t i = 0; i < num; i++) {
+    const dp_template_t* tmpl = &self->tmpls[ws->cands[i].index];
+    if (w->scr.lut &&
+        _lut_prunes(self, scan->cloud, tmpl, w->score, &w->scr)) {
+      w->scr.pruned++;
+      continue;
+    }
+    double d = _template_match(self, scan->cloud, tmpl, w->score, &w->scr);
+    if (d < w->score) {
+      w->score = d;
+      w->index = ws->cands[i].index;
+    }
+  }
+  result->score = w->score;
+  result->pruned += w->scr.pruned;
+  result->abandoned += w->scr.abandoned;
+  return w->index;
+}
+
+/*! Recognizes the query normalized into `ws->cloud`.
+ *
+ * \param self The $P context.
+ * \param ws The workspace, fit to the context, with the query.
+ *
+ * \return The result of the recognition; `tmpl` may be `NULL`.
+ */
+static dp_result_t _recognize_cloud(const dp_context_t* self,
+                                    dp_workspace_t* ws) {
+  dp_result_t result = { NULL, DBL_MAX, 0, 0, -1, -1 };
+  const double* lut = NULL;
+  if (self->prune & DP_PRUNE_LUT) {
+    _lut_fill(ws->cloud, ws->lut);
+    lut = ws->lut;
+  }
+  _dp_scan_t scan = { self, ws->cloud, lut, NULL, 0, 0, DBL_MAX };
+  if (_grid_mode(self)) {
+    _grid_fill(ws->cloud, ws->grid);
+    scan.grid = ws->grid;
+  }
+
+  long index = -1;
+  if (self->coarse_n && self->shortlist) {
+    index = _cascade(self, ws, &scan, &result);
+  } else {
+    // Try each template, see which one works.  Lowest score wins; ties go to
+    // the lowest index.
+    const size_t num_workers = _scan(self, ws, &scan, _scan_run);
+    for (size_t i = 0; i < num_workers; i++) {
+      _dp_worker_t* w = &ws->workers[i];
+      if (w->index >= 0 && (w->score < result.score ||
+                            (w->score == result.score && w->index < index))) {
+        result.score = w->score;
+        index = w->index;
+      }
+      result.pruned += w->scr.pruned;
+      result.abandoned += w->scr.abandoned;
+    }
+  }
+
+  // Normalize score in [0,1] and return the result.
+  result.tmpl = (index >= 0) ? &self->tmpls[index] : NULL;
+  result.index = index;
+  result.label = (index >= 0) ? self->tmpls[index].label : -1;
+  result.score = MAX((2.0 - result.score) / 2.0, 0);
+  return result;
+}
+
+dp_result_t dp_recognize_ws(const dp_context_t* self, dp_workspace_t* ws,
+                            const stroke_t* strk) {
+  if (strk->num < 1) {
+    dp_result_t result = { NULL, 0, 0, 0, -1, -1 };
+    return result;
+  }
+  _workspace_fit(ws, self, 0);
+  _normalize(strk, self->n, ws->cloud);
+  return _recognize_cloud(self, ws);
+}
+
+dp_result_t dp_recognize_strokes_ws(const dp_context_t* self,
+                                    dp_workspace_t* ws,
+                                    const stroke_t* const* strks, size_t num) {
+  long pts = 0;
+  for (size_t i = 0; i < num; i++) {
+    pts += strks[i]->num;
+  }
+  if (pts < 1) {
+    dp_result_t result = { NULL, 0, 0, 0, -1, -1 };
+    return result;
+  }
+  _workspace_fit(ws, self, 0);
+  _normalize_strokes(strks, num, self->n, ws->cloud, NULL);
+  return _recognize_cloud(self, ws);
+}
+
+dp_result_t dp_recognize_strokes(const dp_context_t* self,
+                                 const stroke_t* const* strks, size_t num) {
+  dp_workspace_t ws;
+  bzero(&ws, sizeof(dp_workspace_t));
+  dp_result_t result = dp_recognize_strokes_ws(self, &ws, strks, num);
+  _workspace_clear(&ws);
+  return result;
+}
+
+size_t dp_recognize_topk(const dp_context_t* self, dp_workspace_t* ws,
+                         const stroke_t* strk, size_t k, int per_class,
+                         dp_result_t* results) {
+  if (strk->num < 1 || k < 1) {
+    return 0;
+  }
+  _workspace_fit(ws, self, k);
+  _normalize(strk, self->n, ws->cloud);
+  const double* lut = NULL;
+  if (self->prune & DP_PRUNE_LUT) {
+    _lut_fill(ws->cloud, ws->lut);
+    lut = ws->lut;
+  }
+  _dp_scan_t scan = {
+    self, ws->cloud, lut, NULL, 0, 0, DBL_MAX, k, per_class
+  };
+  if (_grid_mode(self)) {
+    _grid_fill(ws->cloud, ws->grid);
+    scan.grid = ws->grid;
+  }
+  dp_result_t counts = { NULL, 0, 0, 0, -1, -1 };
+
+  size_t num_workers = 1;
+  if (self->coarse_n && self->shortlist) {
+    const size_t num = _shortlist(self, ws, &scan, &counts);
+    _worker_reset(&ws->workers[0], &scan);
+    for (size_t i = 0; i < num; i++) {
+      _topk_match(&ws->workers[0], ws->cands[i].index);
+    }
+  } else {
+    num_workers = _scan(self, ws, &scan, _scan_topk_run);
+  }
+
+  // Merge the workers' heaps, best first, and keep the best of each label.
+  size_t num = 0;
+  for (size_t i = 0; i < num_workers; i++) {
+    _dp_worker_t* w = &ws->workers[i];
+    memcpy(&ws->cands[num], w->cands, w->num_cands * sizeof(_dp_cand_t));
+    num += w->num_cands;
+    counts.pruned += w->scr.pruned;
+    counts.abandoned += w->scr.abandoned;
+  }
+  qsort(ws->cands, num, sizeof(_dp_cand_t), _cand_cmp);
+
+  size_t found = 0;
+  for (size_t i = 0; i < num && found < k; i++) {
+    dp_template_t* tmpl = &self->tmpls[ws->cands[i].index];
+    size_t j = 0;
+    for (; per_class && j < found; j++) {
+      if (results[j].label == tmpl->label) {
+        break;
+      }
+    }
+    if (per_class && j < found) {
+      continue;
+    }
+    results[found].tmpl = tmpl;
+    results[found].index = ws->cands[i].index;
+    results[found].label = tmpl->label;
+    results[found].score = MAX((2.0 - ws->cands[i].score) / 2.0, 0);
+    results[found].pruned = counts.pruned;
+    results[found].abandoned = counts.abandoned;
+    found++;
+  }
+  return found;
+}
+
+dp_result_t dp_recognize(const dp_context_t* self, const stroke_t* strk) {
+  dp_workspace_t ws;
+  bzero(&ws, sizeof(dp_workspace_t));
+  dp_result_t result = dp_recognize_ws(self, &ws, strk);
+  _workspace_clear(&ws);
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Sessions                                  //
+////////////////////////////////////////////////////////////////////////////////
+
+//! The number of points a session's stroke has room for at first.
+#define _DP_SESSION_SIZE 256
+
+//! A stroke being recognized while it's drawn.
+struct dp_session {
+  const dp_context_t* ctx;  //!< The $P context.
+  dp_workspace_t ws;        //!< The workspace peeks recognize in.
+  stroke_t* strk;           //!< The points so far.
+  double len;               //!< The length of the path along `strk`.
+  int peeked;               //!< Non-zero if `result` is of every point.
+  dp_result_t result;       //!< The result of the last peek.
+};
+
+dp_session_t* dp_session_begin(const dp_context_t* ctx) {
+  dp_session_t* self = calloc(1, sizeof(dp_session_t));
+  self->ctx = ctx;
+  _workspace_fit(&self->ws, ctx, 0);
+  self->strk = stroke_create(_DP_SESSION_SIZE);
+  return self;
+}
+
+void dp_session_add_point(dp_session_t* self, double x, double y, long t) {
+  // Sum the path's length exactly as _path_length() would.
+  const stroke_t* strk = self->strk;
+  if (strk->num > 0) {
+    const double dx = x - strk->pts[strk->num - 1].x;
+    const double dy = y - strk->pts[strk->num - 1].y;
+    self->len += sqrt(dx * dx + dy * dy);
+  }
+
+  point2dt_t pt;
+  pt.x = x;
+  pt.y = y;
+  pt.t = t;
+  stroke_add_point2dt(self->strk, &pt);
+  self->peeked = 0;
+}
+
+dp_result_t dp_session_peek(dp_session_t* self) {
+  if (self->peeked) {
+    return self->result;
+  }
+
+  const dp_context_t* ctx = self->ctx;
+  if (self->strk->num < 1) {
+    dp_result_t result = { NULL, 0, 0, 0, -1, -1 };
+    self->result = result;
+  } else {
+    _workspace_fit(&self->ws, ctx, 0);
+    _normalize_len(self->strk, self->len, ctx->n, self->ws.cloud);
+    self->result = _recognize_cloud(ctx, &self->ws);
+  }
+  self->peeked = 1;
+  return self->result;
+}
+
+void dp_session_end(dp_session_t* self) {
+  _workspace_clear(&self->ws);
+  stroke_destroy(self->strk);
+  bzero(self, sizeof(dp_session_t));
+  free(self);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Batches                                   //
+////////////////////////////////////////////////////////////////////////////////
+
+//! Number of queries matched against each block of templates together.
+#define _DP_BATCH_TILE 8
+
+//! A batch of queries, shared by the workers.
+typedef struct {
+  const dp_context_t* ctx;      //!< The $P context.
+  const stroke_t* const* strks; //!< The queries.
+  dp_result_t* results;         //!< Gets the results.
+  size_t count;                 //!< Number of queries.
+  size_t next;                  //!< Next unclaimed tile of queries; atomic.
+} _dp_batch_t;
+
+//! One worker's part of a batch.
+typedef struct {
+  _dp_batch_t* batch;                     //!< The shared batch.
+  _dp_scratch_t scr;                      //!< The worker's scratch space.
+  stroke_soa_t* clouds[_DP_BATCH_TILE];   //!< The tile's normalized queries.
+  double* luts;                           //!< The tile's LUTs, or \c NULL.
+  double score[_DP_BATCH_TILE];           //!< Best score of each query.
+  long index[_DP_BATCH_TILE];             //!< Its template, or -1.
+  dp_workspace_t* ws;                     //!< For cascades, else \c NULL.
+} _dp_batch_worker_t;
+
+/*! Matches one tile of queries against every template, a block of templates at
+ * a time, so that each block stays in cache while the whole tile is matched
+ * against it.  Each query is pruned against its own best score only, and sees
+ * the templates in order, so its result is the same as `dp_recognize()`'s.
+ *
+ * \param w The worker.
+ * \param first The first query of the tile.
+ * \param num The number of queries in the tile.
+ */
+static void _batch_tile(_dp_batch_worker_t* w, size_t first, size_t num) {
+  const dp_context_t* self = w->batch->ctx;
+  dp_result_t* results = w->batch->results + first;
+  for (size_t q = 0; q < num; q++) {
+    _normalize(w->batch->strks[first + q], self->n, w->clouds[q]);
+    if (w->luts) {
+      _lut_fill(w->clouds[q], w->luts + q * DP_LUT_SIZE * DP_LUT_SIZE);
+    }
+    w->score[q] = DBL_MAX;
+    w->index[q] = -1;
+  }
+
+  for (size_t b = 0; b < self->num; b += _DP_SCAN_BLOCK) {
+    const size_t end = MIN(b + _DP_SCAN_BLOCK, self->num);
+    for (size_t q = 0; q < num; q++) {
+      if (w->batch->strks[first + q]->num < 1) {
+        continue;
+      }
+      w->scr.lut = w->luts ? w->luts + q * DP_LUT_SIZE * DP_LUT_SIZE : NULL;
+      w->scr.pruned = 0;
+      w->scr.abandoned = 0;
+      for (size_t i = b; i < end; i++) {
+        const dp_template_t* tmpl = &self->tmpls[i];
+        if (w->scr.lut &&
+            _lut_prunes(self, w->clouds[q], tmpl, w->score[q], &w->scr)) {
+          w->scr.pruned++;
+          continue;
+        }
+        double d = _template_match(self, w->clouds[q], tmpl, w->score[q],
+                                   &w->scr);
+        if (d < w->score[q]) {
+          w->score[q] = d;
+          w->index[q] = i;
+        }
+      }
+      results[q].pruned += w->scr.pruned;
+      results[q].abandoned += w->scr.abandoned;
+    }
+  }
+
+  for (size_t q = 0; q < num; q++) {
+    results[q].tmpl = (w->index[q] >= 0) ? &self->tmpls[w->index[q]] : NULL;
+    results[q].index = w->index[q];
+    results[q].label = results[q].tmpl ? results[q].tmpl->label : -1;
+    results[q].score = (w->index[q] >= 0)
+      ? MAX((2.0 - w->score[q]) / 2.0, 0) : 0;
+  }
+}
+
+/*! Recognizes tiles of queries until there are none left.
+ *
+ * \param arg The `_dp_batch_worker_t`.
+ *
+ * \return \c NULL
+ */
+static void* _batch_run(void* arg) {
+  _dp_batch_worker_t* w = arg;
+  _dp_batch_t* batch = w->batch;
+
+  // The cascade shortlists per query; let it run one query at a time.
+  dp_context_t single = *batch->ctx;
+  single.threads = 1;
+
+  size_t i;
+  while ((i = __atomic_fetch_add(&batch->next, _DP_BATCH_TILE,
+                                 __ATOMIC_RELAXED)) < batch->count) {
+    const size_t num = MIN(_DP_BATCH_TILE, batch->count - i);
+    if (w->ws) {
+      for (size_t q = i; q < i + num; q++) {
+        batch->results[q] = dp_recognize_ws(&single, w->ws, batch->strks[q]);
+      }
+    } else {
+      _batch_tile(w, i, num);
+    }
+  }
+  return NULL;
+}
+
+void dp_recognize_batch(const dp_context_t* self, const stroke_t* const* strks,
+                        size_t count, dp_result_t* results) {
+  _dp_batch_t batch = { self, strks, results, count, 0 };
+  memset(results, 0, count * sizeof(dp_result_t));
+
+  const size_t tiles = (count + _DP_BATCH_TILE - 1) / _DP_BATCH_TILE;
+  const size_t num_workers = MAX(1, MIN(self->threads, tiles));
+  const int cascade = self->coarse_n && self->shortlist;
+  _dp_batch_worker_t* workers = calloc(num_workers,
+                                       sizeof(_dp_batch_worker_t));
+  pthread_t* threads = calloc(num_workers, sizeof(pthread_t));
+  for (size_t i = 0; i < num_workers; i++) {
+    _dp_batch_worker_t* w = &workers[i];
+    w->batch = &batch;
+    if (cascade) {
+      w->ws = dp_workspace_create(self);
+      continue;
+    }
+    _scratch_init(&w->scr, self->n);
+    for (int q = 0; q < _DP_BATCH_TILE; q++) {
+      w->clouds[q] = stroke_soa_create(self->n);
+    }
+    if (self->prune & DP_PRUNE_LUT) {
+      w->luts = malloc(_DP_BATCH_TILE * _DP_LUT_BYTES);
+    }
+  }
+
+  size_t started = 1;
+  for (; started < num_workers; started++) {
+    if (pthread_create(&threads[started], NULL, _batch_run,
+                       &workers[started])) {
+      fprintf(stderr, "Error: could not start $P worker thread\n");
+      break;
+    }
+  }
+  _batch_run(&workers[0]);
+  for (size_t i = 1; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  for (size_t i = 0; i < num_workers; i++) {
+    _dp_batch_worker_t* w = &workers[i];
+    if (w->ws) {
+      dp_workspace_destroy(w->ws);
+      continue;
+    }
+    free(w->luts);
+    for (int q = 0; q < _DP_BATCH_TILE; q++) {
+      stroke_soa_destroy(w->clouds[q]);
+    }
+    _scratch_free(&w->scr);
+  }
+  free(threads);
+  free(workers);
+}
+
+void dp_destroy(dp_context_t* self) {
+  debug("Freeing templates:\n");
+  for (size_t i = 0; i < self->num; i++) {
+    _template_free(self, &self->tmpls[i], i < self->db.num);
+  }
+  debug("  Freeing self->tmpls: %p\n", self->tmpls);
+  free(self->tmpls);
+  _labels_clear(&self->labels);
+
+  if (self->db.addr) {
+    debug("Unmapping template database: %p\n", self->db.addr);
+    free(self->db.views);
+    munmap(self->db.addr, self->db.len);
+  }
+
+  debug("Zero-ing out self: %p ...\n", self);
+  bzero(self, sizeof(dp_context_t));
+
+  debug("Freeing self...\n");
+  free(self);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Compaction                                 //
+////////////////////////////////////////////////////////////////////////////////
+
+//! A template, for grouping templates by label.
+typedef struct {
+  int label;                   //!< Its label.
+  long index;                  //!< Its index.
+} _dp_labelled_t;
+
+/*! Orders templates by label, then by index.
+ *
+ * \param a A `_dp_labelled_t`.
+ * \param b Another `_dp_labelled_t`.
+ *
+ * \return Less than, equal to, or greater than 0 as `a` comes before, with,
+ *   or after `b`.
+ */
+static int _labelled_cmp(const void* a, const void* b) {
+  const _dp_labelled_t* x = a;
+  const _dp_labelled_t* y = b;
+  if (x->label != y->label) {
+    return (x->label > y->label) - (x->label < y->label);
+  }
+  return (x->index > y->index) - (x->index < y->index);
+}
+
+//! The distances between the templates of one label, shared by the workers.
+typedef struct {
+  const dp_context_t* ctx;     //!< The $P context.
+  const _dp_labelled_t* tmpls; //!< The templates.
+  size_t num;                  //!< The number of templates.
+  double bound;                //!< Distances are capped to this.
+  double* dists;               //!< `num` by `num` capped distances.
+  size_t next;                 //!< Next unclaimed row; atomic.
+} _dp_pairs_t;
+
+//! One worker's part of the distances.
+typedef struct {
+  _dp_pairs_t* pairs;          //!< The shared distances.
+  _dp_scratch_t scr;           //!< The worker's scratch space.
+} _dp_pairs_worker_t;
+
+/*! Fills in rows of capped distances until there are none left.  Each row
+ * holds the distances to the templates after its own, which are mirrored into
+ * the lower triangle.  Matches are abandoned at the cap, so every capped
+ * distance is exact.
+ *
+ * \param arg The `_dp_pairs_worker_t`.
+ *
+ * \return \c NULL
+ */
+static void* _pairs_run(void* arg) {
+  _dp_pairs_worker_t* w = arg;
+  _dp_pairs_t* pairs = w->pairs;
+  const dp_context_t* self = pairs->ctx;
+  const size_t num = pairs->num;
+
+  size_t i;
+  while ((i = __atomic_fetch_add(&pairs->next, 1, __ATOMIC_RELAXED)) < num) {
+    const stroke_soa_t* a = self->tmpls[pairs->tmpls[i].index].strk;
+    pairs->dists[i * num + i] = 0;
+    for (size_t j = i + 1; j < num; j++) {
+      const stroke_soa_t* b = self->tmpls[pairs->tmpls[j].index].strk;
+      const double d = MIN(pairs->bound, _greedy_cloud_match(
+        self, a, b, self->step, pairs->bound, &w->scr));
+      pairs->dists[i * num + j] = pairs->dists[j * num + i] = d;
+    }
+  }
+  return NULL;
+}
+
+/*! Computes the capped distances between the templates of one label with
+ * `self->threads` threads.  The calling thread is a worker too.
+ *
+ * \param pairs The distances to compute.
+ */
+static void _pairs(_dp_pairs_t* pairs) {
+  const dp_context_t* self = pairs->ctx;
+  const size_t num_workers = MAX(1, MIN(self->threads, pairs->num));
+  _dp_pairs_worker_t* workers = calloc(num_workers,
+                                       sizeof(_dp_pairs_worker_t));
+  pthread_t* threads = calloc(num_workers, sizeof(pthread_t));
+  for (size_t i = 0; i < num_workers; i++) {
+    workers[i].pairs = pairs;
+    _scratch_init(&workers[i].scr, self->n);
+  }
+
+  size_t started = 1;
+  for (; started < num_workers; started++) {
+    if (pthread_create(&threads[started], NULL, _pairs_run,
+                       &workers[started])) {
+      fprintf(stderr, "Error: could not start $P worker thread\n");
+      break;
+    }
+  }
+  _pairs_run(&workers[0]);
+  for (size_t i = 1; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  for (size_t i = 0; i < num_workers; i++) {
+    _scratch_free(&workers[i].scr);
+  }
+  free(threads);
+  free(workers);
+}
+
+/*! Clusters the templates of one label and marks the medoid of each cluster to
+ * be kept.  Until every template is in a cluster, the one with the most
+ * neighbours (templates within the cap) not yet in a cluster leads a new
+ * cluster of itself and those neighbours; its medoid is the member with the
+ * smallest sum of capped distances to the others.  Ties go to the template
+ * added first.
+ *
+ * \param pairs The distances between the templates.
+ * \param keep Gets non-zero for each template (by index) to keep.
+ */
+static void _cluster(const _dp_pairs_t* pairs, char* keep) {
+  const size_t num = pairs->num;
+  const double* dists = pairs->dists;
+  char* done = calloc(num, 1);
+  size_t* degree = calloc(num, sizeof(size_t));
+  size_t* members = malloc(num * sizeof(size_t));
+  for (size_t i = 0; i < num; i++) {
+    for (size_t j = 0; j < num; j++) {
+      degree[i] += (i != j && dists[i * num + j] < pairs->bound);
+    }
+  }
+
+  for (size_t left = num; left > 0;) {
+    size_t lead = num;
+    for (size_t i = 0; i < num; i++) {
+      if (!done[i] && (lead == num || degree[i] > degree[lead])) {
+        lead = i;
+      }
+    }
+
+    size_t m = 0;
+    for (size_t j = 0; j < num; j++) {
+      if (!done[j] && (j == lead || dists[lead * num + j] < pairs->bound)) {
+        members[m++] = j;
+      }
+    }
+    size_t medoid = members[0];
+    double best = DBL_MAX;
+    for (size_t a = 0; a < m; a++) {
+      double sum = 0;
+      for (size_t b = 0; b < m; b++) {
+        sum += dists[members[a] * num + members[b]];
+      }
+      if (sum < best) {
+        best = sum;
+        medoid = members[a];
+      }
+    }
+    keep[pairs->tmpls[medoid].index] = 1;
+
+    // Take the cluster out of the running.
+    for (size_t a = 0; a < m; a++) {
+      done[members[a]] = 1;
+    }
+    for (size_t a = 0; a < m; a++) {
+      for (size_t j = 0; j < num; j++) {
+        if (!done[j] && dists[members[a] * num + j] < pairs->bound) {
+          degree[j]--;
+        }
+      }
+    }
+    left -= m;
+  }
+
+  free(members);
+  free(degree);
+  free(done);
+}
+
+size_t dp_compact(dp_context_t* self, double score) {
+  debug("dp_compact(%.2f)\n", score);
+  _dp_labelled_t* labelled = malloc(MAX(1, self->num) * sizeof(_dp_labelled_t));
+  for (size_t i = 0; i < self->num; i++) {
+    labelled[i].label = self->tmpls[i].label;
+    labelled[i].index = i;
+  }
+  qsort(labelled, self->num, sizeof(_dp_labelled_t), _labelled_cmp);
+
+  // Cluster the templates of each label.
+  char* keep = calloc(MAX(1, self->num), 1);
+  for (size_t first = 0, end; first < self->num; first = end) {
+    for (end = first + 1; end < self->num &&
+         labelled[end].label == labelled[first].label; end++) {
+    }
+    _dp_pairs_t pairs = {
+      self, labelled + first, end - first, _score_dist(score), NULL, 0
+    };
+    pairs.dists = malloc(pairs.num * pairs.num * sizeof(double));
+    _pairs(&pairs);
+    _cluster(&pairs, keep);
+    free(pairs.dists);
+  }
+
+  // Drop the rest, keeping the order of the templates.
+  size_t num = 0, db_num = 0;
+  for (size_t i = 0; i < self->num; i++) {
+    if (keep[i]) {
+      self->tmpls[num++] = self->tmpls[i];
+      db_num += i < self->db.num;
+    } else {
+      _template_free(self, &self->tmpls[i], i < self->db.num);
+    }
+  }
+  const size_t removed = self->num - num;
+  self->num = num;
+  self->db.num = db_num;
+
+  free(keep);
+  free(labelled);
+  return removed;
+}
+
+double dp_accuracy(const dp_context_t* self, const stroke_t* const* strks,
+                   const char* const* names, size_t num) {
+  dp_workspace_t* ws = dp_workspace_create(self);
+  size_t right = 0;
+  for (size_t i = 0; i < num; i++) {
+    const int label = dp_recognize_ws(self, ws, strks[i]).label;
+    right += label >= 0 && label == dp_label(self, names[i]);
+  }
+  dp_workspace_destroy(ws);
+  return num ? right / (double)num : 1;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//                              Shared Contexts                               //
+////////////////////////////////////////////////////////////////////////////////
+
+//! A $P context shared through snapshots.
+struct dp_shared {
+  dp_context_t* snap;       //!< The current snapshot; atomic.
+  unsigned epoch;           //!< Its low bit picks new readers' count; atomic.
+  size_t readers[2];        //!< Readers that entered in each epoch; atomic.
+  pthread_mutex_t lock;     //!< Held by writers.
+};
+
+/*! Copies a snapshot for a writer to change.  The copy gets its own arrays of
+ * templates and labels, but shares everything they point to.
+ *
+ * \param snap The snapshot.
+ *
+ * \return The copy; free with `_snapshot_free()`.
+ */
+static dp_context_t* _snapshot_copy(const dp_context_t* snap) {
+  dp_context_t* self = malloc(sizeof(dp_context_t));
+  *self = *snap;
+  self->tmpls = malloc(MAX(1, snap->cap) * sizeof(dp_template_t));
+  memcpy(self->tmpls, snap->tmpls, snap->num * sizeof(dp_template_t));
+  self->labels.names = malloc(MAX(1, snap->labels.cap) * sizeof(char*));
+  memcpy(self->labels.names, snap->labels.names,
+         snap->labels.num * sizeof(char*));
+  self->labels.slots = malloc(MAX(1, snap->labels.num_slots) * sizeof(int));
+  memcpy(self->labels.slots, snap->labels.slots,
+         snap->labels.num_slots * sizeof(int));
+  return self;
+}
+
+/*! Frees a snapshot's own arrays, but nothing they point to (the snapshot that
+ * replaced it shares that).
+ *
+ * \param self The snapshot.
+ */
+static void _snapshot_free(dp_context_t* self) {
+  free(self->tmpls);
+  free(self->labels.names);
+  free(self->labels.slots);
+  free(self);
+}
+
+/*! Waits until no reader holds a snapshot it acquired before the call.  New
+ * readers count themselves in the epoch's count, so flipping the epoch and
+ * draining the old count, twice, covers every reader that came before:
+ * even one that read the old epoch, and was counted in it, after the first
+ * drain.
+ *
+ * \param self The shared context, with its lock held.
+ */
+static void _shared_synchronize(dp_shared_t* self) {
+  for (int i = 0; i < 2; i++) {
+    const unsigned old = __atomic_fetch_add(&self->epoch, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&self->readers[old & 1], __ATOMIC_SEQ_CST)) {
+      sched_yield();
+    }
+  }
+}
+
+/*! Publishes a writer's copy of the current snapshot, unless it is unchanged,
+ * and frees the snapshot it replaces once no reader holds it.
+ *
+ * \param self The shared context, with its lock held.
+ * \param next The changed copy.
+ *
+ * \return Non-zero if it was published.
+ */
+static int _shared_publish(dp_shared_t* self, dp_context_t* next) {
+  dp_context_t* prev = self->snap;
+  if (next->num == prev->num) {
+    _snapshot_free(next);
+    return 0;
+  }
+  __atomic_store_n(&self->snap, next, __ATOMIC_SEQ_CST);
+  _shared_synchronize(self);
+  _snapshot_free(prev);
+  return 1;
+}
+
+dp_shared_t* dp_shared_create(dp_context_t* ctx) {
+  dp_shared_t* self = calloc(1, sizeof(dp_shared_t));
+  self->snap = ctx;
+  pthread_mutex_init(&self->lock, NULL);
+  return self;
+}
+
+const dp_context_t* dp_shared_acquire(dp_shared_t* self, int* ticket) {
+  *ticket = __atomic_load_n(&self->epoch, __ATOMIC_SEQ_CST) & 1;
+  __atomic_fetch_add(&self->readers[*ticket], 1, __ATOMIC_SEQ_CST);
+  return __atomic_load_n(&self->snap, __ATOMIC_SEQ_CST);
+}
+
+void dp_shared_release(dp_shared_t* self, int ticket) {
+  __atomic_fetch_sub(&self->readers[ticket], 1, __ATOMIC_SEQ_CST);
+}
+
+void dp_shared_add_template(dp_shared_t* self, const stroke_t* strk,
+                            const char* name) {
+  dp_shared_add_template_strokes(self, &strk, 1, name);
+}
+
+void dp_shared_add_template_strokes(dp_shared_t* self,
+                                    const stroke_t* const* strks, size_t num,
+                                    const char* name) {
+  pthread_mutex_lock(&self->lock);
+  dp_context_t* next = _snapshot_copy(self->snap);
+  dp_add_template_strokes(next, strks, num, name);
+  _shared_publish(self, next);
+  pthread_mutex_unlock(&self->lock);
+}
+
+size_t dp_shared_remove(dp_shared_t* self, const char* name) {
+  pthread_mutex_lock(&self->lock);
+  const dp_context_t* prev = self->snap;
+  const int label = dp_label(prev, name);
+  if (label < 0) {
+    pthread_mutex_unlock(&self->lock);
+    return 0;
+  }
+
+  // Keep the rest in order, and move the removed templates past the end, to
+  // free once no reader can hold them.  Those mapped from the database stay
+  // first on both sides.
+  dp_context_t* next = _snapshot_copy(prev);
+  dp_template_t* gone = malloc(MAX(1, prev->num) * sizeof(dp_template_t));
+  size_t num = 0, num_gone = 0, db_num = 0, db_gone = 0;
+  for (size_t i = 0; i < prev->num; i++) {
+    if (prev->tmpls[i].label != label) {
+      next->tmpls[num++] = prev->tmpls[i];
+      db_num += i < prev->db.num;
+    } else {
+      gone[num_gone++] = prev->tmpls[i];
+      db_gone += i < prev->db.num;
+    }
+  }
+  next->num = num;
+  next->db.num = db_num;
+
+  if (_shared_publish(self, next)) {
+    for (size_t i = 0; i < num_gone; i++) {
+      _template_free(next, &gone[i], i < db_gone);
+    }
+  }
+  free(gone);
+  pthread_mutex_unlock(&self->lock);
+  return num_gone;
+}
+
+void dp_shared_destroy(dp_shared_t* self) {
+  dp_destroy(self->snap);
+  pthread_mutex_destroy(&self->lock);
+  free(self);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//                             Template Databases                             //
+////////////////////////////////////////////////////////////////////////////////
+
+//! Rounds `x` up to a multiple of `m`.
+#define _DP_ROUND_UP(x, m) (((x) + (m) - 1) / (m) * (m))
+
+int dp_save_templates(const dp_context_t* self, const char* fname) {
+  FILE* fp = fopen(fname, "w");
+  if (!fp) {
+    fprintf(stderr, "Could not write to file: %s\n", fname);
+    return 0;
+  }
+
+  int luts = self->num > 0;
+  uint64_t names_size = 0;
+  for (int i = 0; i < self->num; i++) {
+    luts = luts && self->tmpls[i].lut;
+    names_size += strlen(self->tmpls[i].name) + 1;
+  }
+
+  const uint64_t header_size =
+    _DP_ROUND_UP(sizeof(dp_db_header_t), STROKE_SOA_ALIGN);
+  const uint64_t stride = _DP_ROUND_UP(self->n, STROKE_SOA_PAD);
+  const uint64_t clouds_size = 2 * stride * sizeof(double) * self->num;
+  char header[header_size];
+  bzero(header, sizeof(header));
+  dp_db_header_t* h = (dp_db_header_t*)header;
+  memcpy(h->magic, DP_DB_MAGIC, sizeof(h->magic));
+  h->version = DP_DB_VERSION;
+  h->bom = DP_DB_BOM;
+  h->header_size = header_size;
+  h->n = self->n;
+  h->epsilon = self->epsilon;
+  h->num = self->num;
+  h->stride = stride;
+  h->lut_offset = luts ? header_size + clouds_size : 0;
+  h->names_offset = header_size + clouds_size +
+    (luts ? self->num * _DP_LUT_BYTES : 0);
+  h->names_size = names_size;
+
+  int ok = fwrite(header, sizeof(header), 1, fp) == 1;
+  for (int i = 0; ok && i < self->num; i++) {
+    const stroke_soa_t* cloud = self->tmpls[i].strk;
+    ok = stroke_bin_write_column(fp, cloud->x, self->n, stride) &&
+      stroke_bin_write_column(fp, cloud->y, self->n, stride);
+  }
+  for (int i = 0; ok && luts && i < self->num; i++) {
+    ok = fwrite(self->tmpls[i].lut, _DP_LUT_BYTES, 1, fp) == 1;
+  }
+  uint64_t offset = 0;
+  for (int i = 0; ok && i < self->num; i++) {
+    ok = fwrite(&offset, sizeof(offset), 1, fp) == 1;
+    offset += strlen(self->tmpls[i].name) + 1;
+  }
+  for (int i = 0; ok && i < self->num; i++) {
+    const char* name = self->tmpls[i].name;
+    ok = fwrite(name, strlen(name) + 1, 1, fp) == 1;
+  }
+  ok = (fclose(fp) == 0) && ok;
+  if (!ok) {
+    fprintf(stderr, "Could not write to file: %s\n", fname);
+  }
+  return ok;
+}
+
+/*! Checks that a header describes a valid database of `len` bytes.
+ *
+ * \param h The header.
+ * \param len The length of the file.
+ * \param fname The name of the file (for error messages).
+ *
+ * \return 1 if valid, 0 o.w.
+ */
+static inline int
+_check_db_header(const dp_db_header_t* h, size_t len, const char* fname) {
+  if (!stroke_bin_check_preamble(h, DP_DB_MAGIC, DP_DB_VERSION,
+                                 sizeof(dp_db_header_t), len,
+                                 "$P template database", fname)) {
+    return 0;
+  }
+
+  // Sizes are checked piece by piece so that none of the sums can overflow.
+  const uint64_t cloud_size = 2 * sizeof(double) * h->stride;
+  if (h->n < 1 || h->epsilon < 0 || h->epsilon > 1 ||
+      h->stride < h->n || h->stride % STROKE_SOA_PAD ||
+      h->stride > len / (2 * sizeof(double)) ||
+      h->num > (len - h->header_size) / cloud_size) {
+    fprintf(stderr, "Error: %s is corrupt.\n", fname);
+    return 0;
+  }
+  const uint64_t clouds_end = h->header_size + h->num * cloud_size;
+  if ((h->lut_offset && (h->lut_offset != clouds_end ||
+                         h->num > (len - h->lut_offset) / _DP_LUT_BYTES)) ||
+      h->names_offset != (h->lut_offset
+                          ? h->lut_offset + h->num * _DP_LUT_BYTES
+                          : clouds_end) ||
+      h->num > (len - h->names_offset) / sizeof(uint64_t) ||
+      h->names_size != len - h->names_offset - h->num * sizeof(uint64_t)) {
+    fprintf(stderr, "Error: %s is corrupt.\n", fname);
+    return 0;
+  }
+
+  // Every name must start inside the names, which must end in a NUL.
+  const uint64_t* offsets =
+    (const uint64_t*)((const char*)h + h->names_offset);
+  const char* names = (const char*)(offsets + h->num);
+  if (h->num && (h->names_size == 0 || names[h->names_size - 1] != '\0')) {
+    fprintf(stderr, "Error: %s is corrupt.\n", fname);
+    return 0;
+  }
+  for (uint64_t i = 0; i < h->num; i++) {
+    if (offsets[i] >= h->names_size) {
+      fprintf(stderr, "Error: %s is corrupt.\n", fname);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+dp_context_t* dp_open_templates(const char* fname) {
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Could not read from file: %s\n", fname);
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < (off_t)sizeof(dp_db_header_t)) {
+    fprintf(stderr, "Error: %s is not a $P template database.\n", fname);
+    close(fd);
+    return NULL;
+  }
+
+  const size_t len = st.st_size;
+  void* addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    fprintf(stderr, "Could not map %s: %s\n", fname, strerror(errno));
+    return NULL;
+  }
+
+  const dp_db_header_t* h = addr;
+  if (!_check_db_header(h, len, fname)) {
+    munmap(addr, len);
+    return NULL;
+  }
+
+  dp_context_t* self = dp_create();
+  self->n = h->n;
+  dp_set_epsilon(self, h->epsilon);
+  if (self->cap < h->num) {
+    free(self->tmpls);
+    self->cap = _DP_ROUND_UP(h->num, _DP_TMPL_INC);
+    self->tmpls = calloc(self->cap, sizeof(dp_template_t));
+  }
+
+  self->db.addr = addr;
+  self->db.len = len;
+  self->db.num = h->num;
+  self->db.luts = h->lut_offset != 0;
+  self->db.views = calloc(h->num, sizeof(stroke_soa_t));
+
+  char* base = addr;
+  const uint64_t* offsets = (const uint64_t*)(base + h->names_offset);
+  const char* names = (const char*)(offsets + h->num);
+  for (uint64_t i = 0; i < h->num; i++) {
+    stroke_soa_t* view = &self->db.views[i];
+    view->num = h->n;
+    view->size = h->stride;
+    view->x = (double*)(base + h->header_size) + 2 * h->stride * i;
+    view->y = view->x + h->stride;
+
+    dp_template_t* tmpl = &self->tmpls[i];
+    tmpl->strk = view;
+    tmpl->lut = h->lut_offset
+      ? (double*)(base + h->lut_offset) + DP_LUT_SIZE * DP_LUT_SIZE * i
+      : NULL;
+    tmpl->label = _label_intern(&self->labels, names + offsets[i]);
+    tmpl->name = self->labels.names[tmpl->label];
+  }
+  self->num = h->num;
+  if (self->db.luts) {
+    self->prune |= DP_PRUNE_LUT;
+  }
+  dp_set_grid_n(self, self->grid_n);
+  return self;
+}
+
+#undef _DP_ROUND_UP
@@ -1,47 +1,208 @@
 #ifndef __dollarp_h__
 #define __dollarp_h__
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-#define DEBUG
 #include "common/debug.h"
 #include "common/stroke.h"
+#include "common/stroke_bin.h"
+#include "common/stroke_soa.h"
 
 //! Maximum allowable name for templates.
 #define DP_MAX_TMPL_NAME_LEN 100
 
-//! A template -- used to recognize strokes.
+//! Number of cells along each side of a `dp_template_t.lut`.
+#define DP_LUT_SIZE 32
+
+/*! A template -- used to recognize strokes.
+ *
+ * `lut` covers \f$[-1,1]^2\f$ (where every normalized cloud lies) with a
+ * `DP_LUT_SIZE` by `DP_LUT_SIZE` grid, and holds the distance from the center
+ * of each cell to the nearest point of the cloud, row by row.
+ *
+ * `ids` holds, for templates made from several strokes, the index of the stroke
+ * each point of `strk` was resampled from, for diagnostics.
+ *
+ * `packed` is the cloud again, in the reduced precision the context matches
+ * at (see `dp_precision_e`): `n` X-coordinates, then `n` Y-coordinates.
+ *
+ * `grid` buckets the points of `strk` into a uniform grid of cells over
+ * \f$[-1,1]^2\f$, about one point to a cell: the offset of each cell's first
+ * point, row by row (and one past the last), then the index of every point,
+ * by cell.  Templates have one when `n` is at least `dp_context_t.grid_n`.
+ *
+ * `name` is the string of the template's class label, `label`, interned in the
+ * context's `dp_labels_t`: templates of one class share one string and compare
+ * by `label`.
+ *
+ * The templates of a database opened with `dp_open_templates()` point into the
+ * mapped file; their clouds have no times (`strk->t` is \c NULL).
+ */
 typedef struct {
-  stroke_t* strk;                     //!< The underlying stroke.
-  char name[DP_MAX_TMPL_NAME_LEN+1];  //!< Name of the template.
+  stroke_soa_t* strk;     //!< The normalized point cloud.
+  int* ids;               //!< Stroke of each point, or \c NULL if just one.
+  void* packed;           //!< The packed cloud, or \c NULL.
+  double* lut;            //!< Nearest-point LUT, or \c NULL.
+  stroke_soa_t* coarse;   //!< The cloud at `coarse_n` points, or \c NULL.
+  int* grid;              //!< Grid of the cloud's points, or \c NULL.
+  const char* name;       //!< Name of the template.
+  int label;              //!< Class label of the template.
 } dp_template_t;
 
+/*! The class labels of a context's templates.  Each distinct template name is
+ * stored once, and its index in `names` is the label of every template with
+ * that name.  `slots` is an open-addressing hash table of labels (-1 when
+ * empty) by the hash of their names.
+ */
+typedef struct {
+  char** names;           //!< Name of each label.
+  size_t num;             //!< Number of labels.
+  size_t cap;             //!< Capacity of `names`.
+  int* slots;             //!< The hash table; a power of 2 long.
+  size_t num_slots;       //!< Number of slots.
+} dp_labels_t;
+
+//! The magic bytes at the start of every template database.
+#define DP_DB_MAGIC "SRDP"
+
+//! The current version of the template database format.
+#define DP_DB_VERSION 1
+
+//! Written to `dp_db_header_t.bom` to detect the file's byte order.
+#define DP_DB_BOM STROKE_BIN_BOM
+
+/*! The header of a template database written by `dp_save_templates()`.
+ *
+ * The header is followed (at `header_size`, a multiple of `STROKE_SOA_ALIGN`)
+ * by each template's cloud: `stride` X-coordinates, then `stride`
+ * Y-coordinates.  If `lut_offset` is not 0, the templates' LUTs follow, in
+ * order.  At `names_offset` are `num` 64-bit offsets into the names, which are
+ * the `names_size` bytes that follow, each terminated by a `NUL`.  It starts
+ * with the fields of a `stroke_bin_preamble_t`.
+ */
+typedef struct {
+  char magic[4];          //!< Always `DP_DB_MAGIC`.
+  uint32_t version;       //!< Format version; `DP_DB_VERSION`.
+  uint32_t bom;           //!< Always `DP_DB_BOM` in the writer's order.
+  uint32_t header_size;   //!< Offset of the first cloud in bytes.
+  uint64_t n;             //!< Number of points in each cloud.
+  double epsilon;         //!< The context's `epsilon`.
+  uint64_t num;           //!< Number of templates.
+  uint64_t stride;        //!< Number of elements in each column.
+  uint64_t lut_offset;    //!< Offset of the LUTs, or 0 if there are none.
+  uint64_t names_offset;  //!< Offset of the name offsets.
+  uint64_t names_size;    //!< Number of bytes of names.
+} dp_db_header_t;
+
+//! A template database mapped by `dp_open_templates()`.
+typedef struct {
+  void* addr;             //!< Start of the mapping, or \c NULL.
+  size_t len;             //!< Length of the mapping in bytes.
+  size_t num;             //!< Number of templates (first in `tmpls`) in it.
+  stroke_soa_t* views;    //!< Views of the mapped clouds.
+  int luts;               //!< Non-zero if the mapped templates' LUTs are in it.
+} dp_db_t;
+
 //! Default value for `dp_context_t.n`.
 #define DP_DEFAULT_N 32
 
 //! Default value for `dp_context_t.epsilon`.
 #define DP_DEFAULT_EPSILON 0.50
 
+/*! Ways to cut the template search short, combined into
+ * `dp_context_t.prune`.  None of them change the result of a recognition.
+ */
+typedef enum {
+  //! Stop an alignment once its partial cost exceeds the best so far.
+  DP_PRUNE_ABANDON  = 0x1,
+  //! Skip alignments (and templates) whose lower bound, from each point's
+  //! nearest neighbour, exceeds the best so far.
+  DP_PRUNE_BOUND    = 0x2,
+  //! Skip templates whose lower bound from `dp_template_t.lut` exceeds the
+  //! best so far, before computing any distances between the clouds.
+  DP_PRUNE_LUT      = 0x4
+} dp_prune_m;
+
+/*! The precision of the clouds templates are matched against.  Queries are
+ * always normalized and matched in `double`; only the templates' coordinates
+ * are rounded.  Packed clouds are 3 (`float`) or 6 (`int16_t`) times smaller
+ * than the `stroke_soa_t` ones, so scans read that much less memory.
+ */
+typedef enum {
+  DP_PRECISION_DOUBLE,    //!< Match against `dp_template_t.strk`.
+  DP_PRECISION_FLOAT,     //!< Match against `float` packed clouds.
+  DP_PRECISION_INT16      //!< Match against `int16_t` packed clouds.
+} dp_precision_e;
+
+/*! `DP_PRECISION_INT16` stores each coordinate \f$x \in [-1,1]\f$ as
+ * \f$x \cdot\f$ `DP_INT16_SCALE`, rounded.
+ */
+#define DP_INT16_SCALE 32767
+
+//! Default value for `dp_context_t.prune`.
+#define DP_DEFAULT_PRUNE (DP_PRUNE_ABANDON | DP_PRUNE_BOUND)
+
+//! Default value for `dp_context_t.threads`.
+#define DP_DEFAULT_THREADS 1
+
+//! Default value for `dp_context_t.shortlist`.
+#define DP_DEFAULT_SHORTLIST 32
+
+//! Default value for `dp_context_t.grid_n`.
+#define DP_DEFAULT_GRID_N 192
+
 /*! The main $P context.
  *
  * This structure holds the templates and some heuristic values.  Feel free to
- * alter `n`, and `epsilon`, but DO NOT mess with `tmpls`, `num`, or `cap`.
+ * alter `epsilon`, but DO NOT mess with `tmpls`, `num`, or `cap`.  Change `n`
+ * with [\ref dp_set_n(dp_context_t*, size_t)], before any templates are
+ * added.
+ * Change `prune` with [\ref dp_set_prune(dp_context_t*, int)].
  */
 typedef struct {
   size_t n;               //!< Number of strokes to use in `normalize`.
   double epsilon;         //!< \in [0,1], controls # of tested alignments.
   double step;            //!< Step used for scanning a stroke.
+  int prune;              //!< Mask of `dp_prune_m` values in use.
+  size_t threads;         //!< Number of threads scanning the templates.
+  size_t coarse_n;        //!< Points in the cascade's coarse pass; 0 for none.
+  size_t shortlist;       //!< Templates kept by the coarse pass.
+  dp_precision_e precision; //!< Precision of the templates matched against.
+  double dedup;           //!< Score at which added templates are duplicates.
+  size_t grid_n;          //!< Smallest `n` matched through grids; 0 for none.
 
   dp_template_t* tmpls;   //!< Array of templates to use.
   size_t num;             //!< Number of templates.
   size_t cap;             //!< Capacity of the `tmpls` array.
+  dp_labels_t labels;     //!< Class labels of the templates.
+  dp_db_t db;             //!< The mapped database, if any.
 } dp_context_t;
 
+/*! Scratch space for recognitions; see
+ * [\ref dp_workspace_create(const dp_context_t*)].
+ */
+typedef struct dp_workspace dp_workspace_t;
+
+/*! A stroke being recognized while it's drawn; see
+ * [\ref dp_session_begin(const dp_context_t*)].
+ */
+typedef struct dp_session dp_session_t;
+
+/*! A $P context whose templates change while other threads recognize with it;
+ * see [\ref dp_shared_create(dp_context_t*)].
+ */
+typedef struct dp_shared dp_shared_t;
+
 //! A result of calling dp_recognize.
 typedef struct {
   dp_template_t* tmpl;    //!< The template recognition.
   double score;           //!< The score of the recognition.
+  size_t pruned;          //!< Templates skipped by a lower bound.
+  size_t abandoned;       //!< Alignments skipped or stopped early.
+  long index;             //!< Index of the template, or -1.
+  int label;              //!< Class label of the template, or -1.
 } dp_result_t;
 
 
@@ -50,18 +211,30 @@ typedef struct {
  */
 dp_context_t* dp_create();
 
+/*! Normalizes a stroke as $P does: resamples it to `n` points evenly spaced
+ * along its path, scales it to fit the unit square, and centers it at the
+ * origin.  Other recognizers can share this preprocessing.
+ *
+ * \param strk The stroke; must not be empty.
+ * \param n The number of points to resample to.
+ * \param cloud Gets the normalized cloud; must have room for `n` points.
+ */
+void dp_normalize(const stroke_t* strk, size_t n, stroke_soa_t* cloud);
+
 /*! Sets the number of points in a normalized template/stroke.  Must be greater
- * than 0.
+ * than 0, and must be set before any templates are added or opened, since
+ * their clouds would no longer fit.
  *
  * \param self The $P context.
  * \param n The number of points to set per template/stroke.
  *
- * \return 0 on success, 1 if `n` is too low.
+ * \return 0 on success, 1 if `n` is too low or there are templates already.
  */
 static inline int dp_set_n(dp_context_t* self, size_t n) {
   debug("dp_set_n(%zd)\n", n);
-  if (n <= 0) {
-    fprintf(stderr, "Error: dp_set_n called with n = %zd\n", n);
+  if (n <= 0 || self->num > 0) {
+    fprintf(stderr, "Error: dp_set_n called with n = %zd and %zd templates\n",
+            n, self->num);
     EX("dp_set_n(%zd)\n", n);
     return 1;
   }
@@ -95,8 +268,97 @@ static inline int dp_set_epsilon(dp_context_t* self, double epsilon) {
   return 0;
 }
 
-/*! Adds a new template to the $P context.  The $P context takes ownership of
- * the stroke and will most likely mutate it.
+/*! Sets the number of threads that scan the templates in
+ * [\ref dp_recognize(const dp_context_t*, const stroke_t*)].  Must be greater
+ * than 0.  The result does not depend on the number of threads; ties always go
+ * to the template added first.  (The pruning counters do.)
+ *
+ * \param self The $P context.
+ * \param threads The number of threads.
+ *
+ * \return 0 on success, 1 if `threads` is too low.
+ */
+static inline int dp_set_threads(dp_context_t* self, size_t threads) {
+  debug("dp_set_threads(%zd)\n", threads);
+  if (threads <= 0) {
+    fprintf(stderr, "Error: dp_set_threads called with threads = %zd\n",
+            threads);
+    return 1;
+  }
+
+  self->threads = threads;
+  return 0;
+}
+
+/*! Turns on the coarse-to-fine cascade: a first pass compares every template
+ * at `coarse_n` points (e.g., 8 or 16) and shortlists the best
+ * `dp_context_t.shortlist`, which are then compared at full resolution.  This
+ * trades exactness for speed with large sets of templates; measure what it
+ * costs with `dp_cascade_recall()`.  Builds the coarse cloud of every
+ * template.
+ *
+ * \param self The $P context.
+ * \param coarse_n The number of points in the coarse pass, or 0 to turn the
+ *   cascade off.
+ */
+void dp_set_coarse_n(dp_context_t* self, size_t coarse_n);
+
+/*! Sets the smallest `n` at which clouds are matched through their grids (see
+ * `dp_template_t.grid`) rather than through the matrix of distances between
+ * them.  Each nearest-point search then visits only the cells around the
+ * point, instead of every point, which pays off with high-resolution clouds.
+ * The results are the same either way.  Templates matched at a reduced
+ * precision, and batches, always use the matrix.  Builds (or frees) the grid
+ * of every template.
+ *
+ * \param self The $P context.
+ * \param grid_n The smallest `n`, or 0 to never use grids.
+ */
+void dp_set_grid_n(dp_context_t* self, size_t grid_n);
+
+/*! Sets the number of templates the cascade's coarse pass shortlists.  0 turns
+ * the cascade off.
+ *
+ * \param self The $P context.
+ * \param shortlist The number of templates to shortlist.
+ */
+static inline void dp_set_shortlist(dp_context_t* self, size_t shortlist) {
+  debug("dp_set_shortlist(%zd)\n", shortlist);
+  self->shortlist = shortlist;
+}
+
+/*! Sets the score at which a template being added duplicates an existing
+ * template of the same name, and is not added.  0 (the default) adds every
+ * template.
+ *
+ * \param self The $P context.
+ * \param dedup The score, \f$\in [0,1]\f$, or 0.
+ */
+static inline void dp_set_dedup(dp_context_t* self, double dedup) {
+  debug("dp_set_dedup(%.2f)\n", dedup);
+  self->dedup = dedup;
+}
+
+/*! Sets the ways the template search is cut short.  Enabling
+ * `DP_PRUNE_LUT` builds the LUTs of templates that don't have one yet.
+ *
+ * \param self The $P context.
+ * \param prune A mask of `dp_prune_m` values.
+ */
+void dp_set_prune(dp_context_t* self, int prune);
+
+/*! Sets the precision of the template clouds recognitions match against, and
+ * packs (or frees) every template's `packed` cloud accordingly.  Rounding the
+ * templates can change which one a stroke is recognized as, in close calls;
+ * measure how often with `dp_precision_recall()`.
+ *
+ * \param self The $P context.
+ * \param precision The precision.
+ */
+void dp_set_precision(dp_context_t* self, dp_precision_e precision);
+
+/*! Adds a new template to the $P context.  The stroke is normalized into a
+ * new cloud and is not modified.
  *
  * Note that the maximum length of stroke names are limited to
  * `DP_MAX_TMPL_NAME_LEN`.  Names will be truncated to this length.
@@ -106,12 +368,357 @@ static inline int dp_set_epsilon(dp_context_t* self, double epsilon) {
  */
 void dp_add_template(dp_context_t* self, const stroke_t* strk, const char* name);
 
+/*! Adds a new multistroke template to the $P context.  The strokes are
+ * resampled as one path, in order, without copying them together, and the
+ * stroke of each point is kept in `dp_template_t.ids`.  To split one stroke
+ * into several without copying, pass views of it, e.g.,
+ * `{ len, len, strk->pts + start }`.
+ *
+ * \param self The $P context.
+ * \param strks The strokes the template is based on.
+ * \param num The number of strokes.
+ * \param name The name of the template.
+ */
+void dp_add_template_strokes(dp_context_t* self, const stroke_t* const* strks,
+                             size_t num, const char* name);
+
+/*! Adds every stroke in an `.srz` archive as a template with the given name.
+ * The strokes are read straight from the (memory-mapped) archive.
+ *
+ * \param self The $P context.
+ * \param fname The `.srz` archive to read.
+ * \param name The name of the templates.
+ *
+ * \return The number of templates added, or -1 if the archive could not be
+ *   read in full.  The strokes before a bad entry are still added.
+ */
+int dp_add_srz(dp_context_t* self, const char* fname, const char* name);
+
+/*! Looks up the class label of templates with a name.  Names are compared up
+ * to `DP_MAX_TMPL_NAME_LEN` characters, as they are stored.
+ *
+ * \param self The $P context.
+ * \param name The name.
+ *
+ * \return The label, or -1 if no template has the name.
+ */
+int dp_label(const dp_context_t* self, const char* name);
+
+/*! Gets the name of a class label.
+ *
+ * \param self The $P context.
+ * \param label The label.
+ *
+ * \return The name, or \c NULL if there is no such label.
+ */
+static inline const char* dp_label_name(const dp_context_t* self, int label) {
+  return (label >= 0 && (size_t)label < self->labels.num)
+    ? self->labels.names[label] : NULL;
+}
+
+/*! Saves the context's templates, already normalized, along with `n`,
+ * `epsilon` and the templates' names (and LUTs, if every template has one) to
+ * a single file that [\ref dp_open_templates(const char*)] can map.
+ *
+ * \param self The $P context.
+ * \param fname The file to write.
+ *
+ * \return 1 on success, 0 o.w.
+ */
+int dp_save_templates(const dp_context_t* self, const char* fname);
+
+/*! Creates a $P context from a template database written by
+ * [\ref dp_save_templates(const dp_context_t*, const char*)].  The file is
+ * mapped read-only and shared, so its templates are used in place (and their
+ * pages shared by every process that opens it).  More templates can be added
+ * as usual; the file must not change while the context exists.
+ *
+ * \param fname The database.
+ *
+ * \return The context (destroy with `dp_destroy()`), or \c NULL on error.
+ */
+dp_context_t* dp_open_templates(const char* fname);
+
+/*! Creates a workspace for
+ * [\ref dp_recognize_ws(const dp_context_t*, dp_workspace_t*, const stroke_t*)]
+ * sized for the context's current settings.
+ *
+ * \param ctx The $P context.
+ *
+ * \return The workspace.
+ */
+dp_workspace_t* dp_workspace_create(const dp_context_t* ctx);
+
+/*! Destroys a workspace and frees all its memory.
+ *
+ * \param self The workspace.
+ */
+void dp_workspace_destroy(dp_workspace_t* self);
+
+/*! Attempts to recognize the stroke as one of the templates previously added to
+ * the context with `db_add_template`.  The stroke is not modified.
+ *
+ * Every temporary lives in `ws`, so once `ws` fits the context no memory is
+ * allocated (other than by `pthread_create()` when `self->threads` > 1).  `ws`
+ * is regrown if `self->n`, `self->threads` or `self->prune` changed.  A
+ * workspace may only be used by one recognition at a time; the context may be
+ * shared.
+ *
+ * \param self The $P context.
+ * \param ws The workspace.
+ * \param strk The stroke to recognize.
+ *
+ * \return The result of the recognition; `tmpl` may be `NULL`.
+ */
+dp_result_t dp_recognize_ws(const dp_context_t* self, dp_workspace_t* ws,
+                            const stroke_t* strk);
+
 /*! Attempts to recognize the stroke as one of the templates previously added to
- * the context with `db_add_template`.
+ * the context with `db_add_template`.  The stroke is not modified.  Allocates
+ * a workspace for the call; use
+ * [\ref dp_recognize_ws(const dp_context_t*, dp_workspace_t*, const stroke_t*)]
+ * to reuse one instead.
+ *
+ * \param self The $P context.
+ * \param strk The stroke to recognize.
+ *
+ * \return The result of the recognition; `tmpl` may be `NULL`.
+ */
+dp_result_t dp_recognize(const dp_context_t* self, const stroke_t* strk);
+
+/*! Finds the `k` templates the stroke is most like, best first.  The scan
+ * keeps a bounded heap of the best `k` templates so far (per thread), whose
+ * last template bounds every match, so pruning works as in
+ * [\ref dp_recognize(const dp_context_t*, const stroke_t*)], whose result is
+ * the first.  Ties go to the template added first.  With `per_class`, only the
+ * best template of each name is kept, so the results are the `k` best names.
+ *
+ * Like `dp_recognize_ws()`, allocates nothing once `ws` fits the context and
+ * `k`.  With the cascade on, the top-k is of the shortlist.
+ *
+ * \param self The $P context.
+ * \param ws The workspace.
+ * \param strk The stroke to recognize.
+ * \param k The number of results to find.
+ * \param per_class Non-zero to find the best template of each name.
+ * \param results Gets up to `k` results.  The pruning counters of each are
+ *   those of the whole recognition.
+ *
+ * \return The number of results found; less than `k` if there are fewer
+ *   templates (or names).
+ */
+size_t dp_recognize_topk(const dp_context_t* self, dp_workspace_t* ws,
+                         const stroke_t* strk, size_t k, int per_class,
+                         dp_result_t* results);
+
+/*! Attempts to recognize several strokes, as one multistroke, as one of the
+ * templates; see `dp_add_template_strokes()`.  The strokes are not modified
+ * or copied.
+ *
+ * \param self The $P context.
+ * \param ws The workspace; see `dp_recognize_ws()`.
+ * \param strks The strokes to recognize.
+ * \param num The number of strokes.
+ *
+ * \return The result of the recognition; `tmpl` may be `NULL`.
+ */
+dp_result_t dp_recognize_strokes_ws(const dp_context_t* self,
+                                    dp_workspace_t* ws,
+                                    const stroke_t* const* strks, size_t num);
+
+/*! Attempts to recognize several strokes, as one multistroke, as one of the
+ * templates.  Allocates a workspace for the call.
+ *
+ * \param self The $P context.
+ * \param strks The strokes to recognize.
+ * \param num The number of strokes.
+ *
+ * \return The result of the recognition; `tmpl` may be `NULL`.
+ */
+dp_result_t dp_recognize_strokes(const dp_context_t* self,
+                                 const stroke_t* const* strks, size_t num);
+
+/*! Begins recognizing a stroke while it's drawn.  Points are added one at a
+ * time with [\ref dp_session_add_point(dp_session_t*, double, double, long)],
+ * and [\ref dp_session_peek(dp_session_t*)] recognizes the points so far.
+ *
+ * The session keeps the stroke's path length up to date as points arrive and
+ * recognizes in a workspace of its own, so a peek only resamples the stroke
+ * (one pass) before matching it, and allocates nothing.
+ *
+ * \param ctx The $P context; must outlive the session.
+ *
+ * \return The session; end with `dp_session_end()`.
+ */
+dp_session_t* dp_session_begin(const dp_context_t* ctx);
+
+/*! Adds a point to the end of a session's stroke.
+ *
+ * \param self The session.
+ * \param x The X-coordinate of the point.
+ * \param y The Y-coordinate of the point.
+ * \param t The time of the point.
+ */
+void dp_session_add_point(dp_session_t* self, double x, double y, long t);
+
+/*! Recognizes the points of a session so far.  The result is the same as
+ * [\ref dp_recognize(const dp_context_t*, const stroke_t*)]'s for a stroke of
+ * those points.  Peeking again before another point is added returns the same
+ * result without matching again.
+ *
+ * \param self The session.
+ *
+ * \return The best guess; `tmpl` is \c NULL until a point is added.
+ */
+dp_result_t dp_session_peek(dp_session_t* self);
+
+/*! Ends a session and frees all its memory.
+ *
+ * \param self The session.
+ */
+void dp_session_end(dp_session_t* self);
+
+/*! Recognizes many strokes at once, for throughput.  Queries are matched in
+ * tiles against blocks of templates, so each block is read from memory once
+ * per tile rather than once per query, and tiles are spread across
+ * `self->threads` threads.  Each result is the same as
+ * [\ref dp_recognize(const dp_context_t*, const stroke_t*)]'s.
+ *
+ * \param self The $P context.
+ * \param strks The strokes to recognize.
+ * \param count The number of strokes.
+ * \param results Gets the `count` results.
+ */
+void dp_recognize_batch(const dp_context_t* self, const stroke_t* const* strks,
+                        size_t count, dp_result_t* results);
+
+/*! Measures the cascade's recall: the fraction of strokes it recognizes as the
+ * same template an exhaustive search does.
+ *
+ * \param self The $P context, with the cascade on.
+ * \param strks The strokes to recognize.
+ * \param num The number of strokes.
+ *
+ * \return The recall, \f$\in [0,1]\f$.
+ */
+double dp_cascade_recall(const dp_context_t* self,
+                         const stroke_t* const* strks, size_t num);
+
+/*! Measures the accuracy of reduced precision templates: the fraction of
+ * strokes recognized as the same template as when matching in `double`.
+ *
+ * \param self The $P context, with reduced precision set.
+ * \param strks The strokes to recognize.
+ * \param num The number of strokes.
+ *
+ * \return The recall, \f$\in [0,1]\f$.
+ */
+double dp_precision_recall(const dp_context_t* self,
+                           const stroke_t* const* strks, size_t num);
+
+/*! Compacts the templates by clustering near-identical templates of each name
+ * and keeping only the medoid of each cluster.  Two templates are neighbours
+ * when they match each other with at least the given score; clusters are
+ * grown greedily around the templates with the most neighbours.  The pairwise
+ * matches are split among `threads` threads.  The surviving templates keep
+ * their order.
+ *
+ * \param self The $P context.
+ * \param score The score, \f$\in [0,1]\f$, at which templates are neighbours.
+ *
+ * \return The number of templates removed.
+ */
+size_t dp_compact(dp_context_t* self, double score);
+
+/*! Measures the accuracy of the templates on labelled strokes, e.g., to check
+ * a held-out set before and after `dp_compact()`.
+ *
+ * \param self The $P context.
+ * \param strks The strokes to recognize.
+ * \param names The name each stroke should be recognized as.
+ * \param num The number of strokes.
+ *
+ * \return The fraction recognized correctly, \f$\in [0,1]\f$.
+ */
+double dp_accuracy(const dp_context_t* self, const stroke_t* const* strks,
+                   const char* const* names, size_t num);
+
+/*! Shares a $P context between threads that recognize with it and threads
+ * that add or remove its templates.  The context becomes the first of a series
+ * of immutable snapshots: each change copies the current snapshot (its array
+ * of templates and labels, not the templates' clouds), changes the copy, and
+ * publishes it atomically.  Readers never block, and never see a snapshot
+ * change under them.  A replaced snapshot is freed once every reader that
+ * might still hold it has released it, which writers wait for by draining the
+ * reader counts of two alternating epochs.  Writers are serialized, and each
+ * change costs a copy of the array of templates.
+ *
+ * Settings must be made on the context before it is shared.
+ *
+ * \param ctx The $P context; the shared context takes it over.
+ *
+ * \return The shared context.
+ */
+dp_shared_t* dp_shared_create(dp_context_t* ctx);
+
+/*! Gets the current snapshot of a shared context, to recognize with.  It,
+ * and the results of recognizing with it, stay valid until it is released
+ * with `dp_shared_release()`.  Never blocks.
+ *
+ * \param self The shared context.
+ * \param ticket Gets the ticket to release the snapshot with.
+ *
+ * \return The snapshot.
+ */
+const dp_context_t* dp_shared_acquire(dp_shared_t* self, int* ticket);
+
+/*! Releases a snapshot gotten by `dp_shared_acquire()`.
+ *
+ * \param self The shared context.
+ * \param ticket The ticket it was gotten with.
+ */
+void dp_shared_release(dp_shared_t* self, int ticket);
+
+/*! Adds a template to a shared context, as with
+ * [\ref dp_add_template(dp_context_t*, const stroke_t*, const char*)], by
+ * publishing a new snapshot.  Returns once the old snapshot is freed.
+ *
+ * \param self The shared context.
+ * \param strk The stroke the template is based on.
+ * \param name The name of the template.
+ */
+void dp_shared_add_template(dp_shared_t* self, const stroke_t* strk,
+                            const char* name);
+
+/*! Adds a multistroke template to a shared context, as with
+ * `dp_add_template_strokes()`, by publishing a new snapshot.
+ *
+ * \param self The shared context.
+ * \param strks The strokes of the template, in drawing order.
+ * \param num The number of strokes.
+ * \param name The name of the template.
+ */
+void dp_shared_add_template_strokes(dp_shared_t* self,
+                                    const stroke_t* const* strks, size_t num,
+                                    const char* name);
+
+/*! Removes every template of a class from a shared context, by publishing a
+ * new snapshot.  The other templates keep their order.  Their label stays
+ * interned.
+ *
+ * \param self The shared context.
+ * \param name The name of the class.
+ *
+ * \return The number of templates removed.
+ */
+size_t dp_shared_remove(dp_shared_t* self, const char* name);
+
+/*! Destroys a shared context and its current snapshot.  No snapshot may be
+ * held.
  *
- * \return The result of the recognition; may be `NULL`.
+ * \param self The shared context.
  */
-dp_result_t dp_recognize(const dp_context_t* self, stroke_t* strk);
+void dp_shared_destroy(dp_shared_t* self);
 
 /*! Destroys the $P context and frees all its memory
  *
@@ -18,6 +18,7 @@
 
 #include "test_macros.h"
 #include "arc.h"
+#include "context.h"
 
 
 
@@ -46,18 +47,21 @@ void pal_arc_populate(pal_arc_t* self, const point2d_t* p1, const point2d_t* p2,
 // ------------------------------- Up & Down -------------------------------- //
 ////////////////////////////////////////////////////////////////////////////////
 
-/* The arc context for testing. */
-static pal_arc_context_t context;
+/* The arc context for testing (part of the caller's Paleo context). */
+#define context (ctx->arc)
 
-void pal_arc_init() { bzero(&context, sizeof(pal_arc_context_t)); }
+void pal_arc_init(pal_context_t* ctx) {
+  bzero(&context, sizeof(pal_arc_context_t));
+}
 
-void pal_arc_deinit() { }
+void pal_arc_deinit(pal_context_t* ctx) { }
 
-/* Resets the global arc context.
+/* Resets the arc context.
  *
+ * \param ctx The Paleo context.
  * \param stroke The stroke to recognize, and thus to reset.
  */
-static inline void _reset(const pal_stroke_t* stroke) {
+static inline void _reset(pal_context_t* ctx, const pal_stroke_t* stroke) {
   RESET(stroke);
   //bzero(&context, sizeof(pal_arc_test_context_t));
   //context.stroke = stroke;
@@ -72,17 +76,19 @@ static inline void _reset(const pal_stroke_t* stroke) {
 
 /* Implements the actual arc test on the stroke.
  *
+ * \param ctx The Paleo context.
  * \param stroke The stroke to recognize.
  *
  * \returns The recognized result.
  */
-const pal_arc_result_t* pal_arc_test(const pal_stroke_t* stroke) {
+const pal_arc_result_t*
+pal_arc_test(pal_context_t* ctx, const pal_stroke_t* stroke) {
   CHECK_RTN_RESULT(!stroke->closed, "Stroke closed.");
   CHECK_RTN_RESULT(!stroke->overtraced, "Stroke overtraced.");
   CHECK_RTN_RESULT(stroke->dcr < PAL_THRESH_J,
       "DCR (%.2f) >= J (%.2f)", stroke->dcr, PAL_THRESH_J);
 
-  _reset(stroke);
+  _reset(ctx, stroke);
 
   // Paulson fits arcs by modeling them as parts of circles.  From the article:
   //
@@ -159,4 +165,6 @@ const pal_arc_result_t* pal_arc_test(const pal_stroke_t* stroke) {
   return &context.result;
 }
 
+#undef context
+
 /*! \} */
@@ -81,19 +81,27 @@ static inline void pal_arc_destroy(pal_arc_t* self) { free(self); }
 
 
 
-/*! Initialize the arc test. */
-void pal_arc_init();
+/*! Initialize the arc test.
+ *
+ * \param ctx The Paleo context to initialize the test in.
+ */
+void pal_arc_init(pal_context_t* ctx);
 
-/*! De-initializes the arc test by freeing its memory. */
-void pal_arc_deinit();
+/*! De-initializes the arc test by freeing its memory.
+ *
+ * \param ctx The Paleo context the test was initialized in.
+ */
+void pal_arc_deinit(pal_context_t* ctx);
 
 /*! Does the arc test on the paleo stroke.
  *
+ * \param ctx The Paleo context to test in.
  * \param stroke The stroke to test.
  *
  * \return The result of the recognition attempt.
  */
-const pal_arc_result_t* pal_arc_test(const pal_stroke_t* stroke);
+const pal_arc_result_t*
+pal_arc_test(pal_context_t* ctx, const pal_stroke_t* stroke);
 
 /*! Does a deep copy of an arc result.
  *
@@ -9,6 +9,7 @@
 #include <strings.h>
 
 #include "composite.h"
+#include "context.h"
 #include "test_macros.h"
 
 
@@ -92,24 +93,30 @@ int pal_composite_is_line(const pal_composite_t* self) {
 
 
 
-void pal_composite_init() { }
+//! The composite test context (part of the caller's Paleo context).
+#define context (ctx->composite)
 
-void pal_composite_deinit() { }
+void pal_composite_init(pal_context_t* ctx) {
+  bzero(&context, sizeof(pal_composite_context_t));
+}
 
+void pal_composite_deinit(pal_context_t* ctx) { }
 
 
-pal_composite_result_t* pal_composite_test(const pal_stroke_t* stroke) {
-  pal_composite_context_t context;
+
+pal_composite_result_t*
+pal_composite_test(pal_context_t* ctx, const pal_stroke_t* stroke) {
   bzero(&context, sizeof(pal_composite_context_t));
   RESET(stroke);
 
   // Find highest curvature.
-  pal_point_t* max = &stroke->pts[0];
+  int max_i = 0;
   for (int i = 1; i < stroke->num_pts; i++) {
-    if (stroke->pts[i].curv > max->curv) {
-      max = &stroke->pts[i];
+    if (stroke->curv[i] > stroke->curv[max_i]) {
+      max_i = i;
     }
   }
+  pal_point_t* max = &stroke->pts[max_i];
 
   // Break into 2 substrokes.
   stroke_t subs[2];
@@ -127,8 +134,8 @@ pal_composite_result_t* pal_composite_test(const pal_stroke_t* stroke) {
 
 // FIXME Not sure what this was doing here ...
 //  // Test each individually.
-//  &context, pal_recognize(&subs[0]);
-//  &context, pal_recognize(&subs[1]);
+//  &context, pal_recognize(ctx, &subs[0]);
+//  &context, pal_recognize(ctx, &subs[1]);
 
   assert(0);  // still have to figure out how to implement this ...
 
@@ -154,5 +161,7 @@ pal_composite_result_t* pal_composite_test(const pal_stroke_t* stroke) {
 //  assert(0);  // not impl
 //}
 
+#undef context
+
 
 /*! \} */
@@ -87,20 +87,28 @@ int pal_composite_rank(const pal_composite_t* self);
 int pal_composite_is_line(const pal_composite_t* self);
 
 
-/*! Initialize the curve test. */
-void pal_composite_init();
+/*! Initialize the composite test.
+ *
+ * \param ctx The Paleo context to initialize the test in.
+ */
+void pal_composite_init(pal_context_t* ctx);
 
-/*! De-initializes the curve test. */
-void pal_composite_deinit();
+/*! De-initializes the composite test.
+ *
+ * \param ctx The Paleo context the test was initialized in.
+ */
+void pal_composite_deinit(pal_context_t* ctx);
 
 /*!
  * Performs the composite shape test.
  *
+ * \param ctx The Paleo context to test in.
  * \param stroke The stroke to recognize.
  *
  * \return The test result.
  */
-pal_composite_result_t* pal_composite_test(const pal_stroke_t* stroke);
+pal_composite_result_t*
+pal_composite_test(pal_context_t* ctx, const pal_stroke_t* stroke);
 
 /*!
  * Does a deep copy of the composite result.
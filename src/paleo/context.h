@@ -0,0 +1,41 @@
+/*!
+ * \addtogroup pal
+ * \{
+ *
+ * \file context.h
+ * Defines the full Paleo context declared (opaquely) in paleo.h.  It bundles
+ * the state of every shape test so that nothing in Paleo is kept in
+ * file-static variables.  Only the shape tests and paleo.c need this file.
+ */
+
+#ifndef __pal_context_h__
+#define __pal_context_h__
+
+#include "paleo.h"
+
+#include "line.h"     // Also poly-line.
+#include "ellipse.h"  // Also circle.
+#include "arc.h"
+#include "curve.h"
+#include "spiral.h"
+#include "helix.h"
+#include "composite.h"
+
+//! The main Paleo object.  See `pal_context_t`.
+struct pal_context {
+  pal_stroke_t stroke;              //!< The Paleo stroke we're recognizing.
+  pal_hier_t h;                     //!< The hierarchy we're building.
+
+  pal_line_context_t line;          //!< Line & polyline test context.
+  pal_ellipse_context_t ellipse;    //!< Ellipse test context.
+  pal_circle_context_t circle;      //!< Circle test context.
+  pal_arc_context_t arc;            //!< Arc test context.
+  pal_curve_context_t curve;        //!< Curve test context.
+  pal_spiral_context_t spiral;      //!< Spiral test context.
+  pal_helix_context_t helix;        //!< Helix test context.
+  pal_composite_context_t composite;  //!< Composite test context.
+};
+
+#endif  // __pal_context_h__
+
+/*! \} */
@@ -26,6 +26,7 @@
 #include "common/point.h"
 #include "test_macros.h"
 #include "curve.h"
+#include "context.h"
 
 
 
@@ -118,14 +119,16 @@ void pal_curve_util_compute_point(point2d_t *p,
 // ----------------------------- Test Functions ----------------------------- //
 ////////////////////////////////////////////////////////////////////////////////
 
-//! The curve test context.
-static pal_curve_context_t context;
+//! The curve test context (part of the caller's Paleo context).
+#define context (ctx->curve)
 
-void pal_curve_init() { bzero(&context, sizeof(pal_curve_context_t)); }
+void pal_curve_init(pal_context_t* ctx) {
+  bzero(&context, sizeof(pal_curve_context_t));
+}
 
-void pal_curve_deinit() { }
+void pal_curve_deinit(pal_context_t* ctx) { }
 
-static void _reset(const pal_stroke_t* stroke) {
+static void _reset(pal_context_t* ctx, const pal_stroke_t* stroke) {
   bzero(&context, sizeof(pal_curve_result_t));
   context.stroke = stroke;
   context.result.possible = 1;
@@ -176,13 +179,14 @@ static const double M5_INV[] = {
 
 /*! Attempt to fit the stroke to a Bezier curve of degree \c d.
  *
+ * \param ctx The Paleo context.
  * \param m_inv inverse of M matrix.
  * \param d Degree of the Bézier curve.
  *
  * \note
  * The degree of the curve cannot be anything but 4 or 5.
  */
-static void _fit(const double* m_inv, const int d);
+static void _fit(pal_context_t* ctx, const double* m_inv, const int d);
 
 /*! Compute the squared distance between two points (for square error
  * calculation).
@@ -198,11 +202,12 @@ static inline double _sq_err(const point2d_t a, const point2d_t b) {
   return dx*dx+dy*dy;
 }
 
-const pal_curve_result_t* pal_curve_test(const pal_stroke_t* stroke) {
+const pal_curve_result_t*
+pal_curve_test(pal_context_t* ctx, const pal_stroke_t* stroke) {
   CHECK_RTN_RESULT(stroke->dcr < PAL_THRESH_J,
       "DCR too high: %.2f >= %.2f", stroke->dcr, PAL_THRESH_J);
 
-  _reset(stroke);
+  _reset(ctx, stroke);
 
   // Pre-compute matrices common to any degree curve:
   context.Xs = calloc(stroke->num_pts, sizeof(double));
@@ -216,8 +221,8 @@ const pal_curve_result_t* pal_curve_test(const pal_stroke_t* stroke) {
   // Find 2 different solutions (one for 4 control points and one for 5) by
   // using the LSE method described here:
   //    http://jimherold.com/2012/04/20/least-squares-bezier-fit/
-  _fit(M4_INV, 4);
-  _fit(M5_INV, 5);
+  _fit(ctx, M4_INV, 4);
+  _fit(ctx, M5_INV, 5);
 
   free(context.Xs);
   free(context.Ys);
@@ -225,10 +230,8 @@ const pal_curve_result_t* pal_curve_test(const pal_stroke_t* stroke) {
   // Compute the LSE for each type of curve.
   context.ideal_4.lse = _sq_err(context.ideal_4.Cs[0], stroke->pts[0].p2d);
   context.ideal_5.lse = _sq_err(context.ideal_5.Cs[0], stroke->pts[0].p2d);
-  double px_len = 0;
   for (int i = 1; i < stroke->num_pts; i++) {
-    px_len += point2d_distance(&stroke->pts[i-1].p2d, &stroke->pts[i].p2d);
-    double t = px_len / stroke->px_length;
+    double t = pal_stroke_param(stroke, i);
 
     // Compute the B_4, then the B_5 point.
     point2d_t a;
@@ -280,22 +283,16 @@ static inline int _inv(double* m_inv, const double* m, int n);
  */
 static inline void _mul(double* c, const double* a, const double* b, int m, int k, int n);
 
-void _fit(const double* m_inv, const int d) {
+void _fit(pal_context_t* ctx, const double* m_inv, const int d) {
   assert(d == 4 || d == 5);   // XXX Current assumption.
 
   const int NP = context.stroke->num_pts;
 
   // Compute T & T^T.
-  double px_len = 0;
   double* T = calloc(NP * d, sizeof(double));
   double* T_T = calloc(NP * d, sizeof(double));   // T^T
   for (int i = 0; i < NP; i++) {
-    if (i != 0) {
-      px_len += point2d_distance(
-          &context.stroke->pts[i-1].p2d, &context.stroke->pts[i].p2d);
-    }
-
-    double t = px_len / context.stroke->px_length;
+    double t = pal_stroke_param(context.stroke, i);
     T[i+(d-1)*NP] = T_T[(d-1)+i*NP] = 1;
     for (int j = d-2; j >= 0; j--) {
       T[i+j*NP] = T_T[j+i*NP] = T[i+(j+1)*NP] * t;
@@ -389,4 +386,6 @@ static inline void _mul(double* c, const double* a, const double* b, int m, int
       m, n, k, 1, a, m, b, k, 0, c, m);
 }
 
+#undef context
+
 /*! \} */
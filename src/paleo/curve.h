@@ -123,20 +123,28 @@ void pal_curve_util_compute_point(point2d_t *p,
 
 
 
-/*! Initialize the curve test. */
-void pal_curve_init();
+/*! Initialize the curve test.
+ *
+ * \param ctx The Paleo context to initialize the test in.
+ */
+void pal_curve_init(pal_context_t* ctx);
 
-/*! De-initializes the curve test by freeing its memory. */
-void pal_curve_deinit();
+/*! De-initializes the curve test by freeing its memory.
+ *
+ * \param ctx The Paleo context the test was initialized in.
+ */
+void pal_curve_deinit(pal_context_t* ctx);
 
 /*!
  * Does the curve test on the Paleo stroke.
  *
+ * \param ctx The Paleo context to test in.
  * \param stroke The stroke to test.
  *
  * \return The result.
  */
-const pal_curve_result_t* pal_curve_test(const pal_stroke_t* stroke);
+const pal_curve_result_t*
+pal_curve_test(pal_context_t* ctx, const pal_stroke_t* stroke);
 
 /*!
  * Does a deep copy of a curve.
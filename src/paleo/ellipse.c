@@ -16,6 +16,7 @@
 #include "common/geom.h"
 #include "test_macros.h"
 #include "ellipse.h"
+#include "context.h"
 
 
 
@@ -64,18 +65,21 @@ pal_circle_t* pal_circle_create_with_point(long r, const point2d_t* c) {
 // ------------------------------- Up & Down -------------------------------- //
 ////////////////////////////////////////////////////////////////////////////////
 
-//! The ellipse context for testing.
-static pal_ellipse_context_t e_context;
+//! The ellipse context for testing (part of the caller's Paleo context).
+#define e_context (ctx->ellipse)
 
-void pal_ellipse_init() { bzero(&e_context, sizeof(pal_ellipse_context_t)); }
+void pal_ellipse_init(pal_context_t* ctx) {
+  bzero(&e_context, sizeof(pal_ellipse_context_t));
+}
 
-void pal_ellipse_deinit() { }
+void pal_ellipse_deinit(pal_context_t* ctx) { }
 
 /*! Resets the context in prep for the next ellipse text.
  *
+ * \param ctx The Paleo context.
  * \param stroke The stroke to test.
  */
-static inline void _reset_el(const pal_stroke_t* stroke) {
+static inline void _reset_el(pal_context_t* ctx, const pal_stroke_t* stroke) {
   // 0-out e_context.
   bzero(&e_context, sizeof(pal_ellipse_result_t));
 
@@ -85,18 +89,22 @@ static inline void _reset_el(const pal_stroke_t* stroke) {
 }
 
 
-//! The circle context for testing.
-static pal_circle_context_t c_context;
+//! The circle context for testing (part of the caller's Paleo context).
+#define c_context (ctx->circle)
 
-void pal_circle_init() { bzero(&c_context, sizeof(pal_circle_context_t)); }
+void pal_circle_init(pal_context_t* ctx) {
+  bzero(&c_context, sizeof(pal_circle_context_t));
+}
 
-void pal_circle_deinit() { }
+void pal_circle_deinit(pal_context_t* ctx) { }
 
 /*! Resets the context for a circle test.
  *
+ * \param ctx The Paleo context.
  * \param stroke The stroke to test.
  */
-static inline void _reset_cir(const pal_stroke_t* stroke) {
+static inline void
+_reset_cir(pal_context_t* ctx, const pal_stroke_t* stroke) {
   // 0-out e_context.
   bzero(&c_context, sizeof(pal_ellipse_result_t));
 
@@ -114,10 +122,11 @@ static inline void _reset_cir(const pal_stroke_t* stroke) {
 // Makes macros work for e_context.
 #define context e_context
 
-const pal_ellipse_result_t* pal_ellipse_test(const pal_stroke_t* stroke) {
+const pal_ellipse_result_t*
+pal_ellipse_test(pal_context_t* ctx, const pal_stroke_t* stroke) {
   CHECK_RTN_RESULT(stroke->closed, "Stroke not closed.");
 
-  _reset_el(stroke);
+  _reset_el(ctx, stroke);
 
   // Init the ideal ellipse.
   bzero(&e_context.ideal.center, sizeof(point2d_t));
@@ -253,7 +262,8 @@ const pal_ellipse_result_t* pal_ellipse_test(const pal_stroke_t* stroke) {
 // Makes macros work for c_context.
 #define context c_context
 
-const pal_circle_result_t* pal_circle_test(const pal_stroke_t* stroke) {
+const pal_circle_result_t*
+pal_circle_test(pal_context_t* ctx, const pal_stroke_t* stroke) {
   CHECK_RTN_RESULT(e_context.stroke == stroke,
       "Ellipse not run!  Not running circle test.");
   CHECK_RTN_RESULT(stroke->closed, "Stroke not closed.");
@@ -296,5 +306,7 @@ const pal_circle_result_t* pal_circle_test(const pal_stroke_t* stroke) {
 
 // And finito!
 #undef context
+#undef c_context
+#undef e_context
 
 /*! \} */
@@ -176,24 +176,38 @@ static inline void pal_circle_destroy(pal_circle_t* self) { free(self); }
 
 
 
-/*! Initialize the ellipse test. */
-void pal_ellipse_init();
+/*! Initialize the ellipse test.
+ *
+ * \param ctx The Paleo context to initialize the test in.
+ */
+void pal_ellipse_init(pal_context_t* ctx);
 
-/*! De-initializes the ellipse test by freeing its memory. */
-void pal_ellipse_deinit();
+/*! De-initializes the ellipse test by freeing its memory.
+ *
+ * \param ctx The Paleo context the test was initialized in.
+ */
+void pal_ellipse_deinit(pal_context_t* ctx);
 
-/*! Initialize the ellipse test. */
-void pal_circle_init();
+/*! Initialize the ellipse test.
+ *
+ * \param ctx The Paleo context to initialize the test in.
+ */
+void pal_circle_init(pal_context_t* ctx);
 
-/*! De-initializes the ellipse test by freeing its memory. */
-void pal_circle_deinit();
+/*! De-initializes the ellipse test by freeing its memory.
+ *
+ * \param ctx The Paleo context the test was initialized in.
+ */
+void pal_circle_deinit(pal_context_t* ctx);
 
 /*!
  * Does the ellipse test on the paleo stroke.
  *
+ * \param ctx The Paleo context to test in.
  * \param stroke The stroke to test.
  */
-const pal_ellipse_result_t* pal_ellipse_test(const pal_stroke_t* stroke);
+const pal_ellipse_result_t*
+pal_ellipse_test(pal_context_t* ctx, const pal_stroke_t* stroke);
 
 /*!
  * Does a deep copy of an ellipse.
@@ -231,13 +245,16 @@ static inline void pal_ellipse_result_destroy(pal_ellipse_result_t* self) {
 }
 
 /*!
- * Does the circle test on the paleo stroke.
+ * Does the circle test on the paleo stroke.  The ellipse test must already
+ * have been run on the same stroke in the same context.
  *
+ * \param ctx The Paleo context to test in.
  * \param stroke The stroke to test.
  *
  * \return The result of the test.
  */
-const pal_circle_result_t* pal_circle_test(const pal_stroke_t* stroke);
+const pal_circle_result_t*
+pal_circle_test(pal_context_t* ctx, const pal_stroke_t* stroke);
 
 /*!
  * Does a deep copy of a circle.
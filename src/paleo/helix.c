@@ -14,6 +14,7 @@
 #include "thresh.h"
 #include "test_macros.h"
 #include "helix.h"
+#include "context.h"
 
 
 pal_helix_t* pal_helix_create() { return calloc(1, sizeof(pal_helix_t)); }
@@ -38,26 +39,29 @@ void pal_helix_compute_point(const pal_helix_t* self, point2d_t* p, double t) {
 // ------------------------------ Helix Shape ------------------------------- //
 ////////////////////////////////////////////////////////////////////////////////
 
-//! The context used for shape recognition.
-static pal_helix_context_t context;
+//! The context used for shape recognition (part of the caller's Paleo
+//! context).
+#define context (ctx->helix)
 
-void pal_helix_init() {
+void pal_helix_init(pal_context_t* ctx) {
   bzero(&context, sizeof(pal_helix_context_t));
 }
 
-void pal_helix_deinit() { }
+void pal_helix_deinit(pal_context_t* ctx) { }
 
-/*! Resets the internal helix context in prep for a new test.
+/*! Resets the helix context in prep for a new test.
  *
+ * \param ctx The Paleo context.
  * \param stroke The stroke to test.
  */
-static inline void _reset(const pal_stroke_t* stroke) {
+static inline void _reset(pal_context_t* ctx, const pal_stroke_t* stroke) {
   bzero(&context, sizeof(pal_helix_context_t));
   RESET(stroke);
 }
 
-const pal_helix_result_t* pal_helix_test(const pal_stroke_t* stroke) {
-  _reset(stroke);
+const pal_helix_result_t*
+pal_helix_test(pal_context_t* ctx, const pal_stroke_t* stroke) {
+  _reset(ctx, stroke);
 
   CHECK_RTN_RESULT(stroke->overtraced, "Stroke not overtraced.");
   CHECK_RTN_RESULT(stroke->ndde > PAL_THRESH_K,
@@ -115,11 +119,13 @@ const pal_helix_result_t* pal_helix_test(const pal_stroke_t* stroke) {
   context.result.helix.theta_i = point2d_angle_to(
       &context.result.helix.c[0], &stroke->pts[0].p2d);
   context.result.helix.theta_t =
-    stroke->pts[stroke->num_pts-1].dir - stroke->pts[0].dir;
+    stroke->dir[stroke->num_pts-1] - stroke->dir[0];
   context.result.helix.cw = SGN(context.result.helix.theta_t);
   context.result.helix.theta_t = abs(context.result.helix.theta_t);
 
   return &context.result;
 }
 
+#undef context
+
 /*! \} */
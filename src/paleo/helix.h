@@ -73,20 +73,28 @@ void pal_helix_compute_point(const pal_helix_t* self, point2d_t* p, double t);
 
 
 
-/*! Initialize the curve test. */
-void pal_helix_init();
+/*! Initialize the helix test.
+ *
+ * \param ctx The Paleo context to initialize the test in.
+ */
+void pal_helix_init(pal_context_t* ctx);
 
-/*! De-initializes the curve test. */
-void pal_helix_deinit();
+/*! De-initializes the helix test.
+ *
+ * \param ctx The Paleo context the test was initialized in.
+ */
+void pal_helix_deinit(pal_context_t* ctx);
 
 /*!
  * Test whether this is a helix.
  *
+ * \param ctx The Paleo context to test in.
  * \param stroke The stroke to test.
  *
  * \return The result of the test.
  */
-const pal_helix_result_t* pal_helix_test(const pal_stroke_t* stroke);
+const pal_helix_result_t*
+pal_helix_test(pal_context_t* ctx, const pal_stroke_t* stroke);
 
 /*!
  * Does a deep copy of a helix result.
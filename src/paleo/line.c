@@ -15,6 +15,8 @@
 
 #include "common/geom.h"
 
+#include "context.h"  // Before the macros below rename "result".
+
 #define result res.res[0]   // Alter test macros to work with unique struct.
 #include "test_macros.h"
 
@@ -67,12 +69,15 @@ pal_line_t* pal_line_create_points_with_longs(
 // ----------------------------- Test Functions ----------------------------- //
 ////////////////////////////////////////////////////////////////////////////////
 
-//! The line test's context (used by most functions here).
-static pal_line_context_t context;
+//! The line test's context (used by most functions here).  Every function
+//! that uses it takes the Paleo context as `ctx`.
+#define context (ctx->line)
 
-void pal_line_init() { bzero(&context, sizeof(pal_line_context_t)); }
+void pal_line_init(pal_context_t* ctx) {
+  bzero(&context, sizeof(pal_line_context_t));
+}
 
-void pal_line_deinit() {
+void pal_line_deinit(pal_context_t* ctx) {
   for (int i = 0; i < context.res.num; i++) {
     free(context.res.res[i].line.pts);
   }
@@ -82,12 +87,14 @@ void pal_line_deinit() {
 /*!
  * Resets the line context.
  *
+ * \param ctx The Paleo context.
  * \param stroke The stroke to recognize.
  * \param num The number of joints in the line.
  */
-static inline void _reset(const pal_stroke_t* stroke, int num) {
-  pal_line_deinit();    // Free memory.
-  pal_line_init();      // Reset object.
+static inline void
+_reset(pal_context_t* ctx, const pal_stroke_t* stroke, int num) {
+  pal_line_deinit(ctx);   // Free memory.
+  pal_line_init(ctx);     // Reset object.
 
   context.stroke = stroke;
   context.res.num = num;
@@ -102,32 +109,35 @@ static inline void _reset(const pal_stroke_t* stroke, int num) {
 /*!
  * Does the line segment test on the ranges provided.
  *
+ * \param ctx The Paleo context.
  * \param first_i Index (incl.) of the first point to use.
  * \param last_i Index (excl.) of the last point to use.
  */
-static inline void _line_test(int first_i, int last_i);
+static inline void _line_test(pal_context_t* ctx, int first_i, int last_i);
 
-const pal_line_result_t* pal_line_test(const pal_stroke_t* stroke) {
-  _reset(stroke, 1);
+const pal_line_result_t*
+pal_line_test(pal_context_t* ctx, const pal_stroke_t* stroke) {
+  _reset(ctx, stroke, 1);
 
   if (stroke->num_crnrs == 2 || stroke->num_crnrs == 3) {
-    _line_test(0, stroke->num_pts);
+    _line_test(ctx, 0, stroke->num_pts);
   }
   return &context.res;
 }
 
-const pal_line_result_t* pal_pline_test(const pal_stroke_t* stroke) {
+const pal_line_result_t*
+pal_pline_test(pal_context_t* ctx, const pal_stroke_t* stroke) {
   // Check DCR value.
   CHECK_RTN_RESULT(stroke->dcr >= PAL_THRESH_J,
       "Stroke DCR val too low: %.2f < %.2f", stroke->dcr, PAL_THRESH_J);
 
   // Init/reset the context.
-  _reset(stroke, stroke->num_crnrs);
+  _reset(ctx, stroke, stroke->num_crnrs);
 
   // Do the line test for each sub-line.
   double avg_lse = 0;   // also compute average LSE
   for (int i = 1; i < stroke->num_crnrs; i++) {
-    _line_test(stroke->crnrs[i-1]->i, stroke->crnrs[i]->i);
+    _line_test(ctx, stroke->crnrs[i-1]->i, stroke->crnrs[i]->i);
 
     CHECK_RTN_RESULT(context.res.res[0].possible,
         "Does not pass line test in sub-seg %d", i);
@@ -159,43 +169,47 @@ const pal_line_result_t* pal_pline_test(const pal_stroke_t* stroke) {
  * Creates the best fit line segment between the two point indexes and stores it
  * in the context.
  *
+ * \param ctx The Paleo context.
  * \param first_i The first 
  */
-static inline void _best_fit_line_seg(int first_i, int last_i);
+static inline void
+_best_fit_line_seg(pal_context_t* ctx, int first_i, int last_i);
 
 /*!
  * Computes the projection of p to the ideal line.
  *
+ * \param ctx The Paleo context.
  * \param proj Return value (projection)
  * \param p The point to project.
  */
-static inline void _projection_to_ideal(point2d_t* proj, const point2d_t* p);
+static inline void _projection_to_ideal(const pal_context_t* ctx,
+    point2d_t* proj, const point2d_t* p);
 
 /*!
  * Computes the orthogonal distance from the point to the ideal line.
  *
+ * \param ctx The Paleo context.
  * \param p The point.
  *
  * \return The distance from \c p to the ideal line in px.
  */
-static inline double _distance_to_ideal(const point2d_t* p);
+static inline double
+_distance_to_ideal(const pal_context_t* ctx, const point2d_t* p);
 
-static inline void  _line_test(int first_i, int last_i) {
+static inline void _line_test(pal_context_t* ctx, int first_i, int last_i) {
   // Reset 0th 
   bzero(&context.res.res[0], sizeof(pal_line_sub_result_t));
   context.res.res[0].possible = 1;
 
-  _best_fit_line_seg(first_i, last_i);
+  _best_fit_line_seg(ctx, first_i, last_i);
 
-  double px_len = 0;  // Length of this sub-stroke.
+  // Length of this sub-stroke.
+  const double px_len =
+    pal_stroke_length(context.stroke, first_i, MAX(first_i, last_i - 1));
   double od2 = 0;     // Orthogonal distance squared.
   for (int i = first_i; i < last_i; i++) {
-    double d = _distance_to_ideal(&context.stroke->pts[i].p2d);
+    double d = _distance_to_ideal(ctx, &context.stroke->pts[i].p2d);
     od2 += d * d;
-    if (i > first_i) {
-      px_len += point2d_distance(
-          &context.stroke->pts[i-1].p2d, &context.stroke->pts[i].p2d);
-    }
   }
   context.res.res[0].lse = od2 / px_len;
   if (context.res.res[0].lse >= PAL_THRESH_G) {
@@ -207,8 +221,8 @@ static inline void  _line_test(int first_i, int last_i) {
   for (int i = first_i + 1; i < last_i; i++) {
     // Compute the projections to the line.
     point2d_t proj_a, proj_b;
-    _projection_to_ideal(&proj_a, &context.stroke->pts[i-1].p2d);
-    _projection_to_ideal(&proj_b, &context.stroke->pts[i].p2d);
+    _projection_to_ideal(ctx, &proj_a, &context.stroke->pts[i-1].p2d);
+    _projection_to_ideal(ctx, &proj_b, &context.stroke->pts[i].p2d);
 
     // Add quad area to feature area (order is important!).
     context.res.res[0].fa += geom_quad_area(&proj_b, &proj_a,
@@ -230,7 +244,8 @@ static inline void  _line_test(int first_i, int last_i) {
       &context.stroke->pts[last_i-1], sizeof(point2d_t));
 }
 
-static inline void _best_fit_line_seg(int first_i, int last_i) {
+static inline void
+_best_fit_line_seg(pal_context_t* ctx, int first_i, int last_i) {
   assert(0 <= first_i);
   assert(first_i < last_i);
   assert(last_i <= context.stroke->num_pts);
@@ -275,13 +290,15 @@ static inline void _best_fit_line_seg(int first_i, int last_i) {
     context.stroke->pts[last_i].x - context.stroke->pts[first_i].x);
 }
 
-static inline double _distance_to_ideal(const point2d_t* p) {
+static inline double
+_distance_to_ideal(const pal_context_t* ctx, const point2d_t* p) {
   point2d_t proj;   // projection return value.
-  _projection_to_ideal(&proj, p);
+  _projection_to_ideal(ctx, &proj, p);
   return point2d_distance(&proj, p);
 }
 
-static inline void _projection_to_ideal(point2d_t* proj, const point2d_t* p) {
+static inline void _projection_to_ideal(const pal_context_t* ctx,
+    point2d_t* proj, const point2d_t* p) {
   assert(context.ideal.slope != 0 || context.ideal.y_int != 0);
 
   // Avoid div-by-0.
@@ -307,4 +324,6 @@ static inline void _projection_to_ideal(point2d_t* proj, const point2d_t* p) {
   }
 }
 
+#undef context
+
 /*! \} */
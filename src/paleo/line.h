@@ -126,11 +126,17 @@ static inline void pal_line_destroy(pal_line_t* self) {
 
 
 
-/*! Initialize the line test. */
-void pal_line_init();
+/*! Initialize the line test.
+ *
+ * \param ctx The Paleo context to initialize the test in.
+ */
+void pal_line_init(pal_context_t* ctx);
 
-/*! De-initializes the line test by freeing its memory. */
-void pal_line_deinit();
+/*! De-initializes the line test by freeing its memory.
+ *
+ * \param ctx The Paleo context the test was initialized in.
+ */
+void pal_line_deinit(pal_context_t* ctx);
 
 /*!
  * Does a shallow copy of a line result.  Assumes the source and destination
@@ -177,20 +183,24 @@ static inline void pal_line_result_destroy(pal_line_result_t* self) {
 /*!
  * Does the line test on the paleo stroke.
  *
+ * \param ctx The Paleo context to test in.
  * \param stroke The stroke to test.
  *
  * \return The result of the test.
  */
-const pal_line_result_t* pal_line_test(const pal_stroke_t* stroke);
+const pal_line_result_t*
+pal_line_test(pal_context_t* ctx, const pal_stroke_t* stroke);
 
 /*!
  * Does the poly line test on the paleo stroke.
  *
+ * \param ctx The Paleo context to test in.
  * \param stroke The stroke to test.
  *
  * \return The result of the test.
  */
-const pal_line_result_t* pal_pline_test(const pal_stroke_t* stroke);
+const pal_line_result_t*
+pal_pline_test(pal_context_t* ctx, const pal_stroke_t* stroke);
 
 
 #endif // __pal_line_h__
@@ -28,18 +28,21 @@
 #include "spiral.h"
 #include "helix.h"
 #include "composite.h"
+#include "context.h"
 
 
 
-/*! Finds the type that Paleo thinks the stroke is. */
-#define TYPE() (paleo.h.elems[0].type)
+/*! Finds the type that Paleo thinks the stroke is.  These hierarchy macros
+ * assume a \c pal_context_t* named \c self is in scope.
+ */
+#define TYPE() (self->h.elems[0].type)
 
 /*!
  * Determines whether the type `TYPE` has been added
  *
  * \param TYPE The type to check for.
  */
-#define TYPE_ADDED(TYPE) (paleo.h.mask & PAL_MASK(TYPE))
+#define TYPE_ADDED(TYPE) (self->h.mask & PAL_MASK(TYPE))
 
 // Several convenience result-cloning macros; used by `ADD_H_AT`.
 #define _cr_LINE pal_line_result_cln
@@ -61,10 +64,10 @@
  * \param RES A pointer to the result.
  */
 #define ADD_H_AT(I, TYPE, RES) do {                       \
-  paleo.h.elems[I].type = PAL_TYPE(TYPE);                 \
-  paleo.h.elems[I].res = (pal_result_t*)_cr_##TYPE(RES);  \
-  paleo.h.mask &= PAL_MASK(TYPE);                         \
-  paleo.h.num++;                                          \
+  self->h.elems[I].type = PAL_TYPE(TYPE);                 \
+  self->h.elems[I].res = (pal_result_t*)_cr_##TYPE(RES);  \
+  self->h.mask &= PAL_MASK(TYPE);                         \
+  self->h.num++;                                          \
 } while (0)
 
 /*!
@@ -76,7 +79,7 @@
  */
 #define PUSH_H(TYPE, RES) do {                         \
   if (!TYPE_ADDED(TYPE)) {                             \
-    memmove(&paleo.h.elems[1], &paleo.h.elems[0],      \
+    memmove(&self->h.elems[1], &self->h.elems[0],      \
         (PAL_TYPE_NUM - 1) * sizeof(pal_hier_elem_t)); \
     ADD_H_AT(0, TYPE, RES);                            \
   }                                                    \
@@ -91,7 +94,7 @@
  */
 #define ENQ_H(TYPE, RES) do {         \
   if (!TYPE_ADDED(TYPE)) {            \
-    ADD_H_AT(paleo.h.num, TYPE, RES); \
+    ADD_H_AT(self->h.num, TYPE, RES); \
   }                                   \
 } while(0)
 
@@ -100,9 +103,6 @@
 // ---------------------------- Paleo Up/Down ----------------------------- //
 //////////////////////////////////////////////////////////////////////////////
 
-/*! The paleo context. */
-static pal_context_t paleo;
-
 /*!
  * Resets the Paleo hierarchy.
  *
@@ -153,36 +153,52 @@ static void _hier_reset(pal_hier_t* h) {
 
   bzero(h, sizeof(pal_hier_t));
   for (int i = 0; i < PAL_TYPE_NUM; i++) {
-    paleo.h.elems[i].type = PAL_TYPE_UNRUN;
+    h->elems[i].type = PAL_TYPE_UNRUN;
   }
 }
 
-void pal_init() {
-  bzero(&paleo, sizeof(pal_context_t));
-  paleo.h.elems[0].type = PAL_TYPE_UNRUN;
-
-  pal_line_init();
-  pal_ellipse_init();
-  pal_circle_init();
-  pal_arc_init();
-  pal_curve_init();
-  pal_spiral_init();
-  pal_helix_init();
-  pal_composite_init();
+/*!
+ * Frees the Paleo stroke from the last recognition (if any) so that the
+ * context can be reused.
+ *
+ * \param ps The Paleo stroke to reset.
+ */
+static void _stroke_reset(pal_stroke_t* ps) {
+  free(ps->pts);
+  free(ps->mem);
+  free(ps->crnrs);
+  bzero(ps, sizeof(pal_stroke_t));
 }
 
-void pal_deinit() {
-  pal_line_deinit();
-  pal_ellipse_deinit();
-  pal_circle_deinit();
-  pal_arc_deinit();
-  pal_curve_deinit();
-  pal_spiral_deinit();
-  pal_helix_deinit();
-  pal_composite_deinit();
-
-  free(paleo.stroke.pts);
-  free(paleo.stroke.crnrs);
+pal_context_t* pal_create() {
+  pal_context_t* self = calloc(1, sizeof(pal_context_t));
+  self->h.elems[0].type = PAL_TYPE_UNRUN;
+
+  pal_line_init(self);
+  pal_ellipse_init(self);
+  pal_circle_init(self);
+  pal_arc_init(self);
+  pal_curve_init(self);
+  pal_spiral_init(self);
+  pal_helix_init(self);
+  pal_composite_init(self);
+
+  return self;
+}
+
+void pal_destroy(pal_context_t* self) {
+  pal_line_deinit(self);
+  pal_ellipse_deinit(self);
+  pal_circle_deinit(self);
+  pal_arc_deinit(self);
+  pal_curve_deinit(self);
+  pal_spiral_deinit(self);
+  pal_helix_deinit(self);
+  pal_composite_deinit(self);
+
+  _hier_reset(&self->h);
+  _stroke_reset(&self->stroke);
+  free(self);
 }
 
 
@@ -195,14 +211,16 @@ void pal_deinit() {
 /*!
  * Computes speed in px/s between the two timed points.
  *
+ * \param dist The distance between the points.
  * \param a A point.
  * \param b Another point.
  *
  * \return The speed between the two points in pixels per second.
  */
-static inline double _speed(const point2dt_t* a, const point2dt_t* b) {
+static inline double _speed(double dist, const point2dt_t* a,
+                            const point2dt_t* b) {
   // Should not have a div/0 error because we made sure times didn't match.
-  return point2d_distance((point2d_t*)a, (point2d_t*)b) / abs(b->t - a->t);
+  return dist / abs(b->t - a->t);
 }
 
 /*!
@@ -228,17 +246,33 @@ static inline double _yu_direction(const point2d_t* a, const point2d_t* b);
  *
  * \note A note on implementation.
  * This finds the curvature given a section of a stroke defined by the window
- * size parameter `k` (see the paper for a full definition).  This function
- * assumes that there are \f$2k+1\f$ points in `sub_strk`.  If this assumption
- * is not met, this will cause memory corruption and/or a segfault.  I.e.,
- * behavior is not defined.
+ * size parameter `k` (see the paper for a full definition).  The window spans
+ * the \f$2k+1\f$ segments that follow the point it starts at, cut short where
+ * the stroke ends.
  *
  * \param k Window size.
- * \param sub_strk Pointer to the point at the center of the window.
+ * \param ddir The (normalized) change in direction over each segment from the
+ *   window's start on.
+ * \param lens The length of each segment from the window's start on.
+ * \param num The number of points from the window's start to the end of the
+ *   stroke.
  *
  * \return The curvature.
  */
-static inline double _yu_curvature(int k, const pal_point_t* sub_strk);
+static inline double _yu_curvature(int k, const double* restrict ddir,
+                                   const double* restrict lens, int num);
+
+/*!
+ * Finds the change in direction over each segment of a stroke, unnormalized.
+ * The sweep goes over whole blocks of `STROKE_SOA_PAD` elements, so that it is
+ * vectorized.
+ *
+ * \param dir The direction column; `size + 1` elements must be readable.
+ * \param ddir Gets the changes.
+ * \param size The column size; a multiple of `STROKE_SOA_PAD`.
+ */
+static inline void _dir_changes(const double* restrict dir,
+                                double* restrict ddir, long size);
 
 /*!
  * Determines the simple \f$\frac{dy}{dx}\f$ for `b` given a was the last
@@ -256,52 +290,99 @@ static inline double _dy_dx_direction(const point2d_t* a, const point2d_t* b);
  *
  * Finds corners in the paleo stroke by iteratively merging close corners and
  * finding the most curved region to reassign the corner to.
+ *
+ * \param self The Paleo context.
  */
-static inline void _paulson_corners();
+static inline void _paulson_corners(pal_context_t* self);
 
 #define K 3  //!< The default K used to compute stroke point window.
 
-/*! Computes DCR of `paleo.stroke`. */
-static inline void _compute_dcr();
-
 /*!
  * Breaks the stroke's tails off.
  *
+ * \param self The Paleo context.
  * \param first_i The index of the first point (incl.).
  * \param last_i The index of the last point (incl.).
  */
-static inline void _break_stroke(int first_i, int last_i);
+static inline void _break_stroke(pal_context_t* self, int first_i, int last_i);
+
+//! The number of feature columns in a Paleo stroke.
+#define _PAL_FEATURES 5
+
+/*!
+ * Allocates the (zeroed) feature columns of a Paleo stroke, followed by
+ * `scratch` more columns of the same size, in one block.
+ *
+ * \param ps The Paleo stroke; its columns must not be allocated.
+ * \param num The number of points to make room for.
+ * \param scratch The number of scratch columns.
+ *
+ * \return The size of each column, or 0 if they could not be allocated.
+ */
+static long _stroke_alloc(pal_stroke_t* ps, int num, int scratch) {
+  const long size =
+    (MAX(1, num) + STROKE_SOA_PAD - 1) / STROKE_SOA_PAD * STROKE_SOA_PAD;
+  const size_t bytes = (_PAL_FEATURES + scratch) * size * sizeof(double);
+  if (posix_memalign(&ps->mem, STROKE_SOA_ALIGN, bytes)) {
+    fprintf(stderr, "Error: could not allocate %zd bytes.\n", bytes);
+    ps->mem = NULL;
+    return 0;
+  }
+  bzero(ps->mem, bytes);
+
+  ps->dir = (double*)ps->mem;
+  ps->dy_dx = ps->dir + size;
+  ps->sp = ps->dy_dx + size;
+  ps->curv = ps->sp + size;
+  ps->arc = ps->curv + size;
+  return size;
+}
+
+/*! Finds the highest value in part of a column.  Ties go to the first.
+ *
+ * \param col The column.
+ * \param first The index to start at (incl.).
+ * \param last The index to stop at (excl.); must be greater than `first`.
+ *
+ * \return The index of the highest value.
+ */
+static inline int _argmax(const double* restrict col, int first, int last) {
+  int max_i = first;
+  for (int i = first + 1; i < last; i++) {
+    max_i = (col[i] > col[max_i]) ? i : max_i;
+  }
+  return max_i;
+}
 
 /*!
  * Does pre-processing on a stroke to create a paleo stroke.  Paleo strokes
  * have some extra information that is used by the individual recognizers.
  *
+ * Everything is found in two passes: one over the raw points, which drops
+ * repeats and measures each segment as it is kept, and one over the kept
+ * points, which reads those lengths for every feature along the stroke.  The
+ * first pass also builds the arc-length index, so nothing after it walks the
+ * points to add up lengths.
+ * Each feature goes in its own column, so the scans over one feature read
+ * only that column.
+ *
+ * \param self The Paleo context.
  * \param strk The stroke to process/recognize.
  */
-static void _process_stroke(const stroke_t* strk) {
-  pal_stroke_t* ps = &paleo.stroke;
+static void _process_stroke(pal_context_t* self, const stroke_t* strk) {
+  pal_stroke_t* ps = &self->stroke;
+  _stroke_reset(ps);
   ps->pts = calloc(strk->num, sizeof(pal_point_t));
-
-  // PaleoSketch, pg 3, para 1:
-  //    "If two consecutive points either have the same x and y values or if
-  //     they have the same time value then the second point is removed."
-  for (int i = 0; i < strk->num; i++) {
-    if (i > 0) {
-      pal_point_t* last = &ps->pts[ps->num_pts-1];
-      if (last->p.t == strk->pts[i].t ||
-          (last->p.x == strk->pts[i].x && last->p.y == strk->pts[i].y)) {
-        continue;  // Same time or same coords, so skipping.
-      }
-    }
-
-    // Got this far, so okay to add this point (also, update ps->num_pts).
-    memcpy(&ps->pts[ps->num_pts++], &strk->pts[i], sizeof(point_t));
-  }
-
-  // Cut down on memory use (there may have been removed points).
-  if (ps->num_pts < strk->num) {
-    ps->pts = realloc(ps->pts, ps->num_pts * sizeof(pal_point_t));
+  const long size = _stroke_alloc(ps, strk->num, 2);
+  if (size == 0) {
+    return;
   }
+  double* restrict dir = ps->dir;
+  double* restrict dy_dx = ps->dy_dx;
+  double* restrict curv = ps->curv;
+  double* restrict arc = ps->arc;
+  double* restrict lens = ps->arc + size;   // scratch: segment lengths
+  double* restrict ddir = lens + size;      // scratch: changes in direction
 
   // PaleoSketch, pg 3, para 2:
   //    "Next, a series of graphs and values are computed for the stroke,
@@ -319,96 +400,135 @@ static void _process_stroke(const stroke_t* strk) {
   //        Computer Graphics and Interactive Techniques in Australasia and
   //        South East Asia, ACM Press (2003),141-146.
 
-  // First compute the direction as in Yu et al.'s paper:
-  for (int i = 0; i < ps->num_pts - 1; i++) {
-    ps->pts[i].dir = _yu_direction(&ps->pts[i].p2d, &ps->pts[i+1].p2d);
+  // First pass: each point kept closes a segment, `lens[j-1]`, which gives the
+  // direction (as in Yu et al.'s paper) and speed of the point before it, the
+  // dy/dx of this one (to compute NDDE), and the length up to it.
+  int max_i = 1;
+  int min_i = 1;
+  for (int i = 0; i < strk->num; i++) {
+    // PaleoSketch, pg 3, para 1:
+    //    "If two consecutive points either have the same x and y values or if
+    //     they have the same time value then the second point is removed."
+    if (i > 0) {
+      pal_point_t* last = &ps->pts[ps->num_pts-1];
+      if (last->p.t == strk->pts[i].t ||
+          (last->p.x == strk->pts[i].x && last->p.y == strk->pts[i].y)) {
+        continue;  // Same time or same coords, so skipping.
+      }
+    }
+
+    // Got this far, so okay to add this point (also, update ps->num_pts).
+    const int j = ps->num_pts++;
+    memcpy(&ps->pts[j], &strk->pts[i], sizeof(point_t));
+    if (j == 0) {
+      continue;
+    }
+
+    pal_point_t* a = &ps->pts[j-1];
+    pal_point_t* b = &ps->pts[j];
+    lens[j-1] = point2d_distance(&a->p2d, &b->p2d);
+    arc[j] = arc[j-1] + lens[j-1];
+    dir[j-1] = _yu_direction(&a->p2d, &b->p2d);
 
     // Correct, if there's never a jump where, |d jump| > pi.  This
     // normalization process ensures that the direction graph is as smooth as it
     // can be given the changes in stroke direction that are common with
     // freehand drawing.  Shape tests assume that the graph will be smooth in
     // this way.
-    if (i > 0) {   // else, array O.O.B. error.
-      while (ps->pts[i].dir - ps->pts[i-1].dir > M_PIl) {
-        ps->pts[i].dir += 2 * M_PIl;
+    if (j > 1) {   // else, array O.O.B. error.
+      while (dir[j-1] - dir[j-2] > M_PIl) {
+        dir[j-1] += 2 * M_PIl;
       }
-      while (ps->pts[i].dir - ps->pts[i-1].dir < -M_PIl) {
-        ps->pts[i].dir -= 2 * M_PIl;
+      while (dir[j-1] - dir[j-2] < -M_PIl) {
+        dir[j-1] -= 2 * M_PIl;
       }
     }
 
     // I wasn't sure about how to compute speed (I'll have to look more
     // carefully at the Sezgin paper), so I just figured it should be in px/s.
-    ps->pts[i].sp = _speed(&ps->pts[i].p2dt, &ps->pts[i+i].p2dt);
-  }
+    ps->sp[j-1] = _speed(lens[j-1], &a->p2dt, &b->p2dt);
 
-  // Next compute the curvature (based on direction).
-  for (int i = 1; i < ps->num_pts - 1; i++) {
-    ps->pts[i].curv = _yu_curvature(
-        ((K < i) ?
-            ((K < ps->num_pts - i - 1) ?
-                K :
-                ps->num_pts - i - 1) :
-            i),
-        &ps->pts[i]);
+    dy_dx[j] = _dy_dx_direction(&a->p2d, &b->p2d);
+    if (dy_dx[j] > dy_dx[max_i]) { max_i = j; }
+    if (dy_dx[j] < dy_dx[min_i]) { min_i = j; }
   }
 
-  _paulson_corners();
-
-  // Compute length.
-  ps->px_length = 0;
-  for (int i = 1; i < ps->num_pts; i++) {
-    ps->px_length += point2d_distance(&ps->pts[i-1].p2d, &ps->pts[i].p2d);
+  // Cut down on memory use (there may have been removed points).
+  if (ps->num_pts < strk->num) {
+    ps->pts = realloc(ps->pts, ps->num_pts * sizeof(pal_point_t));
   }
-
-  // Compute dy/dx for each point (to compute NDDE).
-  int max_i = 1;
-  int min_i = 1;
-  for (int i = 1; i < ps->num_pts; i++) {
-    ps->pts[i].dy_dx = _dy_dx_direction(&ps->pts[i-1].p2d, &ps->pts[i].p2d);
-    if (ps->pts[i].dy_dx > ps->pts[max_i].dy_dx) { max_i = i; }
-    if (ps->pts[i].dy_dx < ps->pts[min_i].dy_dx) { min_i = i; }
+  ps->px_length = arc[ps->num_pts-1];
+
+  // The change in direction over each segment, for curvature: one sweep over
+  // the padded columns, then a fix-up of the few changes beyond pi.  Past the
+  // end of `dir`, the sweep reads only the padding and the next column.
+  const int num = ps->num_pts;
+  _dir_changes(dir, ddir, size);
+  for (int j = 0; j < num - 1; j++) {
+    while (ddir[j] >  M_PIl) { ddir[j] -= M_PIl; }
+    while (ddir[j] < -M_PIl) { ddir[j] += M_PIl; }
   }
 
-  // Compute length between min and max, then normalize.
-  double sub_length = 0;
+  // Second pass: the curvature of each point, and the DCR, which reads the
+  // stroke by length-based progress along it.
+  const short trim = num >= PAL_THRESH_B && ps->px_length >= PAL_THRESH_C;
   if (max_i < min_i) { SWAP(max_i, min_i); }
-  for (int i = min_i + 1; i < max_i; i++) {
-    sub_length += point2d_distance(&ps->pts[i-1].p2d, &ps->pts[i].p2d);
+  double dcr_first_i = -1, dcr_last_i = -1;  // portion of stroke DCR uses
+  double avg_d_dir = 0;   // average change in direction
+  double max_d_dir = 0;   // maximum change in direction
+  for (int i = 1; i < num; i++) {
+    if (i < num - 1) {
+      curv[i] = _yu_curvature(
+          ((K < i) ?
+              ((K < num - i - 1) ?
+                  K :
+                  num - i - 1) :
+              i),
+          &ddir[i], &lens[i], num - i);
+    }
+
+    // DCR, over the middle 90% of the stroke.
+    const double prog_pct = arc[i] / ps->px_length;
+    if (dcr_last_i < 0 && !(prog_pct <= 0.05)) {
+      if (dcr_first_i < 0) { dcr_first_i = i; }
+      if (prog_pct >= 0.95) {
+        dcr_last_i = i;
+      } else {
+        double d_dir = abs(dir[i-1] - dir[i]);
+        if (d_dir > max_d_dir) { max_d_dir = d_dir; }
+        avg_d_dir += d_dir;
+      }
+    }
   }
+
+  // Normalize the length between the dy/dx extremes, and find the DCR.
+  const double sub_length = pal_stroke_length(ps, min_i, MAX(min_i, max_i-1));
   ps->ndde = sub_length / ps->px_length;
+  avg_d_dir /= dcr_last_i - dcr_first_i + 1;
+  ps->dcr = max_d_dir / avg_d_dir;
+
+  // Trim tails -- find the highest curvature in the first 20% of the stroke,
+  // and in the last 20% (short of the last point).
+  int first_i = 0, last_i = num - 1;
+  if (trim) {
+    first_i = _argmax(curv, 0, pal_stroke_index_at(ps, 0.20));
+    const int tail_i = pal_stroke_index_at(ps, 0.80);
+    if (tail_i < num - 1) {
+      const int max_curv_i = _argmax(curv, tail_i, num - 1);
+      if (curv[max_curv_i] > curv[last_i]) { last_i = max_curv_i; }
+    }
+  }
 
-  // Compute DCR.
-  _compute_dcr();
+  _paulson_corners(self);
 
-  if (ps->num_pts < PAL_THRESH_B || ps->px_length < PAL_THRESH_C) {
+  if (!trim) {
     // Stroke too small to warrant tail removal.
     return;
   }
-
-  // Trim tails -- find first and last highest curvature.
-  int first_i = 0, last_i = ps->num_pts - 1;
-  double prog = 0;
-  for (int i = 1; i < ps->num_pts - 1; i++) {
-    prog += point2d_distance(&ps->pts[i-1].p2d, &ps->pts[i].p2d);
-    double prog_pct = prog / ps->px_length;
-
-    if (prog_pct < 0.20) {  // Scanning for first tail ...
-      if (ps->pts[first_i].curv < ps->pts[i].curv) {
-        first_i = i;
-      }
-    } else if (0.20 < prog_pct && prog_pct < 0.80) {
-      continue;
-    } else {  // Scanning for last tail ...
-      if (ps->pts[last_i].curv < ps->pts[i].curv) {
-        last_i = i;
-      }
-    }
-  }
-  _break_stroke(first_i, last_i);
+  _break_stroke(self, first_i, last_i);
 
   // Compute total rotation & whether it's overtraced.
-  ps->tot_revs = (ps->pts[ps->num_pts-1].dir - ps->pts[0].dir) / (2 * M_PIl);
+  ps->tot_revs = (ps->dir[ps->num_pts-1] - ps->dir[0]) / (2 * M_PIl);
   ps->overtraced = ps->tot_revs > PAL_THRESH_D;
 
   // Compute closed-ness.
@@ -420,26 +540,29 @@ static inline double _yu_direction(const point2d_t* a, const point2d_t* b) {
   return atan((b->y - a->y) / (b->x - a->x));
 }
 
-static inline double _yu_curvature(int k, const pal_point_t* sub_strk) {
-  const int NUM = 2*k+1;
+static inline double _yu_curvature(int k, const double* restrict ddir,
+                                   const double* restrict lens, int num) {
+  const int NUM = MIN(2*k+1, num-1);
 
   double diff_sum = 0;  // sum of direction differences.
   double len = 0;       // substroke length
   for (int i = 0; i < NUM; i++) {
-    // Add next sub-segment length.
-    len += point2d_distance(
-        (point2d_t*)&sub_strk[i], (point2d_t*)&sub_strk[i+1]);
-
-    // Find direction difference, normalize, and add to diff_sum.
-    double diff = sub_strk[i+1].dir - sub_strk[i].dir;
-    while (diff >  M_PIl) { diff -= M_PIl; }
-    while (diff < -M_PIl) { diff += M_PIl; }
-    diff_sum += diff;
+    len += lens[i];
+    diff_sum += ddir[i];
   }
 
   return diff_sum / len;
 }
 
+static inline void _dir_changes(const double* restrict dir,
+                                double* restrict ddir, long size) {
+  for (long j = 0; j < size; j += STROKE_SOA_PAD) {
+    for (int k = 0; k < STROKE_SOA_PAD; k++) {
+      ddir[j+k] = dir[j+k+1] - dir[j+k];
+    }
+  }
+}
+
 static inline double _dy_dx_direction(const point2d_t* a, const point2d_t* b) {
   return (b->y - a->y) / (b->x - a->x);
 }
@@ -448,87 +571,92 @@ static inline double _dy_dx_direction(const point2d_t* a, const point2d_t* b) {
  * Merges corners sufficiently close together.  Returns whether something was
  * changed in the `crnrs` array.
  *
+ * \param self The Paleo context.
+ *
  * \return A `bool` value; 0 means nothing merged, 1 means something was.
  */
-static inline short _paulson_merge_corners();
+static inline short _paulson_merge_corners(pal_context_t* self);
 
 /*!
  * Find highest curvature in each corner's neighbor hood and set that as the
  * corner.  Whether something was changed in the `crnrs` array.
  *
+ * \param self The Paleo context.
+ *
  * \return A `bool` value; 0 means nothing changed, 1 means something was.
  */
-static inline short _paulson_replace_corners();
+static inline short _paulson_replace_corners(pal_context_t* self);
 
-static inline void _paulson_corners() {
-  assert(paleo.stroke.num_crnrs == 0);
-  assert(paleo.stroke.crnrs == NULL);
+static inline void _paulson_corners(pal_context_t* self) {
+  assert(self->stroke.num_crnrs == 0);
+  assert(self->stroke.crnrs == NULL);
 
   // Convenience macro to make lines shorter.
   #define _pal_add_to_corners(i) \
-  (paleo.stroke.crnrs[paleo.stroke.num_crnrs++] = &paleo.stroke.pts[(i)])
+  (self->stroke.crnrs[self->stroke.num_crnrs++] = &self->stroke.pts[(i)])
 
   // init corners with 0th point.
-  paleo.stroke.num_crnrs = 0;
-  paleo.stroke.crnrs = realloc(paleo.stroke.crnrs,
-      paleo.stroke.num_pts * sizeof(pal_point_t*));
+  self->stroke.num_crnrs = 0;
+  self->stroke.crnrs = realloc(self->stroke.crnrs,
+      MAX(2, self->stroke.num_pts) * sizeof(pal_point_t*));
   _pal_add_to_corners(0);
 
-  pal_point_t* last = &paleo.stroke.pts[0];
-  double px_length = 0;
-  for (int i = 1; i < paleo.stroke.num_pts - 1; i++) {
-    px_length += point2d_distance(
-        &paleo.stroke.pts[i-1].p2d, &paleo.stroke.pts[i].p2d);
-
+  pal_point_t* last = &self->stroke.pts[0];
+  for (int i = 1; i < self->stroke.num_pts - 1; i++) {
     // Are we un-line-like enough?
     if (point2d_distance(
-          &last->p2d, &paleo.stroke.pts[i].p2d) > PAL_THRESH_Y) {
+          &last->p2d, &self->stroke.pts[i].p2d) > PAL_THRESH_Y) {
       _pal_add_to_corners(i-1);
-      last = &paleo.stroke.pts[i];
-      px_length = 0;
+      last = &self->stroke.pts[i];
     }
   }
 
-  _pal_add_to_corners(paleo.stroke.num_pts-1);
-  paleo.stroke.crnrs = realloc(paleo.stroke.crnrs,
-      paleo.stroke.num_crnrs * sizeof(pal_point_t*));
+  _pal_add_to_corners(self->stroke.num_pts-1);
+  self->stroke.crnrs = realloc(self->stroke.crnrs,
+      self->stroke.num_crnrs * sizeof(pal_point_t*));
 
   #undef _pal_add_to_corners
 
   // Merge corners and replace with highest in region until no change.
-  while(_paulson_merge_corners() || _paulson_replace_corners());
+  while(_paulson_merge_corners(self) || _paulson_replace_corners(self));
 }
 
-static inline short _paulson_merge_corners() {
+/*! The index in `pts` of a corner.  Not `p.i`, which still counts the points
+ * dropped as repeats until the tails are broken off.
+ *
+ * \param c The corner.
+ */
+#define _pal_crnr_i(c) ((int)(self->stroke.crnrs[(c)] - self->stroke.pts))
+
+static inline short _paulson_merge_corners(pal_context_t* self) {
   short rtn = 0;
-  for (int c = 1; c < paleo.stroke.num_crnrs; c++) {
-    if (paleo.stroke.crnrs[c-1]->p.i + PAL_THRESH_Z * paleo.stroke.num_pts <=
-        paleo.stroke.crnrs[c]->p.i) {  // Sufficiently close to be merged.
+  for (int c = 1; c < self->stroke.num_crnrs; c++) {
+    if (_pal_crnr_i(c-1) + PAL_THRESH_Z * self->stroke.num_pts <=
+        _pal_crnr_i(c)) {  // Sufficiently close to be merged.
       rtn = 1;
       if (c == 1) {   // 0th point: just remove other point.
-        memmove(&paleo.stroke.crnrs[1], &paleo.stroke.crnrs[2],
-            (paleo.stroke.num_crnrs-2) * sizeof(pal_point_t*));
-        paleo.stroke.crnrs = realloc(paleo.stroke.crnrs,
-            --paleo.stroke.num_crnrs * sizeof(pal_point_t*));
+        memmove(&self->stroke.crnrs[1], &self->stroke.crnrs[2],
+            (self->stroke.num_crnrs-2) * sizeof(pal_point_t*));
+        self->stroke.crnrs = realloc(self->stroke.crnrs,
+            --self->stroke.num_crnrs * sizeof(pal_point_t*));
         c--;
-      } else if (c == paleo.stroke.num_crnrs - 1) {  // Last point:
+      } else if (c == self->stroke.num_crnrs - 1) {  // Last point:
         // Just remove other point.
-        memmove(&paleo.stroke.crnrs[paleo.stroke.num_crnrs-2],
-            &paleo.stroke.crnrs[paleo.stroke.num_crnrs-1],
+        memmove(&self->stroke.crnrs[self->stroke.num_crnrs-2],
+            &self->stroke.crnrs[self->stroke.num_crnrs-1],
             sizeof(pal_point_t*));
-        paleo.stroke.crnrs = realloc(paleo.stroke.crnrs,
-            --paleo.stroke.num_crnrs * sizeof(pal_point_t*));
+        self->stroke.crnrs = realloc(self->stroke.crnrs,
+            --self->stroke.num_crnrs * sizeof(pal_point_t*));
         c--;
-      } else if (c >= paleo.stroke.num_crnrs) {
+      } else if (c >= self->stroke.num_crnrs) {
         assert(0);
       } else {
-        const int avg_i =
-          (paleo.stroke.crnrs[c-1]->p.i + paleo.stroke.crnrs[c]->p.i) / 2;
-        paleo.stroke.crnrs[c-1] = &paleo.stroke.pts[avg_i];
-        memmove(&paleo.stroke.crnrs[c], &paleo.stroke.crnrs[c+1],
-            (paleo.stroke.num_crnrs - c - 1) * sizeof(pal_point_t*));
-        paleo.stroke.crnrs = realloc(paleo.stroke.crnrs,
-            --paleo.stroke.num_crnrs * sizeof(pal_point_t*));
+        const int avg_i = (_pal_crnr_i(c-1) + _pal_crnr_i(c)) / 2;
+        self->stroke.crnrs[c-1] = &self->stroke.pts[avg_i];
+        memmove(&self->stroke.crnrs[c], &self->stroke.crnrs[c+1],
+            (self->stroke.num_crnrs - c - 1) * sizeof(pal_point_t*));
+        self->stroke.crnrs = realloc(self->stroke.crnrs,
+            --self->stroke.num_crnrs * sizeof(pal_point_t*));
         c--;
       }
     }
@@ -536,60 +664,55 @@ static inline short _paulson_merge_corners() {
   return rtn;
 }
 
-static inline short _paulson_replace_corners() {
-  const int range = (int)ceil(paleo.stroke.num_pts * PAL_THRESH_Z);
+static inline short _paulson_replace_corners(pal_context_t* self) {
+  const int range = (int)ceil(self->stroke.num_pts * PAL_THRESH_Z);
+  const double* curv = self->stroke.curv;
   short rtn = 0;
-  for (int c = 0; c < paleo.stroke.num_crnrs; c++) {
-    pal_point_t* corner = paleo.stroke.crnrs[c];
-    for (int i = corner->p.i - range;
-        i < MIN(corner->p.i + range, paleo.stroke.num_pts); i++) {
-      if (paleo.stroke.pts[i].curv > paleo.stroke.crnrs[c]->curv) {
-        paleo.stroke.crnrs[c] = &paleo.stroke.pts[i];
-        rtn = 1;
-      }
+  for (int c = 0; c < self->stroke.num_crnrs; c++) {
+    const int corner_i = _pal_crnr_i(c);
+    const int max_i = _argmax(curv, MAX(0, corner_i - range),
+        MIN(corner_i + range, self->stroke.num_pts));
+    if (curv[max_i] > curv[corner_i]) {
+      self->stroke.crnrs[c] = &self->stroke.pts[max_i];
+      rtn = 1;
     }
   }
   return rtn;
 }
 
-static inline void _compute_dcr() {
-  double prog = 0;  // length-based progress along the stroke
-  double first_i = -1, last_i = -1;  // portion of stroke we use
-  double avg_d_dir = 0;  // average change in direction
-  double max_d_dir = 0;  // maximum change in direction
-  for (int i = 1; i < paleo.stroke.num_pts; i++) {
-    prog += point2d_distance(
-        &paleo.stroke.pts[i-1].p2d, &paleo.stroke.pts[i].p2d);
-
-    if (prog / paleo.stroke.px_length <= 0.05) { continue; }
-    if (first_i < 0) { first_i = i; }
-    if (prog / paleo.stroke.px_length >= 0.95) {
-      last_i = i;
-      break;
-    }
-
-    double d_dir = abs(paleo.stroke.pts[i-1].dir - paleo.stroke.pts[i].dir);
-    if (d_dir > max_d_dir) { max_d_dir = d_dir; }
-    avg_d_dir += d_dir;
-  }
-  avg_d_dir /= last_i - first_i + 1;
-  paleo.stroke.dcr = max_d_dir / avg_d_dir;
-}
+#undef _pal_crnr_i
 
-static inline void _break_stroke(int first_i, int last_i) {
+static inline void _break_stroke(pal_context_t* self, int first_i, int last_i) {
   // Sanity check.
-  assert(0 <= first_i && first_i < last_i && last_i < paleo.stroke.num_pts);
+  assert(0 <= first_i && first_i < last_i && last_i < self->stroke.num_pts);
+
+  // Trim off tails, and zero what they leave at the ends of the columns.
+  const int old_num = self->stroke.num_pts;
+  self->stroke.num_pts = last_i - first_i + 1;
+  memmove(self->stroke.pts, &self->stroke.pts[first_i],
+      self->stroke.num_pts * sizeof(pal_point_t));
+  self->stroke.pts = realloc(self->stroke.pts,
+      self->stroke.num_pts * sizeof(pal_point_t));
+  double* cols[_PAL_FEATURES] = {
+    self->stroke.dir, self->stroke.dy_dx, self->stroke.sp, self->stroke.curv,
+    self->stroke.arc
+  };
+  for (int c = 0; c < _PAL_FEATURES; c++) {
+    memmove(cols[c], &cols[c][first_i],
+        self->stroke.num_pts * sizeof(double));
+    bzero(&cols[c][self->stroke.num_pts],
+        (old_num - self->stroke.num_pts) * sizeof(double));
+  }
 
-  // Trim off tails.
-  paleo.stroke.num_pts = last_i - first_i + 1;
-  memmove(paleo.stroke.pts, &paleo.stroke.pts[first_i],
-      paleo.stroke.num_pts * sizeof(pal_point_t));
-  paleo.stroke.pts = realloc(paleo.stroke.pts,
-      paleo.stroke.num_pts * sizeof(pal_point_t));
+  // Lengths are now from the new first point.
+  const double start = self->stroke.arc[0];
+  for (int i = 0; i < self->stroke.num_pts; i++) {
+    self->stroke.arc[i] -= start;
+  }
 
   // Correct point index's.
-  for (int i = 0; i < paleo.stroke.num_pts; i++) {
-    paleo.stroke.pts[i].p.i = i;
+  for (int i = 0; i < self->stroke.num_pts; i++) {
+    self->stroke.pts[i].p.i = i;
   }
 }
 
@@ -604,13 +727,35 @@ static inline void _break_stroke(int first_i, int last_i) {
  */
 static inline int _rank_res(pal_type_e type, const void* res);
 
-pal_type_e pal_recognize(const stroke_t* stroke) {
+int pal_stroke_index_at(const pal_stroke_t* self, double frac) {
+  int lo = 0, hi = self->num_pts - 1;
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    if (pal_stroke_param(self, mid) < frac) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+const pal_stroke_t* pal_process(pal_context_t* self, const stroke_t* stroke) {
+  if (stroke->num <= 0) {
+    _stroke_reset(&self->stroke);
+  } else {
+    _process_stroke(self, stroke);
+  }
+  return &self->stroke;
+}
+
+pal_type_e pal_recognize(pal_context_t* self, const stroke_t* stroke) {
   if (stroke->num <= 0) {
     return PAL_TYPE_INDET;
   }
 
   // Process simple stroke to create Paleo stroke.
-  _process_stroke(stroke);
+  _process_stroke(self, stroke);
 
   // Create a structure to hold all the test results.
   struct {
@@ -626,15 +771,16 @@ pal_type_e pal_recognize(const stroke_t* stroke) {
   } r;
 
   // Run each test in turn, copying over the result into the Paleo object.
-  r.line = pal_line_result_cln(pal_line_test(&paleo.stroke));
-  r.pline = pal_line_result_cln(pal_pline_test(&paleo.stroke));
-  r.ellipse = pal_ellipse_result_cln(pal_ellipse_test(&paleo.stroke));
-  r.circle = pal_circle_result_cln(pal_circle_test(&paleo.stroke));
-  r.arc = pal_arc_result_cln(pal_arc_test(&paleo.stroke));
-  r.curve = pal_curve_result_cln(pal_curve_test(&paleo.stroke));
-  r.spiral = pal_spiral_result_cln(pal_spiral_test(&paleo.stroke));
-  r.helix = pal_helix_result_cln(pal_helix_test(&paleo.stroke));
-  r.composite = pal_composite_result_cln(pal_composite_test(&paleo.stroke));
+  r.line = pal_line_result_cln(pal_line_test(self, &self->stroke));
+  r.pline = pal_line_result_cln(pal_pline_test(self, &self->stroke));
+  r.ellipse = pal_ellipse_result_cln(pal_ellipse_test(self, &self->stroke));
+  r.circle = pal_circle_result_cln(pal_circle_test(self, &self->stroke));
+  r.arc = pal_arc_result_cln(pal_arc_test(self, &self->stroke));
+  r.curve = pal_curve_result_cln(pal_curve_test(self, &self->stroke));
+  r.spiral = pal_spiral_result_cln(pal_spiral_test(self, &self->stroke));
+  r.helix = pal_helix_result_cln(pal_helix_test(self, &self->stroke));
+  r.composite = pal_composite_result_cln(
+      pal_composite_test(self, &self->stroke));
 
   // Go through a hierarchy to determine which shape should be the final one.
   //
@@ -649,7 +795,7 @@ pal_type_e pal_recognize(const stroke_t* stroke) {
 
   // Do hierarchy; the following comment stanzas just quote the paper's
   // hierarchy section.
-  _hier_reset(&paleo.h);
+  _hier_reset(&self->h);
 
   // 1. All lines.
   ENQ_H(LINE, r.line);
@@ -664,8 +810,8 @@ pal_type_e pal_recognize(const stroke_t* stroke) {
   //    [X].  We use a less strict DCR threshold [J] if all sub-strokes passed
   //    the line test.
   int passed = 1;
-  if (paleo.stroke.dcr > PAL_THRESH_W &&
-      paleo.stroke.num_crnrs < PAL_THRESH_X) {
+  if (self->stroke.dcr > PAL_THRESH_W &&
+      self->stroke.num_crnrs < PAL_THRESH_X) {
     ENQ_H(PLINE, r.pline);
     passed = 0;
   }
@@ -684,7 +830,7 @@ pal_type_e pal_recognize(const stroke_t* stroke) {
   //    the circle (as determined by the ranking algorithm) then polyline is
   //    added in front of the circle interpretation. This exception does not
   //    apply to small circles [N].
-  if ((!paleo.stroke.overtraced && r.circle->fa < r.pline->res[0].fa)) {
+  if ((!self->stroke.overtraced && r.circle->fa < r.pline->res[0].fa)) {
     // Remember that r.pline->num = rank + 1.
     if (r.circle->circle.r >= PAL_THRESH_N &&
         r.pline->res[0].possible && r.pline->num <= PAL_RANK_CIRCLE) {
@@ -698,7 +844,7 @@ pal_type_e pal_recognize(const stroke_t* stroke) {
   //    polylines that meet the conditions mentioned in part 4.  Again, this
   //    would not apply to small ellipses [L]. A circle fit will also be added
   //    with the ellipse as an alternative interpretation.
-  if ((!paleo.stroke.overtraced && r.ellipse->fa < r.pline->res[0].fa)) {
+  if ((!self->stroke.overtraced && r.ellipse->fa < r.pline->res[0].fa)) {
     if (r.ellipse->ellipse.maj >= PAL_THRESH_L &&
         r.pline->res[0].possible && r.pline->num <= PAL_RANK_ELLIPSE) {
       ENQ_H(PLINE, r.pline);
@@ -712,7 +858,7 @@ pal_type_e pal_recognize(const stroke_t* stroke) {
 
   // 7. Spirals that may have also passed an overtraced circle or overtraced
   //    ellipse test.
-  if (paleo.stroke.overtraced) {
+  if (self->stroke.overtraced) {
     ENQ_H(SPIRAL, r.spiral);
   }
 
@@ -756,13 +902,13 @@ pal_type_e pal_recognize(const stroke_t* stroke) {
   //    is less than the current interpretation rank then the complex
   //    interpretation is added at the front of the list. Otherwise, we add the
   //    complex fit to the end of the interpretation list.
-  if (paleo.h.num == 0 ||
-      paleo.h.elems[0].type == PAL_TYPE_CURVE ||
-      paleo.h.elems[0].type == PAL_TYPE_PLINE) {
+  if (self->h.num == 0 ||
+      self->h.elems[0].type == PAL_TYPE_CURVE ||
+      self->h.elems[0].type == PAL_TYPE_PLINE) {
     if (pal_composite_is_line(&r.composite->composite)) {
       ENQ_H(PLINE, r.pline);
     } else if (pal_composite_rank(&r.composite->composite) <
-       _rank_res(paleo.h.elems[0].type, paleo.h.elems[0].res)) {
+       _rank_res(self->h.elems[0].type, self->h.elems[0].res)) {
       PUSH_H(COMPOSITE, r.composite);
     } else {
       ENQ_H(COMPOSITE, r.composite);
@@ -822,8 +968,10 @@ int pal_shape_rank(pal_type_e type, const void* shape) {
   return INT_MIN;
 }
 
-pal_type_e pal_last_type() { return TYPE(); }
+pal_type_e pal_last_type(const pal_context_t* self) { return TYPE(); }
 
-const pal_stroke_t* pal_last_stroke() { return &paleo.stroke; }
+const pal_stroke_t* pal_last_stroke(const pal_context_t* self) {
+  return &self->stroke;
+}
 
 /*! \} */
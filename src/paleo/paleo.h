@@ -11,6 +11,7 @@
 
 #include "common/point.h"
 #include "common/stroke.h"
+#include "common/stroke_soa.h"
 
 #include "thresh.h"
 
@@ -110,20 +111,33 @@ typedef enum {
  */
 #define PAL_MASK(elem) (PAL_MASK_##elem)
 
-//! A paleo point; just like a normal point, but with paleo-specific info.
+//! A paleo point; just like a normal point.  Paleo-specific info about it is
+//! kept in its stroke's feature columns.
 typedef struct {
   POINT_UNION;   //!< Inheriting from points.
-  int corner;    //!< Is this a corner?
-  double dir;    //!< Direction of stroke here.
-  double dy_dx;  //!< dy/dx wrt last point.
-  double sp;     //!< Speed of pen when drawing this point.
-  double curv;   //!< Curvature at this point.
 } pal_point_t;
 
-//! A paleo stroke; just like a normal stroke, but some paleo-specific info.
+/*! A paleo stroke; just like a normal stroke, but some paleo-specific info.
+ *
+ * The features of each point are kept in columns, one per feature, rather than
+ * in its `pal_point_t`, so that a scan over one feature reads only that
+ * feature.  Each column holds `num_pts` values, starts on a
+ * `STROKE_SOA_ALIGN`-byte boundary and is padded with zeros to a multiple of
+ * `STROKE_SOA_PAD`.  Use `pal_stroke_dir()` and friends to read them.
+ *
+ * The `arc` column indexes the stroke by arc length: it holds the length of
+ * the stroke from its first point up to each point, so the length of any part
+ * of the stroke is a subtraction (see `pal_stroke_length()`).
+ */
 typedef struct {
   int num_pts;            //!< Number of points.
   pal_point_t* pts;       //!< Points.
+  double* dir;            //!< Direction of stroke at each point.
+  double* dy_dx;          //!< dy/dx at each point wrt the last point.
+  double* sp;             //!< Speed of pen when drawing each point.
+  double* curv;           //!< Curvature at each point.
+  double* arc;            //!< Length of the stroke up to each point.
+  void* mem;              //!< Block owning the feature columns.
   int num_crnrs;          //!< Number of corners.
   pal_point_t** crnrs;    //!< Pointers to the points in 'pts' that are corners.
   double px_length;       //!< Length of the stroke in pixels.
@@ -134,6 +148,86 @@ typedef struct {
   short closed;           //!< Whether the shape is closed.
 } pal_stroke_t;
 
+/*! Gets the direction of a Paleo stroke at a point.
+ *
+ * \param self The Paleo stroke.
+ * \param i The index of the point.
+ *
+ * \return The direction.
+ */
+static inline double pal_stroke_dir(const pal_stroke_t* self, int i) {
+  return self->dir[i];
+}
+
+/*! Gets the dy/dx of a Paleo stroke at a point, wrt the point before it.
+ *
+ * \param self The Paleo stroke.
+ * \param i The index of the point.
+ *
+ * \return The dy/dx.
+ */
+static inline double pal_stroke_dy_dx(const pal_stroke_t* self, int i) {
+  return self->dy_dx[i];
+}
+
+/*! Gets the speed of the pen when drawing a point of a Paleo stroke.
+ *
+ * \param self The Paleo stroke.
+ * \param i The index of the point.
+ *
+ * \return The speed.
+ */
+static inline double pal_stroke_sp(const pal_stroke_t* self, int i) {
+  return self->sp[i];
+}
+
+/*! Gets the curvature of a Paleo stroke at a point.
+ *
+ * \param self The Paleo stroke.
+ * \param i The index of the point.
+ *
+ * \return The curvature.
+ */
+static inline double pal_stroke_curv(const pal_stroke_t* self, int i) {
+  return self->curv[i];
+}
+
+/*! Gets the length of a Paleo stroke between two of its points.
+ *
+ * \param self The Paleo stroke.
+ * \param first_i The index of the first point.
+ * \param last_i The index of the last point; not less than `first_i`.
+ *
+ * \return The length, in pixels.
+ */
+static inline double pal_stroke_length(const pal_stroke_t* self, int first_i,
+                                       int last_i) {
+  return self->arc[last_i] - self->arc[first_i];
+}
+
+/*! Gets the arc-length parameter of a point in a Paleo stroke: the fraction of
+ * the stroke's length up to it, from 0 at the first point to 1 at the last.
+ *
+ * \param self The Paleo stroke.
+ * \param i The index of the point.
+ *
+ * \return The parameter; NaN if the stroke has no length.
+ */
+static inline double pal_stroke_param(const pal_stroke_t* self, int i) {
+  return self->arc[i] / self->arc[self->num_pts-1];
+}
+
+/*! Finds the first point at least a given fraction of the way along a Paleo
+ * stroke, by length, with a binary search.
+ *
+ * \param self The Paleo stroke; must not be empty.
+ * \param frac The fraction of the stroke's length.
+ *
+ * \return The index of the point; the last point if there is none, and the
+ *   first if the stroke has no length.
+ */
+int pal_stroke_index_at(const pal_stroke_t* self, double frac);
+
 //! A single element in the Paleo hierarchy.
 typedef struct {
   pal_type_e type;    //!< Type of this result.
@@ -150,11 +244,14 @@ typedef struct {
   int num;      //!< How filled it is.
 } pal_hier_t;
 
-//! The main Paleo object.  Keeps track of context.
-typedef struct {
-  pal_stroke_t stroke;    //!< The Paleo stroke we're recognizing.
-  pal_hier_t h;           //!< The hierarchy we're building.
-} pal_context_t;
+/*! The main Paleo object.  Keeps track of context.  Everything a recognition
+ * needs lives in here (the stroke, the hierarchy, and every shape test's own
+ * context), so separate contexts can be used on separate threads at once.
+ *
+ * The structure is opaque here; it is defined in context.h, which is only
+ * needed by the shape tests themselves.
+ */
+typedef struct pal_context pal_context_t;
 
 
 
@@ -162,17 +259,36 @@ typedef struct {
 // ------------------- Paleo Global Processing Functions -------------------- //
 ////////////////////////////////////////////////////////////////////////////////
 
-//! Initialize paleo.
-void pal_init();
+/*! Creates a new Paleo context.  The caller must call
+ * [\ref pal_destroy(pal_context_t*)] to free it.
+ *
+ * \return The context.
+ */
+pal_context_t* pal_create();
 
-//! De-initialize paleo (free its memory).
-void pal_deinit();
+/*! Destroys the Paleo context and frees all its memory.
+ *
+ * \param self The context to destroy.
+ */
+void pal_destroy(pal_context_t* self);
 
 /*! Processes the stroke, attempting to recognize it as one of the shapes here.
  *
+ * \param self The Paleo context to recognize with.
  * \param stroke The stroke to recognize.
  */
-pal_type_e pal_recognize(const stroke_t* stroke);
+pal_type_e pal_recognize(pal_context_t* self, const stroke_t* stroke);
+
+/*! Pre-processes the stroke into the Paleo stroke the shape tests work on, as
+ * pal_recognize(pal_context_t*, const stroke_t*) does first, without running
+ * the tests.
+ *
+ * \param self The Paleo context to process with.
+ * \param stroke The stroke to process.
+ *
+ * \return The Paleo stroke, as pal_last_stroke(const pal_context_t*) would.
+ */
+const pal_stroke_t* pal_process(pal_context_t* self, const stroke_t* stroke);
 
 /*! Finds the rank of a specific shape.
  *
@@ -181,11 +297,19 @@ pal_type_e pal_recognize(const stroke_t* stroke);
  */
 int pal_shape_rank(pal_type_e type, const void* shape);
 
-/*! Gets the last type returned by pal_recognize(const stroke_t*). */
-pal_type_e pal_last_type();
+/*! Gets the last type returned by
+ * pal_recognize(pal_context_t*, const stroke_t*).
+ *
+ * \param self The Paleo context.
+ */
+pal_type_e pal_last_type(const pal_context_t* self);
 
-/*! Returns the last-returned value from pal_process(const stroke_t*) */
-const pal_stroke_t* pal_last_stroke();
+/*! Returns the Paleo stroke built by the last call to
+ * pal_recognize(pal_context_t*, const stroke_t*).
+ *
+ * \param self The Paleo context.
+ */
+const pal_stroke_t* pal_last_stroke(const pal_context_t* self);
 
 #endif  //__paleo_h__
 
@@ -15,6 +15,7 @@
 #include "thresh.h"
 #include "test_macros.h"
 #include "spiral.h"
+#include "context.h"
 
 
 pal_spiral_t* pal_spiral_create() { return malloc(sizeof(pal_spiral_t)); }
@@ -39,26 +40,27 @@ void pal_spiral_point_at(const pal_spiral_t* self, point2d_t* p, double t) {
 
 
 
-/*! The context used for recognition. */
-static pal_spiral_context_t context;
+/*! The context used for recognition (part of the caller's Paleo context). */
+#define context (ctx->spiral)
 
-void pal_spiral_init() {
+void pal_spiral_init(pal_context_t* ctx) {
   bzero(&context, sizeof(pal_spiral_context_t));
 }
 
-void pal_spiral_deinit() { }
+void pal_spiral_deinit(pal_context_t* ctx) { }
 
 /*! Resets the spiral context to prep for a new recognition.
  *
+ * \param ctx The Paleo context.
  * \param stroke The stroke to recognize.
  */
-static void _reset(const pal_stroke_t* stroke) {
+static void _reset(pal_context_t* ctx, const pal_stroke_t* stroke) {
   bzero(&context, sizeof(pal_spiral_context_t));
   context.stroke = stroke;
 }
 
 const pal_spiral_result_t*
-pal_spiral_test(const pal_stroke_t* stroke) {
+pal_spiral_test(pal_context_t* ctx, const pal_stroke_t* stroke) {
   CHECK_RTN_RESULT(stroke->overtraced, "Stroke not overtraced.");
   CHECK_RTN_RESULT(stroke->ndde > PAL_THRESH_K,
       "NDDE too low: %.2f <= K (%.2f)", stroke->ndde, PAL_THRESH_K);
@@ -70,7 +72,7 @@ pal_spiral_test(const pal_stroke_t* stroke) {
       "ep_dist (%.2f) / px_len (%.2f) >= U (%.2f)",
       ep_dist, stroke->px_length, PAL_THRESH_U);
 
-  _reset(stroke);
+  _reset(ctx, stroke);
 
   // Calculate center (center of bbox).
   point2d_t max = { MINLONG, MINLONG }, min = { MAXLONG, MAXLONG };
@@ -101,13 +103,13 @@ pal_spiral_test(const pal_stroke_t* stroke) {
   // Break stroke up into 2pi increments.
   const int NP = stroke->num_pts;   // convenience: number of points
   const int NI = floor(             // number of 2pi increments.
-      (stroke->pts[NP-1].dir - stroke->pts[0].dir) / 2 * M_PIl);
+      (stroke->dir[NP-1] - stroke->dir[0]) / 2 * M_PIl);
   int* incs = calloc(NI+1, sizeof(int));
   incs[0] = 0;
-  double next_angle = stroke->pts[0].dir + 2 * M_PIl;
+  double next_angle = stroke->dir[0] + 2 * M_PIl;
   int next_inc = 1;
   for (int i = 1; i < NP; i++) {
-    if (stroke->pts[i].dir >= next_angle) {
+    if (stroke->dir[i] >= next_angle) {
       next_angle += 2 * M_PIl;
       incs[next_inc++] = i;
     }
@@ -172,12 +174,11 @@ pal_spiral_test(const pal_stroke_t* stroke) {
 
   // Seems to check out.  Populate the spiral.
   pal_spiral_t* sp = &context.result.spiral;
-  const pal_point_t* p_i = &stroke->pts[0];
   const pal_point_t* p_f = &stroke->pts[NP-1];
   const point2d_t* c = &context.ideal.center;
   memcpy(&sp->center, c, sizeof(point2d_t));
   sp->r = bbox_rad;
-  sp->theta_t = p_f->dir - p_i->dir;
+  sp->theta_t = stroke->dir[NP-1] - stroke->dir[0];
   sp->theta_f = atan2(p_f->y - c->y, p_f->x - c->x);
   while (sp->theta_f < 0) { sp->theta_f += 2 * M_PIl; }
   sp->cw = SGN(sp->theta_t);
@@ -185,4 +186,6 @@ pal_spiral_test(const pal_stroke_t* stroke) {
   return &context.result;
 }
 
+#undef context
+
 /*! \} */
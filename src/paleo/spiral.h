@@ -82,20 +82,28 @@ void pal_spiral_point_at(const pal_spiral_t* self, point2d_t* p, double t);
 
 
 
-/*! Initialize the curve test. */
-void pal_spiral_init();
+/*! Initialize the spiral test.
+ *
+ * \param ctx The Paleo context to initialize the test in.
+ */
+void pal_spiral_init(pal_context_t* ctx);
 
-/*! De-initializes the curve test. */
-void pal_spiral_deinit();
+/*! De-initializes the spiral test.
+ *
+ * \param ctx The Paleo context the test was initialized in.
+ */
+void pal_spiral_deinit(pal_context_t* ctx);
 
 /*!
  * Does the spiral test on the Paleo stroke.
  *
+ * \param ctx The Paleo context to test in.
  * \param stroke The stroke to test.
  *
  * \return The result of the recognition.
  */
-const pal_spiral_result_t* pal_spiral_test(const pal_stroke_t* stroke);
+const pal_spiral_result_t*
+pal_spiral_test(pal_context_t* ctx, const pal_stroke_t* stroke);
 
 /*!
  * Does a deep copy of a curve result.
@@ -5,9 +5,10 @@
  * \file test_macros.h
  * Contains several convenience macros used across PaleoSketch's recognizers.
  * These macros are to be used for convenience in Paleo test files.  They
- * assume you have a global "context" struct that contains a "result" struct
- * which inherits from Paleo results by including the PALEO_RESULT_UNION macro
- * at its top.
+ * assume "context" names a test context struct (usually a macro expanding to
+ * the test's member of the caller's pal_context_t) that contains a "result"
+ * struct which inherits from Paleo results by including the PALEO_RESULT_UNION
+ * macro at its top.
  */
 
 #ifndef __pal_test_macros_h__
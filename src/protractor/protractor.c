@@ -0,0 +1,233 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+
+#include "common/stroke_soa.h"
+#include "common/util.h"
+#include "dollarp/dollarp.h"
+#include "protractor.h"
+
+//! The amount to increase the template size by, each time it needs increasing.
+#define _PT_TMPL_INC 100
+
+//! Scratch space for `pt_recognize_ws()`.
+struct pt_workspace {
+  size_t n;               //!< Number of points `cloud` has room for.
+  stroke_soa_t* cloud;    //!< The query; its X and Y columns are its vector.
+};
+
+/*! Preprocesses a stroke into a unit vector: normalizes it as $P does, then
+ * scales its coordinates to unit length.
+ *
+ * \param strk The stroke; must not be empty.
+ * \param n The number of points.
+ * \param cloud Gets the vector; its `n` Xs, then its `n` Ys.  Must have room
+ *   for `n` points.
+ */
+static void _vectorize(const stroke_t* strk, size_t n, stroke_soa_t* cloud) {
+  dp_normalize(strk, n, cloud);
+
+  double sq = 0;
+  for (size_t i = 0; i < n; i++) {
+    sq += cloud->x[i] * cloud->x[i] + cloud->y[i] * cloud->y[i];
+  }
+  const double scale = (sq > 0) ? 1 / sqrt(sq) : 0;
+  for (size_t i = 0; i < n; i++) {
+    cloud->x[i] *= scale;
+    cloud->y[i] *= scale;
+  }
+}
+
+/*! Makes sure a workspace has room for the context's `n`.  Only allocates if
+ * `n` changed since the last call.
+ *
+ * \param self The workspace.
+ * \param ctx The Protractor context.
+ *
+ * \return 1 on success, 0 if memory ran out.
+ */
+static int _workspace_fit(pt_workspace_t* self, const pt_context_t* ctx) {
+  if (self->cloud && self->n == ctx->n) {
+    return 1;
+  }
+  if (self->cloud) {
+    stroke_soa_destroy(self->cloud);
+  }
+  self->n = ctx->n;
+  self->cloud = stroke_soa_create(ctx->n);
+  if (self->cloud == NULL) {
+    fprintf(stderr, "Error: could not allocate a workspace for n = %zd\n",
+            ctx->n);
+    return 0;
+  }
+  return 1;
+}
+
+/*! Computes the cosine of the smallest angle between a template's vector and a
+ * query's, over rotations of the query by up to \f$m\f$.  Rotating the query
+ * by \f$\phi\f$ gives a dot product of \f$a\cos\phi + b\sin\phi\f$, which
+ * peaks at \f$r = \sqrt{a^2 + b^2}\f$ when \f$\phi = \mathrm{atan2}(b, a)\f$.
+ * That rotation is in bounds iff \f$a \geq r\cos m\f$; if not, the best
+ * rotation is the nearer bound.  The rotation itself is left to
+ * `_rotation()`, for just the best template.
+ *
+ * \param t The template's vector.
+ * \param qx The query's Xs.
+ * \param qy The query's Ys.
+ * \param n The number of points.
+ * \param cos_m The cosine of the largest rotation, \f$m\f$.
+ * \param sin_m The sine of the largest rotation.
+ * \param ab Gets \f$a\f$ and \f$b\f$.
+ *
+ * \return The cosine.
+ */
+static inline double _similarity(const double* restrict t,
+                                 const double* restrict qx,
+                                 const double* restrict qy, size_t n,
+                                 double cos_m, double sin_m, double* ab) {
+  const double* tx = t;
+  const double* ty = t + n;
+  double a = 0, b = 0;
+  for (size_t i = 0; i < n; i++) {
+    a += tx[i] * qx[i] + ty[i] * qy[i];
+    b += ty[i] * qx[i] - tx[i] * qy[i];
+  }
+  ab[0] = a;
+  ab[1] = b;
+
+  const double r = sqrt(a * a + b * b);
+  return (a >= r * cos_m) ? r : a * cos_m + fabs(b) * sin_m;
+}
+
+/*! Computes the rotation `_similarity()` matched at.
+ *
+ * \param ab \f$a\f$ and \f$b\f$, from `_similarity()`.
+ * \param max_angle The largest rotation.
+ *
+ * \return The rotation, in radians.
+ */
+static inline double _rotation(const double* ab, double max_angle) {
+  const double angle = atan2(ab[1], ab[0]);
+  return (fabs(angle) <= max_angle) ? angle : copysign(max_angle, angle);
+}
+
+pt_context_t* pt_create() {
+  pt_context_t* self = calloc(1, sizeof(pt_context_t));
+  self->n = PT_DEFAULT_N;
+  self->max_angle = PT_DEFAULT_MAX_ANGLE;
+  return self;
+}
+
+void pt_add_template(pt_context_t* self, const stroke_t* strk,
+                     const char* name) {
+  EN("pt_add_template(self, strk<%ld>, \"%s\"\n", strk->num, name);
+  if (strk->num < 1) {
+    fprintf(stderr, "Error: pt_add_template called with an empty stroke\n");
+    EX("pt_add_template(self, strk<%ld>, \"%s\"\n", strk->num, name);
+    return;
+  }
+
+  stroke_soa_t* cloud = stroke_soa_create(self->n);
+  if (cloud == NULL) {
+    fprintf(stderr, "Error: could not allocate a template for n = %zd\n",
+            self->n);
+    EX("pt_add_template(self, strk<%ld>, \"%s\"\n", strk->num, name);
+    return;
+  }
+  _vectorize(strk, self->n, cloud);
+
+  if (self->num >= self->cap) {
+    self->cap += _PT_TMPL_INC;
+    self->tmpls = realloc(self->tmpls, self->cap * sizeof(pt_template_t));
+    self->vecs = realloc(self->vecs, self->cap * 2 * self->n * sizeof(double));
+    for (size_t i = 0; i < self->num; i++) {
+      self->tmpls[i].vec = self->vecs + i * 2 * self->n;
+    }
+  }
+
+  pt_template_t* next = &self->tmpls[self->num++];
+  next->vec = self->vecs + (self->num - 1) * 2 * self->n;
+  next->name = strndup(name, PT_MAX_TMPL_NAME_LEN);
+  memcpy(next->vec, cloud->x, self->n * sizeof(double));
+  memcpy(next->vec + self->n, cloud->y, self->n * sizeof(double));
+  stroke_soa_destroy(cloud);
+  EX("pt_add_template(self, strk<%ld>, \"%s\"\n", strk->num, name);
+}
+
+pt_workspace_t* pt_workspace_create(const pt_context_t* ctx) {
+  pt_workspace_t* self = calloc(1, sizeof(pt_workspace_t));
+  if (self && !_workspace_fit(self, ctx)) {
+    free(self);
+    return NULL;
+  }
+  return self;
+}
+
+void pt_workspace_destroy(pt_workspace_t* self) {
+  if (self->cloud) {
+    stroke_soa_destroy(self->cloud);
+  }
+  free(self);
+}
+
+pt_result_t pt_recognize_ws(const pt_context_t* self, pt_workspace_t* ws,
+                            const stroke_t* strk) {
+  pt_result_t result = { NULL, 0, 0, -1 };
+  if (strk->num < 1 || self->num < 1 || !_workspace_fit(ws, self)) {
+    return result;
+  }
+
+  const size_t n = self->n;
+  _vectorize(strk, n, ws->cloud);
+  const double* qx = ws->cloud->x;
+  const double* qy = ws->cloud->y;
+
+  // One closed-form match per template.  Highest cosine wins; ties go to the
+  // lowest index.
+  const double max_angle = MIN(self->max_angle, M_PI);
+  const double cos_m = cos(max_angle), sin_m = sin(max_angle);
+  double best = -DBL_MAX, ab[2], best_ab[2];
+  for (size_t i = 0; i < self->num; i++) {
+    const double s = _similarity(self->vecs + i * 2 * n, qx, qy, n, cos_m,
+                                 sin_m, ab);
+    if (s > best) {
+      best = s;
+      best_ab[0] = ab[0];
+      best_ab[1] = ab[1];
+      result.index = i;
+    }
+  }
+  if (result.index < 0) {
+    return result;
+  }
+
+  result.tmpl = &self->tmpls[result.index];
+  result.score = MIN(MAX(best, 0), 1);
+  result.angle = _rotation(best_ab, max_angle);
+  return result;
+}
+
+pt_result_t pt_recognize(const pt_context_t* self, const stroke_t* strk) {
+  pt_workspace_t ws;
+  bzero(&ws, sizeof(pt_workspace_t));
+  pt_result_t result = pt_recognize_ws(self, &ws, strk);
+  if (ws.cloud) {
+    stroke_soa_destroy(ws.cloud);
+  }
+  return result;
+}
+
+void pt_destroy(pt_context_t* self) {
+  debug("Freeing templates:\n");
+  for (size_t i = 0; i < self->num; i++) {
+    free((char*)self->tmpls[i].name);
+  }
+  free(self->tmpls);
+  free(self->vecs);
+
+  bzero(self, sizeof(pt_context_t));
+  free(self);
+}
+
+#undef _PT_TMPL_INC
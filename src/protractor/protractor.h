@@ -0,0 +1,170 @@
+/*! \file protractor.h
+ * Protractor, a closed-form template recognizer for unistrokes.  See
+ * \cite Protractor.
+ *
+ * Strokes are preprocessed just as by $P (see `dp_normalize()`): resampled,
+ * scaled and centered.  Each is then flattened into a unit vector of its `n`
+ * X-coordinates followed by its `n` Y-coordinates.  The angle between two such
+ * vectors, minimized over rotations of the stroke, has a closed form in two
+ * dot products, so matching a template is a single pass over its vector with
+ * no search.
+ *
+ * \addtogroup pt
+ * \{
+ */
+
+#ifndef __protractor_h__
+#define __protractor_h__
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "common/debug.h"
+#include "common/stroke.h"
+
+//! Maximum allowable name for templates.
+#define PT_MAX_TMPL_NAME_LEN 100
+
+//! Default value for `pt_context_t.n`.
+#define PT_DEFAULT_N 16
+
+//! Default value for `pt_context_t.max_angle`: any rotation.
+#define PT_DEFAULT_MAX_ANGLE M_PI
+
+//! A template -- used to recognize strokes.
+typedef struct {
+  double* vec;            //!< The unit vector; `n` Xs, then `n` Ys.
+  const char* name;       //!< Name of the template.
+} pt_template_t;
+
+/*! The main Protractor context.
+ *
+ * This structure holds the templates and their vectors, which lie one after
+ * another in `vecs`.  Do not alter `n` once templates are added, and DO NOT
+ * mess with `tmpls`, `vecs`, `num`, or `cap`.
+ */
+typedef struct {
+  size_t n;               //!< Number of points in a vector.
+  double max_angle;       //!< Largest rotation to match over, in radians.
+
+  pt_template_t* tmpls;   //!< Array of templates to use.
+  double* vecs;           //!< The templates' vectors.
+  size_t num;             //!< Number of templates.
+  size_t cap;             //!< Capacity of the `tmpls` and `vecs` arrays.
+} pt_context_t;
+
+/*! Scratch space for recognitions; see
+ * [\ref pt_workspace_create(const pt_context_t*)].
+ */
+typedef struct pt_workspace pt_workspace_t;
+
+//! A result of calling pt_recognize.
+typedef struct {
+  pt_template_t* tmpl;    //!< The template recognized, or \c NULL.
+  double score;           //!< Cosine of the angle to it, \f$\in [0,1]\f$.
+  double angle;           //!< Rotation (radians, counter-clockwise) onto it.
+  long index;             //!< Index of the template, or -1.
+} pt_result_t;
+
+
+/*! Creates a new Protractor context.
+ * \return The context.
+ */
+pt_context_t* pt_create();
+
+/*! Sets the number of points in a vector.  Must be greater than 0, and must be
+ * set before any templates are added.
+ *
+ * \param self The Protractor context.
+ * \param n The number of points.
+ *
+ * \return 0 on success, 1 o.w.
+ */
+static inline int pt_set_n(pt_context_t* self, size_t n) {
+  debug("pt_set_n(%zd)\n", n);
+  if (n <= 0 || self->num > 0) {
+    fprintf(stderr, "Error: pt_set_n called with n = %zd and %zd templates\n",
+            n, self->num);
+    return 1;
+  }
+  self->n = n;
+  return 0;
+}
+
+/*! Sets the largest rotation a stroke is matched over; 0 makes recognition
+ * sensitive to orientation, and `M_PI` makes it invariant to rotation.
+ *
+ * \param self The Protractor context.
+ * \param max_angle The angle, in radians, \f$\in [0,\pi]\f$.
+ */
+static inline void pt_set_max_angle(pt_context_t* self, double max_angle) {
+  debug("pt_set_max_angle(%.2f)\n", max_angle);
+  self->max_angle = max_angle;
+}
+
+/*! Adds a new template to the Protractor context.  The stroke is not
+ * modified.  Names are truncated to `PT_MAX_TMPL_NAME_LEN`.
+ *
+ * \param self The Protractor context.
+ * \param strk The stroke the template is based on.
+ * \param name The name of the template.
+ */
+void pt_add_template(pt_context_t* self, const stroke_t* strk,
+                     const char* name);
+
+/*! Creates a workspace for
+ * [\ref pt_recognize_ws(const pt_context_t*, pt_workspace_t*, const stroke_t*)]
+ * sized for the context's current `n`.
+ *
+ * \param ctx The Protractor context.
+ *
+ * \return The workspace, or \c NULL if it could not be allocated.
+ */
+pt_workspace_t* pt_workspace_create(const pt_context_t* ctx);
+
+/*! Destroys a workspace and frees all its memory.
+ *
+ * \param self The workspace.
+ */
+void pt_workspace_destroy(pt_workspace_t* self);
+
+/*! Recognizes a stroke: finds the template at the smallest angle to it.  Ties
+ * go to the template added first.
+ *
+ * The query's vector lives in `ws`, so once `ws` fits the context no memory is
+ * allocated.  `ws` is regrown if `self->n` changed.  A workspace may only be
+ * used by one recognition at a time; the context may be shared.
+ *
+ * \param self The Protractor context.
+ * \param ws The workspace.
+ * \param strk The stroke to recognize.
+ *
+ * \return The result; `tmpl` is \c NULL if there are no templates, the stroke
+ *   is empty, or `ws` could not be grown.
+ */
+pt_result_t pt_recognize_ws(const pt_context_t* self, pt_workspace_t* ws,
+                            const stroke_t* strk);
+
+/*! Recognizes a stroke: finds the template at the smallest angle to it.  Ties
+ * go to the template added first.  Allocates a workspace for the call; use
+ * [\ref pt_recognize_ws(const pt_context_t*, pt_workspace_t*, const stroke_t*)]
+ * to reuse one instead.
+ *
+ * \param self The Protractor context.
+ * \param strk The stroke to recognize.
+ *
+ * \return The result; `tmpl` is \c NULL if there are no templates, the stroke
+ *   is empty, or memory ran out.
+ */
+pt_result_t pt_recognize(const pt_context_t* self, const stroke_t* strk);
+
+/*! Destroys the Protractor context and frees all its memory.
+ *
+ * \param self The Protractor context to delete.
+ */
+void pt_destroy(pt_context_t* self);
+
+#endif  // __protractor_h__
+
+/*! \} */
@@ -0,0 +1,278 @@
+#include <check.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <values.h>
+
+#include "stroke.h"
+#include "srz.h"
+
+
+
+/*! Checks that two strokes hold the same points (to the precision of the text
+ * format).
+ *
+ * \param a A stroke.
+ * \param b Another stroke.
+ */
+static void _ck_strokes_eq(const stroke_t* a, const stroke_t* b) {
+  ck_assert_int_eq(a->num, b->num);
+  for (int i = 0; i < a->num; i++) {
+    ck_assert_double_eq(a->pts[i].x, b->pts[i].x);
+    ck_assert_double_eq(a->pts[i].y, b->pts[i].y);
+    ck_assert_int_eq(a->pts[i].t, b->pts[i].t);
+    ck_assert_int_eq(a->pts[i].i, b->pts[i].i);
+  }
+}
+
+/*! Writes a little-endian integer of `n` bytes.
+ *
+ * \param p The bytes to write to.
+ * \param v The integer.
+ * \param n The number of bytes.
+ */
+static void _put(unsigned char* p, uint32_t v, int n) {
+  for (int i = 0; i < n; i++) {
+    p[i] = v >> (8 * i);
+  }
+}
+
+/*! Builds an archive with one stored (uncompressed) entry holding `text`, so
+ * that tests can feed `srz_next()` text `srz_write()` would never produce.
+ *
+ * \param text The NUL-terminated text of the entry.
+ * \param len Gets the length of the archive.
+ *
+ * \return The archive; must be freed by the caller.
+ */
+static unsigned char* _stored_srz(const char* text, size_t* len) {
+  static const char name[] = "stroke-0-0.sr";
+  const uint32_t name_len = sizeof(name) - 1, size = strlen(text);
+  uint32_t crc = 0xffffffff;
+  for (uint32_t i = 0; i < size; i++) {
+    crc ^= (unsigned char)text[i];
+    for (int k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+  }
+  crc = ~crc;
+
+  const uint32_t cd_off = 30 + name_len + size;
+  *len = cd_off + 46 + name_len + 22;
+  unsigned char* data = calloc(*len, 1);
+  unsigned char* p = data;
+  _put(&p[0], 0x04034b50, 4);
+  _put(&p[14], crc, 4);
+  _put(&p[18], size, 4);
+  _put(&p[22], size, 4);
+  _put(&p[26], name_len, 2);
+  memcpy(&p[30], name, name_len);
+  memcpy(&p[30 + name_len], text, size);
+
+  p = &data[cd_off];
+  _put(&p[0], 0x02014b50, 4);
+  _put(&p[16], crc, 4);
+  _put(&p[20], size, 4);
+  _put(&p[24], size, 4);
+  _put(&p[28], name_len, 2);
+  memcpy(&p[46], name, name_len);
+
+  p += 46 + name_len;
+  _put(&p[0], 0x06054b50, 4);
+  _put(&p[8], 1, 2);
+  _put(&p[10], 1, 2);
+  _put(&p[12], 46 + name_len, 4);
+  _put(&p[16], cd_off, 4);
+  return data;
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// ------------------------------- Reading -------------------------------- //
+//////////////////////////////////////////////////////////////////////////////
+
+START_TEST(c_srz_read) {
+  srz_reader_t* srz = srz_open("data/circle.stroke.srz");
+  ck_assert(srz != NULL);
+  ck_assert_int_eq(srz->num, 1);
+
+  int canvas, index;
+  stroke_t* strk = srz_next(srz, &canvas, &index);
+  ck_assert(strk != NULL);
+  ck_assert_int_eq(canvas, 0);
+  ck_assert_int_eq(index, 0);
+
+  stroke_t* text = stroke_from_file("data/circle.stroke");
+  _ck_strokes_eq(strk, text);
+  stroke_destroy(text);
+  stroke_destroy(strk);
+
+  ck_assert(srz_next(srz, NULL, NULL) == NULL);
+  srz_rewind(srz);
+  strk = srz_next(srz, NULL, NULL);
+  ck_assert(strk != NULL);
+  stroke_destroy(strk);
+
+  srz_close(srz);
+} END_TEST
+
+START_TEST(c_srz_read_mem) {
+  int fd = open("data/circle.stroke.srz", O_RDONLY);
+  ck_assert(fd >= 0);
+  struct stat st;
+  fstat(fd, &st);
+  char* data = malloc(st.st_size);
+  ck_assert_int_eq(read(fd, data, st.st_size), st.st_size);
+  close(fd);
+
+  srz_reader_t* srz = srz_open_mem(data, st.st_size);
+  ck_assert(srz != NULL);
+  stroke_t* strk = srz_next(srz, NULL, NULL);
+  ck_assert(strk != NULL);
+  ck_assert_int_eq(strk->num, 100);
+  stroke_destroy(strk);
+  srz_close(srz);
+  free(data);
+} END_TEST
+
+START_TEST(c_srz_read_not_zip) {
+  ck_assert(srz_open("data/circle.stroke") == NULL);
+} END_TEST
+
+START_TEST(c_srz_read_corrupt) {
+  int fd = open("data/circle.stroke.srz", O_RDONLY);
+  ck_assert(fd >= 0);
+  struct stat st;
+  fstat(fd, &st);
+  char* data = malloc(st.st_size);
+  ck_assert_int_eq(read(fd, data, st.st_size), st.st_size);
+  close(fd);
+
+  // Damage the compressed stroke, but not the directory.
+  data[200] ^= 0xff;
+  srz_reader_t* srz = srz_open_mem(data, st.st_size);
+  ck_assert(srz != NULL);
+  ck_assert(!srz_error(srz));
+  ck_assert(srz_next(srz, NULL, NULL) == NULL);
+  ck_assert(srz_error(srz));
+
+  // The end of the archive is not an error.
+  srz_rewind(srz);
+  ck_assert(!srz_error(srz));
+  srz->next = srz->num;
+  ck_assert(srz_next(srz, NULL, NULL) == NULL);
+  ck_assert(!srz_error(srz));
+  srz_close(srz);
+  free(data);
+} END_TEST
+
+START_TEST(c_srz_read_bad_count) {
+  // A count the text can't hold must not be used to size the stroke.
+  ck_assert(stroke_from_text("2000000000\n1,2,3\n") == NULL);
+  ck_assert(stroke_from_text("2\n1,2,3\n") == NULL);
+  stroke_t* strk = stroke_from_text("1\n1,2,3\n");
+  ck_assert(strk != NULL);
+  ck_assert_int_eq(strk->num, 1);
+  stroke_destroy(strk);
+
+  size_t len;
+  unsigned char* data = _stored_srz("1\n1,2,3\n", &len);
+  srz_reader_t* srz = srz_open_mem(data, len);
+  ck_assert(srz != NULL);
+  strk = srz_next(srz, NULL, NULL);
+  ck_assert(strk != NULL);
+  ck_assert_int_eq(strk->num, 1);
+  stroke_destroy(strk);
+  srz_close(srz);
+  free(data);
+
+  data = _stored_srz("2000000000\n1,2,3\n", &len);
+  srz = srz_open_mem(data, len);
+  ck_assert(srz != NULL);
+  ck_assert(srz_next(srz, NULL, NULL) == NULL);
+  ck_assert(srz_error(srz));
+  srz_close(srz);
+  free(data);
+} END_TEST
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// ------------------------------- Writing -------------------------------- //
+//////////////////////////////////////////////////////////////////////////////
+
+START_TEST(c_srz_write_read) {
+  char fname[] = "/tmp/check_srz_XXXXXX";
+  close(mkstemp(fname));
+
+  stroke_t* strks[3] = {
+    stroke_create(0), stroke_create(0), stroke_from_file("data/circle.stroke")
+  };
+  stroke_add_timed(strks[0], 1, 2, 3);
+  for (int i = 0; i < 40; i++) {
+    stroke_add_timed(strks[1], i, 2 * i, 100 + i);
+  }
+
+  srz_writer_t* w = srz_writer_create(fname);
+  ck_assert(w != NULL);
+  ck_assert(srz_write(w, strks[0], 0, 0));
+  ck_assert(srz_write(w, strks[1], 0, 1));
+  ck_assert(srz_write(w, strks[2], 1, 0));
+  ck_assert(srz_writer_close(w));
+
+  srz_reader_t* r = srz_open(fname);
+  ck_assert(r != NULL);
+  ck_assert_int_eq(r->num, 3);
+  const int canvases[] = { 0, 0, 1 }, indices[] = { 0, 1, 0 };
+  for (int i = 0; i < 3; i++) {
+    int canvas, index;
+    stroke_t* strk = srz_next(r, &canvas, &index);
+    ck_assert(strk != NULL);
+    ck_assert_int_eq(canvas, canvases[i]);
+    ck_assert_int_eq(index, indices[i]);
+    _ck_strokes_eq(strk, strks[i]);
+    stroke_destroy(strk);
+    stroke_destroy(strks[i]);
+  }
+  ck_assert(srz_next(r, NULL, NULL) == NULL);
+  srz_close(r);
+  unlink(fname);
+} END_TEST
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// ----------------------------- Entry Point ------------------------------ //
+//////////////////////////////////////////////////////////////////////////////
+
+static inline Suite* srz_suite() {
+  Suite* suite = suite_create("srz");
+
+  TCase* tc = tcase_create("read");
+  tcase_add_test(tc, c_srz_read);
+  tcase_add_test(tc, c_srz_read_mem);
+  tcase_add_test(tc, c_srz_read_not_zip);
+  tcase_add_test(tc, c_srz_read_corrupt);
+  tcase_add_test(tc, c_srz_read_bad_count);
+  suite_add_tcase(suite, tc);
+
+  tc = tcase_create("write");
+  tcase_add_test(tc, c_srz_write_read);
+  suite_add_tcase(suite, tc);
+
+  return suite;
+}
+
+int main() {
+  int number_failed = 0;
+  Suite* suite = srz_suite();
+  SRunner* runner = srunner_create(suite);
+
+  srunner_run_all(runner, CK_VERBOSE);
+  number_failed = srunner_ntests_failed(runner);
+  srunner_free(runner);
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,8 +1,11 @@
 #include <check.h>
+#include <stdint.h>
+#include <unistd.h>
 #include <values.h>
 
 #include "point.h"
 #include "stroke.h"
+#include "stroke_bin.h"
 #include "geom.h"
 
 
@@ -149,11 +152,77 @@ START_TEST(c_stroke_clone_compare_destroy) {
 //////////////////////////////////////////////////////////////////////////////
 
 START_TEST(c_stroke_from_file) {
-  stroke_t* stroke = stroke_from_file("data/circle.stroke.srz");
+  stroke_t* stroke = stroke_from_file("data/circle.stroke");
   ck_assert(stroke != NULL);
+  ck_assert_int_eq(stroke->num, 100);
+  ck_assert_int_eq(stroke->size, 100);
+  ck_assert_double_eq(stroke->pts[0].x, 209);
+  ck_assert_double_eq(stroke->pts[0].y, 133);
+  ck_assert_int_eq(stroke->pts[99].i, 99);
   stroke_destroy(stroke);
 } END_TEST
 
+START_TEST(c_stroke_from_file_not_text) {
+  // A zip archive, not a text stroke: must be rejected, not read as empty.
+  ck_assert(stroke_from_file("data/circle.stroke.srz") == NULL);
+} END_TEST
+
+START_TEST(c_stroke_from_file_short) {
+  char fname[] = "/tmp/check_stroke_XXXXXX";
+  int fd = mkstemp(fname);
+  ck_assert(fd >= 0);
+  FILE* fp = fdopen(fd, "w");
+  fprintf(fp, "3\n1.0,2.0,3\n4.0,5.0,6\n");
+  fclose(fp);
+
+  ck_assert(stroke_from_file(fname) == NULL);
+  unlink(fname);
+} END_TEST
+
+START_TEST(c_stroke_from_file_huge_count) {
+  char fname[] = "/tmp/check_stroke_XXXXXX";
+  int fd = mkstemp(fname);
+  ck_assert(fd >= 0);
+  FILE* fp = fdopen(fd, "w");
+  fprintf(fp, "2000000000\n1.0,2.0,3\n");
+  fclose(fp);
+
+  ck_assert(stroke_from_file(fname) == NULL);
+  unlink(fname);
+} END_TEST
+
+START_TEST(c_stroke_bin_round_trip) {
+  char text[] = "/tmp/check_stroke_XXXXXX";
+  char bin[] = "/tmp/check_stroke_bin_XXXXXX";
+  close(mkstemp(text));
+  close(mkstemp(bin));
+
+  stroke_t* strk = stroke_create_point2dts(5, points);
+  ck_assert(stroke_save(strk, text));
+  ck_assert(stroke_text_to_bin(text, bin));
+
+  stroke_map_t* map = stroke_map(bin);
+  ck_assert(map != NULL);
+  ck_assert_int_eq(map->strk.num, 5);
+  ck_assert(map->strk.mem == NULL);
+  ck_assert_int_eq((uintptr_t)map->strk.x % STROKE_SOA_ALIGN, 0);
+  ck_assert_int_eq((uintptr_t)map->strk.t % STROKE_SOA_ALIGN, 0);
+  for (int i = 0; i < 5; i++) {
+    ck_assert_double_eq(map->strk.x[i], points[i].x);
+    ck_assert_double_eq(map->strk.y[i], points[i].y);
+    ck_assert_int_eq(map->strk.t[i], points[i].t);
+  }
+
+  stroke_unmap(map);
+  stroke_destroy(strk);
+  unlink(text);
+  unlink(bin);
+} END_TEST
+
+START_TEST(c_stroke_map_rejects_text) {
+  ck_assert(stroke_map("data/circle.stroke") == NULL);
+} END_TEST
+
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -177,6 +246,11 @@ static inline Suite* stroke_suite() {
   tcase_add_test(tc, c_stroke_create);
   tcase_add_test(tc, c_stroke_create_point2dts);
   tcase_add_test(tc, c_stroke_from_file);
+  tcase_add_test(tc, c_stroke_from_file_not_text);
+  tcase_add_test(tc, c_stroke_from_file_short);
+  tcase_add_test(tc, c_stroke_from_file_huge_count);
+  tcase_add_test(tc, c_stroke_bin_round_trip);
+  tcase_add_test(tc, c_stroke_map_rejects_text);
   tcase_add_test(tc, c_stroke_create_destroy_empty);
   tcase_add_test(tc, c_stroke_clone_compare_destroy);
   suite_add_tcase(suite, tc);
@@ -0,0 +1,216 @@
+#include <check.h>
+#include <stdint.h>
+#include <values.h>
+
+#include "point.h"
+#include "stroke.h"
+#include "stroke_soa.h"
+#include "geom.h"
+
+
+
+static const point2dt_t points[5] = {
+  { .x =  4.0, .y =   8.0, .t =       12},
+  { .x =  2.0, .y =   4.0, .t =        8},
+  { .x = 12.0, .y =  13.0, .t =       14},
+  { .x =  0.0, .y =  14.0, .t =       28},
+  { .x = 99.0, .y = 180.0, .t = LONG_MAX}
+};
+
+//! Checks that `p` is aligned for a SoA column.
+#define ck_assert_aligned(p) \
+  ck_assert_int_eq((uintptr_t)(p) % STROKE_SOA_ALIGN, 0)
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// ------------------------- Creation & Conversion ------------------------ //
+//////////////////////////////////////////////////////////////////////////////
+
+START_TEST(c_stroke_soa_create) {
+  stroke_soa_t* soa = stroke_soa_create(13);
+  ck_assert(soa != NULL);
+  ck_assert_int_eq(soa->num, 0);
+  ck_assert_int_ge(soa->size, 13);
+  ck_assert_int_eq(soa->size % STROKE_SOA_PAD, 0);
+  ck_assert_aligned(soa->x);
+  ck_assert_aligned(soa->y);
+  ck_assert_aligned(soa->t);
+  for (int i = 0; i < soa->size; i++) {
+    ck_assert_double_eq(soa->x[i], 0);
+    ck_assert_double_eq(soa->y[i], 0);
+    ck_assert_int_eq(soa->t[i], 0);
+  }
+  stroke_soa_destroy(soa);
+} END_TEST
+
+START_TEST(c_stroke_soa_round_trip) {
+  stroke_t* strk = stroke_create_point2dts(5, points);
+  stroke_soa_t* soa = stroke_soa_from_stroke(strk);
+  ck_assert_int_eq(soa->num, 5);
+  for (int i = 0; i < 5; i++) {
+    ck_assert_double_eq(soa->x[i], points[i].x);
+    ck_assert_double_eq(soa->y[i], points[i].y);
+    ck_assert_int_eq(soa->t[i], points[i].t);
+  }
+
+  stroke_t* back = stroke_soa_to_stroke(soa);
+  ck_assert_int_eq(back->num, strk->num);
+  ck_assert_int_eq(0, memcmp(back->pts, strk->pts, 5 * sizeof(point_t)));
+
+  stroke_destroy(back);
+  stroke_soa_destroy(soa);
+  stroke_destroy(strk);
+} END_TEST
+
+START_TEST(c_stroke_soa_add_grows) {
+  stroke_soa_t* soa = stroke_soa_create(1);
+  for (int i = 0; i < 100; i++) {
+    stroke_soa_add_timed(soa, i, -i, i * 10);
+  }
+  ck_assert_int_eq(soa->num, 100);
+  ck_assert_int_ge(soa->size, 100);
+  ck_assert_aligned(soa->y);
+  for (int i = 0; i < 100; i++) {
+    ck_assert_double_eq(soa->x[i], i);
+    ck_assert_double_eq(soa->y[i], -i);
+    ck_assert_int_eq(soa->t[i], i * 10);
+  }
+  stroke_soa_destroy(soa);
+} END_TEST
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// ------------------------------ Primitives ------------------------------ //
+//////////////////////////////////////////////////////////////////////////////
+
+START_TEST(c_stroke_soa_path_length) {
+  stroke_t* strk = stroke_create_point2dts(5, points);
+  stroke_soa_t* soa = stroke_soa_from_stroke(strk);
+
+  double expected = 0;
+  for (int i = 1; i < strk->num; i++) {
+    expected += point2d_distance(&strk->pts[i-1].p2d, &strk->pts[i].p2d);
+  }
+  ck_assert(fabs(expected - stroke_soa_path_length(soa)) < GEOM_ERR);
+
+  stroke_soa_destroy(soa);
+  stroke_destroy(strk);
+} END_TEST
+
+START_TEST(c_stroke_soa_bbox_centroid) {
+  stroke_t* strk = stroke_create_point2dts(5, points);
+  stroke_soa_t* soa = stroke_soa_from_stroke(strk);
+
+  point2d_t min, max, c;
+  stroke_soa_bbox(soa, &min, &max);
+  ck_assert_double_eq(min.x, 0);
+  ck_assert_double_eq(min.y, 4);
+  ck_assert_double_eq(max.x, 99);
+  ck_assert_double_eq(max.y, 180);
+
+  stroke_soa_centroid(soa, &c);
+  ck_assert(fabs(c.x - 117.0 / 5) < GEOM_ERR);
+  ck_assert(fabs(c.y - 219.0 / 5) < GEOM_ERR);
+
+  stroke_soa_destroy(soa);
+  stroke_destroy(strk);
+} END_TEST
+
+START_TEST(c_stroke_soa_translate_scale) {
+  stroke_t* strk = stroke_create_point2dts(5, points);
+  stroke_soa_t* soa = stroke_soa_from_stroke(strk);
+
+  stroke_soa_translate(soa, -4, -8);
+  stroke_soa_scale(soa, 0.5);
+  for (int i = 0; i < 5; i++) {
+    ck_assert_double_eq(soa->x[i], (points[i].x - 4) * 0.5);
+    ck_assert_double_eq(soa->y[i], (points[i].y - 8) * 0.5);
+  }
+
+  stroke_soa_destroy(soa);
+  stroke_destroy(strk);
+} END_TEST
+
+START_TEST(c_stroke_soa_sq_dists) {
+  stroke_t* strk = stroke_create_point2dts(5, points);
+  stroke_soa_t* soa = stroke_soa_from_stroke(strk);
+
+  double d[5];
+  stroke_soa_sq_dists(soa, points[2].x, points[2].y, d);
+  for (int i = 0; i < 5; i++) {
+    const double e = point2d_distance(&strk->pts[2].p2d, &strk->pts[i].p2d);
+    ck_assert(fabs(d[i] - e * e) < GEOM_ERR);
+    ck_assert(fabs(stroke_soa_distance(soa, 2, soa, i) - e) < GEOM_ERR);
+  }
+
+  stroke_soa_destroy(soa);
+  stroke_destroy(strk);
+} END_TEST
+
+START_TEST(c_stroke_soa_sq_dist_matrix) {
+  // Big enough to span several tiles, with a partial tile at the edges.
+  const long m = STROKE_SOA_TILE + 3, n = 2 * STROKE_SOA_TILE + 5;
+  stroke_soa_t* a = stroke_soa_create(m);
+  stroke_soa_t* b = stroke_soa_create(n);
+  for (long i = 0; i < m; i++) {
+    stroke_soa_add_timed(a, i * 0.5, -i * 1.25, i);
+  }
+  for (long j = 0; j < n; j++) {
+    stroke_soa_add_timed(b, j % 7, j * 0.75, j);
+  }
+
+  double* d = malloc(m * n * sizeof(double));
+  double* d_t = malloc(m * n * sizeof(double));
+  stroke_soa_sq_dist_matrix(a, b, d, d_t);
+  for (long i = 0; i < m; i++) {
+    for (long j = 0; j < n; j++) {
+      const double e = stroke_soa_sq_distance(a, i, b, j);
+      ck_assert(d[i * n + j] == e);
+      ck_assert(d_t[j * m + i] == e);
+    }
+  }
+
+  free(d_t);
+  free(d);
+  stroke_soa_destroy(b);
+  stroke_soa_destroy(a);
+} END_TEST
+
+
+//////////////////////////////////////////////////////////////////////////////
+// ----------------------------- Entry Point ------------------------------ //
+//////////////////////////////////////////////////////////////////////////////
+
+static inline Suite* stroke_soa_suite() {
+  Suite* suite = suite_create("stroke_soa");
+
+  TCase* tc = tcase_create("create");
+  tcase_add_test(tc, c_stroke_soa_create);
+  tcase_add_test(tc, c_stroke_soa_round_trip);
+  tcase_add_test(tc, c_stroke_soa_add_grows);
+  suite_add_tcase(suite, tc);
+
+  tc = tcase_create("primitives");
+  tcase_add_test(tc, c_stroke_soa_path_length);
+  tcase_add_test(tc, c_stroke_soa_bbox_centroid);
+  tcase_add_test(tc, c_stroke_soa_translate_scale);
+  tcase_add_test(tc, c_stroke_soa_sq_dists);
+  tcase_add_test(tc, c_stroke_soa_sq_dist_matrix);
+  suite_add_tcase(suite, tc);
+
+  return suite;
+}
+
+int main() {
+  int number_failed = 0;
+  Suite* suite = stroke_soa_suite();
+  SRunner* runner = srunner_create(suite);
+
+  srunner_run_all(runner, CK_VERBOSE);
+  number_failed = srunner_ntests_failed(runner);
+  srunner_free(runner);
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
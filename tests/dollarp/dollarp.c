@@ -1,6 +1,9 @@
 #include <check.h>
 #include <errno.h>
 #include <libgen.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <values.h>
 
@@ -8,6 +11,7 @@
 #include "common/debug.h"
 #include "common/geom.h"
 #include "common/mock_stroke.h"
+#include "common/srz.h"
 #include "dollarp/dollarp.h"
 
 
@@ -36,7 +40,16 @@ stroke_t* load_stroke(const char* fname) {
     fprintf(stderr, "Error: %zd extra chars not written.\n", act - sz);
     return NULL;
   }
-  return stroke_from_file(path);
+
+  // Each fixture is an .srz archive holding a single stroke.
+  srz_reader_t* srz = srz_open(path);
+  free(path);
+  if (srz == NULL) {
+    return NULL;
+  }
+  stroke_t* strk = srz_next(srz, NULL, NULL);
+  srz_close(srz);
+  return strk;
 
 //  stroke_t* strk = NULL;
 //  char* full = realpath(path, buf);
@@ -134,6 +147,23 @@ START_TEST(c_dp_set_n_too_high_3) {
   dp_destroy(ctx);
 } END_TEST
 
+START_TEST(c_dp_set_n_with_templates) {
+  dp_context_t* ctx = dp_create();
+  ck_assert_int_eq(dp_set_n(ctx, 0), 1);
+
+  // The clouds already made would no longer fit.
+  stroke_t* strk = stroke_create(3);
+  stroke_add_timed(strk, 0, 0, 0);
+  stroke_add_timed(strk, 1, 2, 1);
+  stroke_add_timed(strk, 3, 1, 2);
+  dp_add_template(ctx, strk, "v");
+  ck_assert_int_eq(dp_set_n(ctx, 16), 1);
+  ck_assert_int_eq(ctx->n, DP_DEFAULT_N);
+  ck_assert(dp_recognize(ctx, strk).index == 0);
+  stroke_destroy(strk);
+  dp_destroy(ctx);
+} END_TEST
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -174,6 +204,93 @@ START_TEST(c_dp_add_small_template) {
   dp_destroy(ctx);
 } END_TEST
 
+START_TEST(c_dp_add_srz) {
+  dp_context_t* ctx = dp_create();
+  ck_assert_int_eq(dp_add_srz(ctx, "data/rect1.stroke.srz", "rectangle"), 1);
+  ck_assert_int_eq(dp_add_srz(ctx, "data/rect2.stroke.srz", "rectangle"), 1);
+  ck_assert_int_eq(ctx->num, 2);
+  ck_assert_str_eq(ctx->tmpls[1].name, "rectangle");
+  ck_assert_int_eq(dp_add_srz(ctx, "data/no-such-file.srz", "nothing"), -1);
+  ck_assert_int_eq(ctx->num, 2);
+
+  // An archive whose second entry is damaged fails, after adding the first.
+  char fname[] = "/tmp/check_dp_srz_XXXXXX";
+  close(mkstemp(fname));
+  srz_writer_t* w = srz_writer_create(fname);
+  for (int i = 0; i < 2; i++) {
+    stroke_t* strk = stroke_create(50);
+    for (int j = 0; j < 50; j++) {
+      stroke_add_timed(strk, j, (i + 1) * j % 17, j);
+    }
+    ck_assert(srz_write(w, strk, 0, i));
+    stroke_destroy(strk);
+  }
+  ck_assert(srz_writer_close(w));
+  FILE* fp = fopen(fname, "r+b");
+  unsigned char buf[4096];
+  const size_t len = fread(buf, 1, sizeof(buf), fp);
+  size_t second = 0;
+  for (size_t i = 1; i + 4 < len && !second; i++) {
+    if (buf[i] == 'P' && buf[i+1] == 'K' && buf[i+2] == 3 && buf[i+3] == 4) {
+      second = i;
+    }
+  }
+  ck_assert(second > 0);
+  buf[second + 60] ^= 0xff;
+  fseek(fp, 0, SEEK_SET);
+  fwrite(buf, 1, len, fp);
+  fclose(fp);
+  ck_assert_int_eq(dp_add_srz(ctx, fname, "shape"), -1);
+  ck_assert_int_eq(ctx->num, 3);
+
+  // An empty entry is read but not added, so it isn't counted.
+  w = srz_writer_create(fname);
+  stroke_t* empty = stroke_create(0);
+  ck_assert(srz_write(w, empty, 0, 0));
+  stroke_destroy(empty);
+  stroke_t* strk = stroke_create(50);
+  for (int j = 0; j < 50; j++) {
+    stroke_add_timed(strk, j, j * j % 13, j);
+  }
+  ck_assert(srz_write(w, strk, 0, 1));
+  stroke_destroy(strk);
+  ck_assert(srz_writer_close(w));
+  ck_assert_int_eq(dp_add_srz(ctx, fname, "shape"), 1);
+  ck_assert_int_eq(ctx->num, 4);
+  unlink(fname);
+  dp_destroy(ctx);
+} END_TEST
+
+START_TEST(c_dp_resample_exact_n) {
+  // A long, irregularly sampled spiral; rounding must not cost any points.
+  stroke_t* strk = stroke_create(5000);
+  for (int i = 0; i < 5000; i++) {
+    const double r = 1 + i / 50.0 + (i % 7) * 0.01;
+    stroke_add_timed(strk, r * cos(i / 40.0), r * sin(i / 40.0), i);
+  }
+  stroke_t* orig = stroke_clone(strk);
+
+  const size_t ns[] = { 2, 7, 32, 1000 };
+  for (int i = 0; i < 4; i++) {
+    dp_context_t* ctx = dp_create();
+    dp_set_n(ctx, ns[i]);
+    dp_add_template(ctx, strk, "spiral");
+    ck_assert_int_eq(ctx->tmpls[0].strk->num, ns[i]);
+    dp_destroy(ctx);
+  }
+
+  // The input must be left untouched.
+  ck_assert_int_eq(strk->num, orig->num);
+  for (int i = 0; i < strk->num; i++) {
+    ck_assert(strk->pts[i].x == orig->pts[i].x);
+    ck_assert(strk->pts[i].y == orig->pts[i].y);
+    ck_assert_int_eq(strk->pts[i].t, orig->pts[i].t);
+  }
+
+  stroke_destroy(orig);
+  stroke_destroy(strk);
+} END_TEST
+
 START_TEST(c_dp_add_many_large_templates) {
   dp_context_t* ctx = dp_create();
 
@@ -284,6 +401,866 @@ START_TEST(c_dp_full_rect_test) {
 } END_TEST
 
 
+/*! Makes a synthetic stroke: a spiral-ish curve whose shape depends on `k`.
+ *
+ * \param k Selects the shape.
+ *
+ * \return The stroke.
+ */
+static stroke_t* _mock_shape(int k) {
+  stroke_t* strk = stroke_create(64);
+  for (int i = 0; i < 64; i++) {
+    const double a = i * (0.05 + 0.01 * (k % 11));
+    const double r = 10 + (k % 5) * i * 0.2 + ((i * k) % 3);
+    stroke_add_timed(strk, r * cos(a * (1 + k % 3)), r * sin(a), i);
+  }
+  return strk;
+}
+
+/*! Adds `num` templates of `_mock_shape()`s, named "shape 0", "shape 1", and
+ * so on.  Template `k` is `_mock_shape(k % period)`.
+ *
+ * \param ctx The $P context.
+ * \param num The number of templates to add.
+ * \param period The number of distinct shapes.
+ */
+static void _add_mock_shapes(dp_context_t* ctx, int num, int period) {
+  char name[16];
+  for (int k = 0; k < num; k++) {
+    stroke_t* strk = _mock_shape(k % period);
+    snprintf(name, sizeof(name), "shape %d", k);
+    dp_add_template(ctx, strk, name);
+    stroke_destroy(strk);
+  }
+}
+
+START_TEST(c_dp_prune_same_result) {
+  dp_context_t* ctx = dp_create();
+  ck_assert_int_eq(ctx->prune, DP_DEFAULT_PRUNE);
+
+  _add_mock_shapes(ctx, 60, 60);
+  for (int k = 0; k < 60; k++) {
+    ck_assert(ctx->tmpls[k].lut == NULL);
+  }
+
+  const int masks[] = {
+    DP_PRUNE_ABANDON, DP_PRUNE_BOUND, DP_PRUNE_LUT,
+    DP_PRUNE_ABANDON | DP_PRUNE_BOUND | DP_PRUNE_LUT
+  };
+  size_t pruned = 0, abandoned = 0;
+  for (int k = 0; k < 60; k += 7) {
+    stroke_t* strk = _mock_shape(k + 1000);
+
+    dp_set_prune(ctx, 0);
+    dp_result_t full = dp_recognize(ctx, strk);
+    ck_assert(full.tmpl != NULL);
+    ck_assert_int_eq(full.pruned, 0);
+    ck_assert_int_eq(full.abandoned, 0);
+
+    for (int m = 0; m < 4; m++) {
+      dp_set_prune(ctx, masks[m]);
+      dp_result_t res = dp_recognize(ctx, strk);
+      ck_assert(res.tmpl == full.tmpl);
+      ck_assert(res.score == full.score);
+      pruned += res.pruned;
+      abandoned += res.abandoned;
+    }
+    stroke_destroy(strk);
+  }
+  ck_assert(ctx->tmpls[0].lut != NULL);
+  ck_assert(pruned > 0);
+  ck_assert(abandoned > 0);
+
+  dp_destroy(ctx);
+} END_TEST
+
+
+START_TEST(c_dp_threads_same_result) {
+  dp_context_t* ctx = dp_create();
+  ck_assert_int_eq(ctx->threads, DP_DEFAULT_THREADS);
+  ck_assert_int_eq(dp_set_threads(ctx, 0), 1);
+
+  // Enough templates for several blocks, with every shape added twice so that
+  // ties have to be broken by index.
+  _add_mock_shapes(ctx, 400, 200);
+
+  const int masks[] = {
+    0, DP_PRUNE_ABANDON | DP_PRUNE_BOUND | DP_PRUNE_LUT
+  };
+  for (int m = 0; m < 2; m++) {
+    dp_set_prune(ctx, masks[m]);
+    // (The shapes repeat every 165.)
+    for (int k = 0; k < 165; k += 37) {
+      stroke_t* strk = _mock_shape(k);
+
+      dp_set_threads(ctx, 1);
+      dp_result_t serial = dp_recognize(ctx, strk);
+      ck_assert(serial.tmpl == &ctx->tmpls[k]);
+
+      const size_t threads[] = { 2, 3, 8 };
+      for (int t = 0; t < 3; t++) {
+        ck_assert_int_eq(dp_set_threads(ctx, threads[t]), 0);
+        dp_result_t res = dp_recognize(ctx, strk);
+        ck_assert(res.tmpl == serial.tmpl);
+        ck_assert(res.score == serial.score);
+      }
+      stroke_destroy(strk);
+    }
+  }
+
+  dp_destroy(ctx);
+} END_TEST
+
+
+START_TEST(c_dp_recognize_ws) {
+  dp_context_t* ctx = dp_create();
+  _add_mock_shapes(ctx, 100, 100);
+
+  dp_workspace_t* ws = dp_workspace_create(ctx);
+  for (int k = 0; k < 100; k += 9) {
+    stroke_t* strk = _mock_shape(k + 500);
+    stroke_t* orig = stroke_clone(strk);
+
+    // Change the settings the workspace was sized for part way through.
+    if (k == 45) {
+      dp_set_prune(ctx, DP_DEFAULT_PRUNE | DP_PRUNE_LUT);
+      dp_set_threads(ctx, 3);
+    }
+
+    dp_result_t res = dp_recognize_ws(ctx, ws, strk);
+    dp_result_t expected = dp_recognize(ctx, strk);
+    ck_assert(res.tmpl != NULL);
+    ck_assert(res.tmpl == expected.tmpl);
+    ck_assert(res.score == expected.score);
+
+    ck_assert_int_eq(strk->num, orig->num);
+    for (int i = 0; i < strk->num; i++) {
+      ck_assert(strk->pts[i].x == orig->pts[i].x);
+      ck_assert(strk->pts[i].y == orig->pts[i].y);
+    }
+    stroke_destroy(orig);
+    stroke_destroy(strk);
+  }
+
+  dp_workspace_destroy(ws);
+  dp_destroy(ctx);
+} END_TEST
+
+
+
+START_TEST(c_dp_cascade) {
+  dp_context_t* ctx = dp_create();
+  _add_mock_shapes(ctx, 150, 150);
+  stroke_t* strks[10];
+  for (int k = 0; k < 10; k++) {
+    strks[k] = _mock_shape(k * 13 + 7);
+  }
+
+  // Shortlisting every template is the same as not having a cascade.
+  dp_set_coarse_n(ctx, 8);
+  ck_assert_int_eq(ctx->tmpls[0].coarse->num, 8);
+  dp_set_shortlist(ctx, ctx->num);
+  ck_assert(dp_cascade_recall(ctx, (const stroke_t* const*)strks, 10) == 1);
+
+  // A template identical to the query always makes the shortlist, whatever
+  // the number of threads.
+  dp_set_coarse_n(ctx, 16);
+  dp_set_shortlist(ctx, 4);
+  for (int k = 0; k < 10; k++) {
+    for (size_t t = 1; t <= 3; t++) {
+      dp_set_threads(ctx, t);
+      dp_result_t res = dp_recognize(ctx, strks[k]);
+      ck_assert(res.tmpl == &ctx->tmpls[k * 13 + 7]);
+    }
+  }
+
+  // Templates added with the cascade on get coarse clouds too.
+  dp_add_template(ctx, strks[0], "added");
+  ck_assert_int_eq(ctx->tmpls[ctx->num - 1].coarse->num, 16);
+
+  dp_set_coarse_n(ctx, 0);
+  ck_assert(ctx->tmpls[0].coarse == NULL);
+
+  for (int k = 0; k < 10; k++) {
+    stroke_destroy(strks[k]);
+  }
+  dp_destroy(ctx);
+} END_TEST
+
+START_TEST(c_dp_fixed_n) {
+  // 16 and 64 have kernels of their own; 15 and 17 use the generic ones.
+  const size_t ns[] = { 15, 16, 17, 64 };
+  for (int z = 0; z < 4; z++) {
+    dp_context_t* ctx = dp_create();
+    dp_set_n(ctx, ns[z]);
+    stroke_t* strks[40];
+    for (int k = 0; k < 40; k++) {
+      strks[k] = _mock_shape(k);
+      dp_add_template(ctx, strks[k], "shape");
+    }
+
+    for (int k = 0; k < 40; k++) {
+      dp_set_prune(ctx, 0);
+      dp_result_t res = dp_recognize(ctx, strks[k]);
+      ck_assert(res.tmpl == &ctx->tmpls[k]);
+      ck_assert(res.score == 1);
+
+      stroke_t* query = _mock_shape(k + 400);
+      dp_result_t full = dp_recognize(ctx, query);
+      dp_set_prune(ctx, DP_DEFAULT_PRUNE);
+      dp_result_t pruned = dp_recognize(ctx, query);
+      ck_assert(pruned.tmpl == full.tmpl);
+      ck_assert(pruned.score == full.score);
+      stroke_destroy(query);
+    }
+
+    for (int k = 0; k < 40; k++) {
+      stroke_destroy(strks[k]);
+    }
+    dp_destroy(ctx);
+  }
+} END_TEST
+
+START_TEST(c_dp_topk) {
+  dp_context_t* ctx = dp_create();
+  char name[16];
+  for (int k = 0; k < 150; k++) {
+    stroke_t* strk = _mock_shape(k);
+    snprintf(name, sizeof(name), "class %d", k % 7);
+    dp_add_template(ctx, strk, name);
+    stroke_destroy(strk);
+  }
+  dp_workspace_t* ws = dp_workspace_create(ctx);
+  dp_result_t all[150], top[10];
+
+  for (int q = 0; q < 5; q++) {
+    stroke_t* strk = _mock_shape(q * 31 + 400);
+
+    // Every template, in order, with nothing cut short.
+    dp_set_prune(ctx, 0);
+    dp_set_threads(ctx, 1);
+    ck_assert_int_eq(dp_recognize_topk(ctx, ws, strk, 200, 0, all), 150);
+    for (int i = 1; i < 150; i++) {
+      ck_assert(all[i - 1].score >= all[i].score);
+    }
+
+    dp_set_prune(ctx, DP_DEFAULT_PRUNE | DP_PRUNE_LUT);
+    for (size_t t = 1; t <= 3; t += 2) {
+      dp_set_threads(ctx, t);
+      ck_assert_int_eq(dp_recognize_topk(ctx, ws, strk, 10, 0, top), 10);
+      for (int i = 0; i < 10; i++) {
+        ck_assert(top[i].tmpl == all[i].tmpl);
+        ck_assert(top[i].score == all[i].score);
+      }
+      dp_result_t best = dp_recognize(ctx, strk);
+      ck_assert(top[0].tmpl == best.tmpl);
+
+      // The best of each of the 7 names.
+      ck_assert_int_eq(dp_recognize_topk(ctx, ws, strk, 10, 1, top), 7);
+      int found = 0;
+      for (int i = 0; i < 150 && found < 7; i++) {
+        int seen = 0;
+        for (int j = 0; j < found; j++) {
+          seen |= !strcmp(top[j].tmpl->name, all[i].tmpl->name);
+        }
+        if (!seen) {
+          ck_assert(top[found].tmpl == all[i].tmpl);
+          ck_assert(top[found].score == all[i].score);
+          found++;
+        }
+      }
+    }
+
+    // Shortlisting every template is the same as not having a cascade.
+    dp_set_coarse_n(ctx, 8);
+    dp_set_shortlist(ctx, ctx->num);
+    ck_assert_int_eq(dp_recognize_topk(ctx, ws, strk, 10, 0, top), 10);
+    for (int i = 0; i < 10; i++) {
+      ck_assert(top[i].tmpl == all[i].tmpl);
+    }
+    dp_set_coarse_n(ctx, 0);
+    stroke_destroy(strk);
+  }
+
+  dp_workspace_destroy(ws);
+  dp_destroy(ctx);
+} END_TEST
+
+START_TEST(c_dp_multistroke) {
+  dp_context_t* ctx = dp_create();
+  stroke_t* strks[40];
+  for (int k = 0; k < 40; k++) {
+    // Three strokes, as views into one.
+    strks[k] = _mock_shape(k);
+    stroke_t views[3] = {
+      { 20, 20, strks[k]->pts }, { 1, 1, strks[k]->pts + 20 },
+      { 43, 43, strks[k]->pts + 21 }
+    };
+    const stroke_t* parts[3] = { &views[0], &views[1], &views[2] };
+    dp_add_template_strokes(ctx, parts, 3, "shape");
+  }
+
+  const dp_template_t* tmpl = &ctx->tmpls[0];
+  ck_assert(tmpl->ids != NULL);
+  ck_assert_int_eq(tmpl->ids[0], 0);
+  ck_assert_int_eq(tmpl->ids[ctx->n - 1], 2);
+  for (int i = 1; i < ctx->n; i++) {
+    ck_assert(tmpl->ids[i - 1] <= tmpl->ids[i]);
+  }
+
+  // The gap between the first and second stroke is not part of the path, so
+  // this is not the same as one stroke.
+  dp_add_template(ctx, strks[0], "shape");
+  ck_assert(ctx->tmpls[ctx->num - 1].ids == NULL);
+  ck_assert(memcmp(ctx->tmpls[ctx->num - 1].strk->x, tmpl->strk->x,
+                   ctx->n * sizeof(double)));
+
+  // One stroke in an array is the same as one stroke.
+  const stroke_t* one[1] = { strks[0] };
+  dp_add_template_strokes(ctx, one, 1, "shape");
+  ck_assert(ctx->tmpls[ctx->num - 1].ids == NULL);
+  ck_assert(!memcmp(ctx->tmpls[ctx->num - 1].strk->x,
+                    ctx->tmpls[ctx->num - 2].strk->x,
+                    ctx->n * sizeof(double)));
+
+  // Empty strokes are skipped.
+  for (int k = 0; k < 40; k++) {
+    stroke_t empty = { 0, 0, NULL };
+    stroke_t views[3] = {
+      { 20, 20, strks[k]->pts }, { 1, 1, strks[k]->pts + 20 },
+      { 43, 43, strks[k]->pts + 21 }
+    };
+    const stroke_t* parts[5] = {
+      &empty, &views[0], &views[1], &empty, &views[2]
+    };
+    dp_result_t res = dp_recognize_strokes(ctx, parts, 5);
+    ck_assert(res.tmpl == &ctx->tmpls[k]);
+    ck_assert(res.score == 1);
+  }
+  const stroke_t* none[1] = { strks[0] };
+  ck_assert(dp_recognize_strokes(ctx, none, 0).tmpl == NULL);
+
+  for (int k = 0; k < 40; k++) {
+    stroke_destroy(strks[k]);
+  }
+  dp_destroy(ctx);
+} END_TEST
+
+START_TEST(c_dp_session) {
+  dp_context_t* ctx = dp_create();
+  for (int k = 0; k < 100; k++) {
+    stroke_t* strk = _mock_shape(k);
+    dp_add_template(ctx, strk, "shape");
+    stroke_destroy(strk);
+  }
+
+  dp_session_t* session = dp_session_begin(ctx);
+  ck_assert(dp_session_peek(session).tmpl == NULL);
+
+  // Every peek is what recognizing the points so far would give.
+  stroke_t* strk = _mock_shape(37);
+  stroke_t* prefix = stroke_create(strk->num);
+  for (int i = 0; i < strk->num; i++) {
+    const point_t* pt = &strk->pts[i];
+    dp_session_add_point(session, pt->x, pt->y, pt->t);
+    stroke_add_point2dt(prefix, &pt->p2dt);
+    if (i % 5 == 0 || i == strk->num - 1) {
+      dp_result_t peek = dp_session_peek(session);
+      dp_result_t expected = dp_recognize(ctx, prefix);
+      ck_assert(peek.tmpl == expected.tmpl);
+      ck_assert(peek.score == expected.score);
+    }
+  }
+  ck_assert(dp_session_peek(session).tmpl == &ctx->tmpls[37]);
+
+  stroke_destroy(prefix);
+  stroke_destroy(strk);
+  dp_session_end(session);
+  dp_destroy(ctx);
+} END_TEST
+
+START_TEST(c_dp_precision) {
+  dp_context_t* ctx = dp_create();
+  _add_mock_shapes(ctx, 150, 150);
+  stroke_t* strks[10];
+  for (int k = 0; k < 10; k++) {
+    strks[k] = _mock_shape(k * 13 + 7);
+  }
+  dp_result_t exact[10];
+  for (int k = 0; k < 10; k++) {
+    exact[k] = dp_recognize(ctx, strks[k]);
+  }
+
+  const dp_precision_e precisions[] = {
+    DP_PRECISION_FLOAT, DP_PRECISION_INT16
+  };
+  const double tolerance[] = { 1e-6, 1e-3 };
+  for (int p = 0; p < 2; p++) {
+    dp_set_precision(ctx, precisions[p]);
+    ck_assert(ctx->tmpls[0].packed != NULL);
+    ck_assert(dp_precision_recall(ctx, (const stroke_t* const*)strks, 10) == 1);
+
+    // Scores stay within the packing's error, and pruning (even with LUTs of
+    // the unpacked clouds) still doesn't change the result.
+    for (int k = 0; k < 10; k++) {
+      dp_set_prune(ctx, 0);
+      dp_result_t full = dp_recognize(ctx, strks[k]);
+      ck_assert(full.tmpl == exact[k].tmpl);
+      ck_assert(fabs(full.score - exact[k].score) < tolerance[p]);
+
+      dp_set_prune(ctx, DP_DEFAULT_PRUNE | DP_PRUNE_LUT);
+      dp_result_t pruned = dp_recognize(ctx, strks[k]);
+      ck_assert(pruned.tmpl == full.tmpl);
+      ck_assert(pruned.score == full.score);
+    }
+  }
+
+  dp_add_template(ctx, strks[0], "added");
+  ck_assert(ctx->tmpls[ctx->num - 1].packed != NULL);
+  dp_set_precision(ctx, DP_PRECISION_DOUBLE);
+  ck_assert(ctx->tmpls[0].packed == NULL);
+
+  for (int k = 0; k < 10; k++) {
+    stroke_destroy(strks[k]);
+  }
+  dp_destroy(ctx);
+} END_TEST
+
+/*! Makes a slightly jittered copy of `_mock_shape(k)`.
+ *
+ * \param k Selects the shape.
+ * \param j Selects the jitter.
+ *
+ * \return The stroke.
+ */
+static stroke_t* _jittered_shape(int k, int j) {
+  stroke_t* strk = _mock_shape(k);
+  for (int i = 0; i < strk->num; i++) {
+    strk->pts[i].x += 0.05 * sin(i * (j + 1));
+    strk->pts[i].y += 0.05 * cos(i * (j + 2));
+  }
+  return strk;
+}
+
+START_TEST(c_dp_grid) {
+  const size_t ns[] = { 128, 200 };
+  for (int z = 0; z < 2; z++) {
+    dp_context_t* ctx = dp_create();
+    dp_set_n(ctx, ns[z]);
+    dp_set_grid_n(ctx, 0);
+    char name[16];
+    for (int k = 0; k < 60; k++) {
+      stroke_t* strk = _mock_shape(k);
+      snprintf(name, sizeof(name), "class %d", k % 5);
+      dp_add_template(ctx, strk, name);
+      stroke_destroy(strk);
+    }
+    ck_assert(ctx->tmpls[0].grid == NULL);
+    dp_workspace_t* ws = dp_workspace_create(ctx);
+    dp_result_t top[2][8];
+
+    // The grids find the very points the matrix does, so nothing changes.
+    for (int q = 0; q < 6; q++) {
+      stroke_t* strk = _mock_shape(q * 17 + 400);
+      for (int prune = 0; prune < 2; prune++) {
+        dp_set_prune(ctx, prune ? DP_DEFAULT_PRUNE | DP_PRUNE_LUT : 0);
+        for (size_t t = 1; t <= 3; t += 2) {
+          dp_set_threads(ctx, t);
+          dp_set_grid_n(ctx, 0);
+          dp_result_t matrix = dp_recognize(ctx, strk);
+          dp_recognize_topk(ctx, ws, strk, 8, 0, top[0]);
+          dp_set_grid_n(ctx, 64);
+          ck_assert(ctx->tmpls[59].grid != NULL);
+          dp_result_t grid = dp_recognize(ctx, strk);
+          dp_recognize_topk(ctx, ws, strk, 8, 0, top[1]);
+          ck_assert(grid.tmpl == matrix.tmpl);
+          ck_assert(grid.score == matrix.score);
+          ck_assert_int_eq(grid.index, matrix.index);
+          for (int i = 0; i < 8; i++) {
+            ck_assert_int_eq(top[1][i].index, top[0][i].index);
+            ck_assert(top[1][i].score == top[0][i].score);
+          }
+        }
+      }
+      stroke_destroy(strk);
+    }
+
+    dp_workspace_destroy(ws);
+    dp_destroy(ctx);
+  }
+} END_TEST
+
+START_TEST(c_dp_no_extent) {
+  // Strokes of one point, or of one point repeated, have no size to scale
+  // away.  Both the generic path (n = 20) and the grid path (n = 200) must
+  // still match them.
+  const size_t ns[] = { 20, 200 };
+  for (int z = 0; z < 2; z++) {
+    dp_context_t* ctx = dp_create();
+    dp_set_n(ctx, ns[z]);
+    for (int k = 0; k < 5; k++) {
+      stroke_t* strk = _mock_shape(k);
+      dp_add_template(ctx, strk, "shape");
+      stroke_destroy(strk);
+    }
+    stroke_t* dot = stroke_create(1);
+    stroke_add_timed(dot, 3, 4, 0);
+    dp_add_template(ctx, dot, "dot");
+
+    stroke_t* same = stroke_create(3);
+    for (int i = 0; i < 3; i++) {
+      stroke_add_timed(same, -7, 2, i);
+    }
+    stroke_t* queries[2] = { dot, same };
+    for (int q = 0; q < 2; q++) {
+      dp_result_t res = dp_recognize(ctx, queries[q]);
+      ck_assert_int_eq(res.index, 5);
+      ck_assert_str_eq(res.tmpl->name, "dot");
+      ck_assert(!isnan(res.score));
+    }
+    stroke_destroy(same);
+    stroke_destroy(dot);
+    dp_destroy(ctx);
+  }
+} END_TEST
+
+//! A thread recognizing with a shared context until told to stop.
+typedef struct {
+  dp_shared_t* shared;    //!< The shared context.
+  int stop;               //!< Set to stop; atomic.
+  size_t runs;            //!< Recognitions run.
+  size_t bad;             //!< Results not consistent with their snapshot.
+} _shared_reader_t;
+
+/*! Recognizes with snapshots of a shared context, checking each result
+ * against its snapshot, until told to stop.  Recognizes at least once, even if
+ * it is only scheduled after the stop.
+ *
+ * \param arg The `_shared_reader_t`.
+ *
+ * \return \c NULL.
+ */
+static void* _shared_read(void* arg) {
+  _shared_reader_t* r = arg;
+  dp_workspace_t* ws = NULL;
+  do {
+    int ticket;
+    const dp_context_t* snap = dp_shared_acquire(r->shared, &ticket);
+    if (ws == NULL) {
+      ws = dp_workspace_create(snap);
+    }
+    stroke_t* strk = _mock_shape(r->runs % 50 + 400);
+    dp_result_t res = dp_recognize_ws(snap, ws, strk);
+    const size_t num = snap->num;
+    r->bad += res.index < 0 || res.index >= num ||
+      res.tmpl != &snap->tmpls[res.index] ||
+      strcmp(res.tmpl->name, dp_label_name(snap, res.label)) ||
+      res.tmpl->strk->num != snap->n;
+    dp_shared_release(r->shared, ticket);
+    stroke_destroy(strk);
+    r->runs++;
+  } while (!__atomic_load_n(&r->stop, __ATOMIC_RELAXED));
+  dp_workspace_destroy(ws);
+  return NULL;
+}
+
+START_TEST(c_dp_shared) {
+  dp_context_t* ctx = dp_create();
+  for (int k = 0; k < 10; k++) {
+    stroke_t* strk = _mock_shape(k);
+    dp_add_template(ctx, strk, "base");
+    stroke_destroy(strk);
+  }
+  dp_shared_t* shared = dp_shared_create(ctx);
+
+  // A held snapshot does not change under its reader.
+  int ticket;
+  const dp_context_t* snap = dp_shared_acquire(shared, &ticket);
+  ck_assert(snap == ctx);
+  dp_shared_release(shared, ticket);
+  stroke_t* strk = _mock_shape(10);
+  dp_shared_add_template(shared, strk, "user");
+  snap = dp_shared_acquire(shared, &ticket);
+  ck_assert(snap != ctx);
+  ck_assert_int_eq(snap->num, 11);
+  ck_assert_str_eq(snap->tmpls[10].name, "user");
+  ck_assert(dp_recognize(snap, strk).index == 10);
+  dp_shared_release(shared, ticket);
+  ck_assert_int_eq(dp_shared_remove(shared, "user"), 1);
+  ck_assert_int_eq(dp_shared_remove(shared, "nobody"), 0);
+  snap = dp_shared_acquire(shared, &ticket);
+  ck_assert_int_eq(snap->num, 10);
+  dp_shared_release(shared, ticket);
+  stroke_destroy(strk);
+
+  // Readers keep recognizing while templates come and go.
+  _shared_reader_t readers[3];
+  pthread_t threads[3];
+  for (int i = 0; i < 3; i++) {
+    readers[i] = (_shared_reader_t){ shared, 0, 0, 0 };
+    pthread_create(&threads[i], NULL, _shared_read, &readers[i]);
+  }
+  char name[16];
+  size_t removed = 0;
+  for (int k = 0; k < 120; k++) {
+    strk = _mock_shape(k + 100);
+    snprintf(name, sizeof(name), "user %d", k % 4);
+    dp_shared_add_template(shared, strk, name);
+    stroke_destroy(strk);
+    if (k % 30 == 29) {
+      removed += dp_shared_remove(shared, name);
+    }
+  }
+  for (int i = 0; i < 3; i++) {
+    __atomic_store_n(&readers[i].stop, 1, __ATOMIC_RELAXED);
+    pthread_join(threads[i], NULL);
+    ck_assert(readers[i].runs > 0);
+    ck_assert_int_eq(readers[i].bad, 0);
+  }
+
+  snap = dp_shared_acquire(shared, &ticket);
+  ck_assert(removed > 0);
+  ck_assert_int_eq(snap->num, 10 + 120 - removed);
+  dp_shared_release(shared, ticket);
+  dp_shared_destroy(shared);
+} END_TEST
+
+START_TEST(c_dp_compact) {
+  dp_context_t* ctxs[2] = { dp_create(), dp_create() };
+  char name[16];
+  for (int c = 0; c < 2; c++) {
+    dp_set_threads(ctxs[c], 1 + 2 * c);
+    for (int j = 0; j < 8; j++) {
+      for (int k = 0; k < 6; k++) {
+        stroke_t* strk = _jittered_shape(k, j);
+        snprintf(name, sizeof(name), "class %d", k);
+        dp_add_template(ctxs[c], strk, name);
+        stroke_destroy(strk);
+      }
+    }
+  }
+  ck_assert_int_eq(ctxs[0]->num, 48);
+
+  stroke_t* held[12];
+  const char* names[12];
+  char held_names[12][16];
+  for (int i = 0; i < 12; i++) {
+    held[i] = _jittered_shape(i % 6, 100 + i);
+    snprintf(held_names[i], sizeof(held_names[i]), "class %d", i % 6);
+    names[i] = held_names[i];
+  }
+  const double before = dp_accuracy(ctxs[0], (const stroke_t* const*)held,
+                                    names, 12);
+
+  // Every copy of a shape collapses into one medoid, whatever the threads.
+  ck_assert_int_eq(dp_compact(ctxs[0], 0.7), 42);
+  ck_assert_int_eq(dp_compact(ctxs[1], 0.7), 42);
+  for (int i = 0; i < 6; i++) {
+    for (int j = 0; j < i; j++) {
+      ck_assert(strcmp(ctxs[0]->tmpls[i].name, ctxs[0]->tmpls[j].name));
+    }
+    ck_assert_str_eq(ctxs[0]->tmpls[i].name, ctxs[1]->tmpls[i].name);
+    const stroke_soa_t* a = ctxs[0]->tmpls[i].strk;
+    const stroke_soa_t* b = ctxs[1]->tmpls[i].strk;
+    ck_assert(!memcmp(a->x, b->x, a->num * sizeof(double)));
+    ck_assert(!memcmp(a->y, b->y, a->num * sizeof(double)));
+  }
+  ck_assert(dp_accuracy(ctxs[0], (const stroke_t* const*)held, names, 12)
+            >= before);
+  ck_assert_int_eq(dp_compact(ctxs[0], 0.7), 0);
+
+  // Online, duplicates of a name are not added, but other names are.
+  dp_set_dedup(ctxs[0], 0.7);
+  stroke_t* strk = _jittered_shape(0, 50);
+  dp_add_template(ctxs[0], strk, "class 0");
+  ck_assert_int_eq(ctxs[0]->num, 6);
+  dp_add_template(ctxs[0], strk, "other");
+  ck_assert_int_eq(ctxs[0]->num, 7);
+  stroke_destroy(strk);
+
+  for (int i = 0; i < 12; i++) {
+    stroke_destroy(held[i]);
+  }
+  dp_destroy(ctxs[0]);
+  dp_destroy(ctxs[1]);
+} END_TEST
+
+START_TEST(c_dp_labels) {
+  dp_context_t* ctx = dp_create();
+  ck_assert_int_eq(dp_label(ctx, "class 0"), -1);
+  ck_assert(dp_label_name(ctx, 0) == NULL);
+
+  // Enough names to grow the table a few times.
+  char name[16];
+  for (int k = 0; k < 600; k++) {
+    stroke_t* strk = _mock_shape(k);
+    snprintf(name, sizeof(name), "class %d", k % 300);
+    dp_add_template(ctx, strk, name);
+    stroke_destroy(strk);
+  }
+  ck_assert_int_eq(ctx->labels.num, 300);
+  for (int k = 0; k < 600; k++) {
+    snprintf(name, sizeof(name), "class %d", k % 300);
+    ck_assert_int_eq(ctx->tmpls[k].label, k % 300);
+    ck_assert(ctx->tmpls[k].name == dp_label_name(ctx, k % 300));
+    ck_assert_int_eq(dp_label(ctx, name), k % 300);
+  }
+  ck_assert_int_eq(dp_label(ctx, "class 300"), -1);
+
+  // Names are the same if they are up to `DP_MAX_TMPL_NAME_LEN`.
+  char long_name[DP_MAX_TMPL_NAME_LEN + 2];
+  memset(long_name, 'x', DP_MAX_TMPL_NAME_LEN + 1);
+  long_name[DP_MAX_TMPL_NAME_LEN + 1] = '\0';
+  stroke_t* strk = _mock_shape(7);
+  dp_add_template(ctx, strk, long_name);
+  long_name[DP_MAX_TMPL_NAME_LEN] = '\0';
+  ck_assert_int_eq(dp_label(ctx, long_name), 300);
+  ck_assert_int_eq(strlen(dp_label_name(ctx, 300)), DP_MAX_TMPL_NAME_LEN);
+
+  dp_result_t res = dp_recognize(ctx, strk);
+  ck_assert_int_eq(res.index, 7);
+  ck_assert_int_eq(res.label, 7);
+  ck_assert(res.tmpl == &ctx->tmpls[res.index]);
+  stroke_destroy(strk);
+
+  stroke_t* empty = stroke_create(0);
+  res = dp_recognize(ctx, empty);
+  ck_assert_int_eq(res.index, -1);
+  ck_assert_int_eq(res.label, -1);
+  stroke_destroy(empty);
+  dp_destroy(ctx);
+} END_TEST
+
+START_TEST(c_dp_recognize_batch) {
+  dp_context_t* ctx = dp_create();
+  _add_mock_shapes(ctx, 150, 150);
+
+  // Not a multiple of any tile size, and with an empty stroke in the middle.
+  const int count = 21;
+  stroke_t* strks[count];
+  for (int k = 0; k < count; k++) {
+    strks[k] = (k == 10) ? stroke_create(0) : _mock_shape(k * 11 + 400);
+  }
+  dp_result_t results[count];
+
+  for (int m = 0; m < 3; m++) {
+    dp_set_prune(ctx, m == 1 ? DP_DEFAULT_PRUNE | DP_PRUNE_LUT : 0);
+    dp_set_coarse_n(ctx, m == 2 ? 8 : 0);
+    for (size_t t = 1; t <= 3; t += 2) {
+      dp_set_threads(ctx, t);
+      dp_recognize_batch(ctx, (const stroke_t* const*)strks, count, results);
+      for (int k = 0; k < count; k++) {
+        dp_result_t expected = dp_recognize(ctx, strks[k]);
+        ck_assert(results[k].tmpl == expected.tmpl);
+        ck_assert_int_eq(results[k].index, expected.index);
+        ck_assert_int_eq(results[k].label, expected.label);
+        ck_assert(results[k].score == expected.score);
+      }
+    }
+  }
+  ck_assert(results[10].tmpl == NULL);
+
+  for (int k = 0; k < count; k++) {
+    stroke_destroy(strks[k]);
+  }
+  dp_destroy(ctx);
+} END_TEST
+
+
+////////////////////////////////////////////////////////////////////////////////
+// --------------------------- Template Databases --------------------------- //
+////////////////////////////////////////////////////////////////////////////////
+
+/*! Saves a context's templates, opens them again, and checks that the opened
+ * context recognizes strokes just like the original.
+ *
+ * \param ctx The context.
+ */
+void _ck_db_round_trip(dp_context_t* ctx) {
+  char fname[] = "/tmp/check_dollarp_XXXXXX";
+  close(mkstemp(fname));
+  ck_assert(dp_save_templates(ctx, fname));
+
+  dp_context_t* db = dp_open_templates(fname);
+  ck_assert(db != NULL);
+  ck_assert_int_eq(db->n, ctx->n);
+  ck_assert(db->epsilon == ctx->epsilon);
+  ck_assert(db->step == ctx->step);
+  ck_assert_int_eq(db->num, ctx->num);
+  for (int i = 0; i < ctx->num; i++) {
+    ck_assert_str_eq(db->tmpls[i].name, ctx->tmpls[i].name);
+    ck_assert_int_eq(db->tmpls[i].label, ctx->tmpls[i].label);
+    ck_assert_int_eq((uintptr_t)db->tmpls[i].strk->x % STROKE_SOA_ALIGN, 0);
+    ck_assert(!memcmp(db->tmpls[i].strk->x, ctx->tmpls[i].strk->x,
+                      ctx->n * sizeof(double)));
+    ck_assert(!memcmp(db->tmpls[i].strk->y, ctx->tmpls[i].strk->y,
+                      ctx->n * sizeof(double)));
+    ck_assert((db->tmpls[i].lut != NULL) == (ctx->tmpls[i].lut != NULL));
+  }
+
+  for (int k = 0; k < 40; k += 7) {
+    stroke_t* strk = _mock_shape(k + 300);
+    dp_result_t a = dp_recognize(ctx, strk);
+    dp_result_t b = dp_recognize(db, strk);
+    ck_assert_int_eq(b.tmpl - db->tmpls, a.tmpl - ctx->tmpls);
+    ck_assert_int_eq(b.label, a.label);
+    ck_assert(a.score == b.score);
+    stroke_destroy(strk);
+  }
+
+  // Templates can still be added to an opened database.
+  stroke_t* strk = _mock_shape(1);
+  dp_add_template(db, strk, "added");
+  ck_assert_int_eq(db->num, ctx->num + 1);
+  dp_result_t res = dp_recognize(db, strk);
+  ck_assert(res.tmpl == &db->tmpls[1]);
+  stroke_destroy(strk);
+
+  dp_destroy(db);
+  unlink(fname);
+}
+
+START_TEST(c_dp_db_round_trip) {
+  dp_context_t* ctx = dp_create();
+  dp_set_n(ctx, 20);
+  dp_set_epsilon(ctx, 0.3);
+  char name[16];
+  for (int k = 0; k < 40; k++) {
+    stroke_t* strk = _mock_shape(k);
+    snprintf(name, sizeof(name), k % 2 ? "odd %d" : "even shape %d", k);
+    dp_add_template(ctx, strk, name);
+    stroke_destroy(strk);
+  }
+
+  _ck_db_round_trip(ctx);
+  dp_set_prune(ctx, DP_DEFAULT_PRUNE | DP_PRUNE_LUT);
+  _ck_db_round_trip(ctx);
+
+  dp_destroy(ctx);
+} END_TEST
+
+START_TEST(c_dp_db_rejects) {
+  ck_assert(dp_open_templates("data/no-such-file.db") == NULL);
+  ck_assert(dp_open_templates("data/circle.stroke.srz") == NULL);
+
+  // A truncated database.
+  dp_context_t* ctx = dp_create();
+  stroke_t* strk = _mock_shape(0);
+  dp_add_template(ctx, strk, "shape");
+  stroke_destroy(strk);
+
+  char fname[] = "/tmp/check_dollarp_XXXXXX";
+  close(mkstemp(fname));
+  ck_assert(dp_save_templates(ctx, fname));
+  struct stat st;
+  stat(fname, &st);
+  ck_assert(truncate(fname, st.st_size - 1) == 0);
+  ck_assert(dp_open_templates(fname) == NULL);
+
+  unlink(fname);
+  dp_destroy(ctx);
+} END_TEST
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // ------------------------------ Entry Point ------------------------------- //
@@ -302,15 +1279,38 @@ static inline Suite* dp_suite() {
   tcase_add_test(tc, c_dp_set_n_too_high_1);
   tcase_add_test(tc, c_dp_set_n_too_high_2);
   tcase_add_test(tc, c_dp_set_n_too_high_3);
+  tcase_add_test(tc, c_dp_set_n_with_templates);
   suite_add_tcase(suite, tc);
 
   tc = tcase_create("templates");
   tcase_add_test(tc, c_dp_add_small_template);
   tcase_add_test(tc, c_dp_add_many_large_templates);
+  tcase_add_test(tc, c_dp_add_srz);
+  tcase_add_test(tc, c_dp_resample_exact_n);
+  suite_add_tcase(suite, tc);
+
+  tc = tcase_create("databases");
+  tcase_add_test(tc, c_dp_db_round_trip);
+  tcase_add_test(tc, c_dp_db_rejects);
   suite_add_tcase(suite, tc);
 
   tc = tcase_create("running");
   tcase_add_test(tc, c_dp_full_rect_test);
+  tcase_add_test(tc, c_dp_prune_same_result);
+  tcase_add_test(tc, c_dp_threads_same_result);
+  tcase_add_test(tc, c_dp_recognize_ws);
+  tcase_add_test(tc, c_dp_cascade);
+  tcase_add_test(tc, c_dp_recognize_batch);
+  tcase_add_test(tc, c_dp_topk);
+  tcase_add_test(tc, c_dp_multistroke);
+  tcase_add_test(tc, c_dp_session);
+  tcase_add_test(tc, c_dp_precision);
+  tcase_add_test(tc, c_dp_fixed_n);
+  tcase_add_test(tc, c_dp_compact);
+  tcase_add_test(tc, c_dp_labels);
+  tcase_add_test(tc, c_dp_grid);
+  tcase_add_test(tc, c_dp_no_extent);
+  tcase_add_test(tc, c_dp_shared);
   suite_add_tcase(suite, tc);
 
   return suite;
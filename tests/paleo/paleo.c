@@ -1,5 +1,10 @@
+#include <config.h>
+
 #include <check.h>
+#include <math.h>
+#include <stdint.h>
 
+#include "common/util.h"
 #include "paleo.h"
 
 
@@ -54,46 +59,337 @@ START_TEST(c_pal_types_gt_0) {
 // ----------------------------- Simple Checks ------------------------------ //
 ////////////////////////////////////////////////////////////////////////////////
 
-START_TEST(c_pal_init_deinit)
+START_TEST(c_pal_create_destroy)
 { // Just making sure things don't break out of the gate.
-  pal_init();
-  ck_assert(PAL_TYPE_UNRUN == pal_last_type());
-  pal_deinit();
+  pal_context_t* pal = pal_create();
+  ck_assert(pal != NULL);
+  ck_assert(PAL_TYPE_UNRUN == pal_last_type(pal));
+  pal_destroy(pal);
 }
 END_TEST
 
 START_TEST(c_pal_recognize_empty)
 {
-  pal_init();
+  pal_context_t* pal = pal_create();
 
   stroke_t stroke = { 0, 0, NULL };
-  ck_assert(PAL_TYPE_INDET == pal_recognize(&stroke));
+  ck_assert(PAL_TYPE_INDET == pal_recognize(pal, &stroke));
 
-  pal_deinit();
+  pal_destroy(pal);
 }
 END_TEST
 
 START_TEST(c_pal_recognize_1_point)
 {
-  pal_init();
+  pal_context_t* pal = pal_create();
 
   stroke_t stroke = { 1, 1, calloc(1, sizeof(point_t)) };
-  ck_assert(PAL_TYPE_INDET == pal_recognize(&stroke));
-  ck_assert(PAL_TYPE_INDET == pal_last_type());
+  ck_assert(PAL_TYPE_INDET == pal_recognize(pal, &stroke));
+  ck_assert(PAL_TYPE_INDET == pal_last_type(pal));
 
-  pal_deinit();
+  pal_destroy(pal);
 }
 END_TEST
 
 START_TEST(c_pal_recognize_40_points)
 {
-  pal_init();
+  pal_context_t* pal = pal_create();
 
   stroke_t stroke = { 40, 40, calloc(40, sizeof(point_t)) };
-  ck_assert(PAL_TYPE_INDET == pal_recognize(&stroke));
-  ck_assert(PAL_TYPE_INDET == pal_last_type());
+  ck_assert(PAL_TYPE_INDET == pal_recognize(pal, &stroke));
+  ck_assert(PAL_TYPE_INDET == pal_last_type(pal));
+
+  pal_destroy(pal);
+}
+END_TEST
+
+START_TEST(c_pal_contexts_independent)
+{ // Recognizing with one context must not touch another.
+  pal_context_t* a = pal_create();
+  pal_context_t* b = pal_create();
+
+  stroke_t stroke = { 0, 0, NULL };
+  ck_assert(PAL_TYPE_INDET == pal_recognize(a, &stroke));
+  ck_assert(PAL_TYPE_UNRUN == pal_last_type(b));
+  ck_assert(pal_last_stroke(a) != pal_last_stroke(b));
+  ck_assert_int_eq(pal_last_stroke(b)->num_pts, 0);
+
+  pal_destroy(a);
+  pal_destroy(b);
+}
+END_TEST
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ----------------------------- Preprocessing ------------------------------ //
+////////////////////////////////////////////////////////////////////////////////
+
+/*! Makes a test stroke: a circle, a spiral, a hooked line, a zigzag, or a
+ * stroke of a few points, with some repeated points and times thrown in.
+ *
+ * \param k Which stroke.
+ *
+ * \return The stroke.
+ */
+static stroke_t* _test_stroke(int k) {
+  stroke_t* strk = stroke_create(0);
+  const int num = (k % 5 == 4) ? 1 + k / 5 : 60 + 20 * k;
+  long t = 1000;
+  for (int i = 0; i < num; i++) {
+    const double u = i / (double)num;
+    double x, y;
+    switch (k % 5) {
+      case 0:
+        x = 80 * cos(2 * M_PI * u);
+        y = 80 * sin(2 * M_PI * u);
+        break;
+
+      case 1:
+        x = (10 + 90 * u) * cos(5 * M_PI * u);
+        y = (10 + 90 * u) * sin(5 * M_PI * u);
+        break;
+
+      case 2:
+        x = 200 * u;
+        y = (u < 0.1) ? 300 * (0.1 - u) : 0;
+        y -= (u > 0.9) ? 200 * (u - 0.9) : 0;
+        break;
+
+      case 3:
+        x = 150 * u;
+        y = (i / 10 % 2) ? 40 * (i % 10) : 40 * (10 - i % 10);
+        break;
+
+      default:
+        x = 7 * i;
+        y = 3 * i * i;
+        break;
+    }
+    t += (i % 11 == 5) ? 0 : 10;
+    stroke_add_timed(strk, round(x), round(y), t);
+    if (i % 7 == 3) {
+      stroke_add_timed(strk, round(x), round(y), t + 5);
+    }
+  }
+  return strk;
+}
+
+/*! Preprocesses a stroke the way Paleo did before preprocessing was fused
+ * into two passes: one pass per feature, measuring every segment afresh.
+ * Corners are left out; they are found the same way by both.
+ *
+ * \param strk The stroke.
+ * \param ps Gets the Paleo stroke; free `ps->pts` and each column.
+ */
+static void _ref_process(const stroke_t* strk, pal_stroke_t* ps) {
+  bzero(ps, sizeof(pal_stroke_t));
+  ps->pts = calloc(strk->num, sizeof(pal_point_t));
+  double* dir = ps->dir = calloc(strk->num, sizeof(double));
+  double* dy_dx = ps->dy_dx = calloc(strk->num, sizeof(double));
+  double* sp = ps->sp = calloc(strk->num, sizeof(double));
+  double* curv = ps->curv = calloc(strk->num, sizeof(double));
+  for (int i = 0; i < strk->num; i++) {
+    if (i > 0) {
+      pal_point_t* last = &ps->pts[ps->num_pts-1];
+      if (last->p.t == strk->pts[i].t ||
+          (last->p.x == strk->pts[i].x && last->p.y == strk->pts[i].y)) {
+        continue;
+      }
+    }
+    memcpy(&ps->pts[ps->num_pts++], &strk->pts[i], sizeof(point_t));
+  }
+  pal_point_t* pts = ps->pts;
+  const int num = ps->num_pts;
+
+  for (int i = 0; i < num - 1; i++) {
+    dir[i] = atan((pts[i+1].y - pts[i].y) / (pts[i+1].x - pts[i].x));
+    if (i > 0) {
+      while (dir[i] - dir[i-1] > M_PIl) { dir[i] += 2 * M_PIl; }
+      while (dir[i] - dir[i-1] < -M_PIl) { dir[i] -= 2 * M_PIl; }
+    }
+    sp[i] = point2d_distance(&pts[i].p2d, &pts[i+1].p2d) /
+      abs(pts[i+1].t - pts[i].t);
+  }
+
+  for (int i = 1; i < num - 1; i++) {
+    const int k = (3 < i) ? ((3 < num - i - 1) ? 3 : num - i - 1) : i;
+    double diff_sum = 0, len = 0;
+    for (int j = i; j < MIN(i + 2 * k + 1, num - 1); j++) {
+      len += point2d_distance(&pts[j].p2d, &pts[j+1].p2d);
+      double diff = dir[j+1] - dir[j];
+      while (diff >  M_PIl) { diff -= M_PIl; }
+      while (diff < -M_PIl) { diff += M_PIl; }
+      diff_sum += diff;
+    }
+    curv[i] = diff_sum / len;
+  }
+
+  for (int i = 1; i < num; i++) {
+    ps->px_length += point2d_distance(&pts[i-1].p2d, &pts[i].p2d);
+  }
+
+  int max_i = 1, min_i = 1;
+  for (int i = 1; i < num; i++) {
+    dy_dx[i] = (pts[i].y - pts[i-1].y) / (pts[i].x - pts[i-1].x);
+    if (dy_dx[i] > dy_dx[max_i]) { max_i = i; }
+    if (dy_dx[i] < dy_dx[min_i]) { min_i = i; }
+  }
+  double sub_length = 0;
+  if (max_i < min_i) { SWAP(max_i, min_i); }
+  for (int i = min_i + 1; i < max_i; i++) {
+    sub_length += point2d_distance(&pts[i-1].p2d, &pts[i].p2d);
+  }
+  ps->ndde = sub_length / ps->px_length;
+
+  double prog = 0, first = -1, last = -1, avg_d_dir = 0, max_d_dir = 0;
+  for (int i = 1; i < num; i++) {
+    prog += point2d_distance(&pts[i-1].p2d, &pts[i].p2d);
+    if (prog / ps->px_length <= 0.05) { continue; }
+    if (first < 0) { first = i; }
+    if (prog / ps->px_length >= 0.95) {
+      last = i;
+      break;
+    }
+    double d_dir = abs(dir[i-1] - dir[i]);
+    if (d_dir > max_d_dir) { max_d_dir = d_dir; }
+    avg_d_dir += d_dir;
+  }
+  avg_d_dir /= last - first + 1;
+  ps->dcr = max_d_dir / avg_d_dir;
+
+  if (num < PAL_THRESH_B || ps->px_length < PAL_THRESH_C) {
+    return;
+  }
+  int first_i = 0, last_i = num - 1;
+  prog = 0;
+  for (int i = 1; i < num - 1; i++) {
+    prog += point2d_distance(&pts[i-1].p2d, &pts[i].p2d);
+    const double pct = prog / ps->px_length;
+    if (pct < 0.20) {
+      if (curv[first_i] < curv[i]) { first_i = i; }
+    } else if (pct >= 0.80) {
+      if (curv[last_i] < curv[i]) { last_i = i; }
+    }
+  }
+  ps->num_pts = last_i - first_i + 1;
+  memmove(pts, &pts[first_i], ps->num_pts * sizeof(pal_point_t));
+  double* cols[] = { dir, dy_dx, sp, curv };
+  for (int c = 0; c < 4; c++) {
+    memmove(cols[c], &cols[c][first_i], ps->num_pts * sizeof(double));
+  }
+  for (int i = 0; i < ps->num_pts; i++) {
+    pts[i].p.i = i;
+  }
+
+  ps->tot_revs = (dir[ps->num_pts-1] - dir[0]) / (2 * M_PIl);
+  ps->overtraced = ps->tot_revs > PAL_THRESH_D;
+  ps->closed = (point2d_distance(&pts[0].p2d, &pts[ps->num_pts-1].p2d) /
+      ps->px_length) < PAL_THRESH_E && ps->tot_revs > PAL_THRESH_F;
+}
+
+/*! Checks that two values are the same, counting NaNs as the same.
+ *
+ * \param a A value.
+ * \param b Another value.
+ */
+static void _ck_same(double a, double b) {
+  ck_assert_msg(a == b || (isnan(a) && isnan(b)), "%g != %g", a, b);
+}
+
+/*! Checks that two values are the same up to rounding, counting NaNs as the
+ * same.
+ *
+ * \param a A value.
+ * \param b Another value.
+ */
+static void _ck_close(double a, double b) {
+  ck_assert_msg(fabs(a - b) <= 1e-12 * fabs(b) || (isnan(a) && isnan(b)),
+      "%g != %g", a, b);
+}
+
+START_TEST(c_pal_process_matches_reference)
+{ // The fused passes must build exactly the stroke the separate ones did.
+  pal_context_t* pal = pal_create();
+  for (int k = 0; k < 20; k++) {
+    stroke_t* strk = _test_stroke(k);
+    const pal_stroke_t* ps = pal_process(pal, strk);
+    pal_stroke_t ref;
+    _ref_process(strk, &ref);
+
+    ck_assert_int_eq(ps->num_pts, ref.num_pts);
+    for (int i = 0; i < ps->num_pts; i++) {
+      ck_assert(ps->pts[i].x == ref.pts[i].x && ps->pts[i].y == ref.pts[i].y);
+      ck_assert_int_eq(ps->pts[i].t, ref.pts[i].t);
+      ck_assert_int_eq(ps->pts[i].i, ref.pts[i].i);
+      _ck_same(pal_stroke_dir(ps, i), pal_stroke_dir(&ref, i));
+      _ck_same(pal_stroke_dy_dx(ps, i), pal_stroke_dy_dx(&ref, i));
+      _ck_same(pal_stroke_sp(ps, i), pal_stroke_sp(&ref, i));
+      _ck_same(pal_stroke_curv(ps, i), pal_stroke_curv(&ref, i));
+    }
+    // Each column is aligned, and zero past the last point.
+    ck_assert_int_eq((uintptr_t)ps->dir % STROKE_SOA_ALIGN, 0);
+    ck_assert_int_eq((uintptr_t)ps->curv % STROKE_SOA_ALIGN, 0);
+    for (int i = ps->num_pts; i % STROKE_SOA_PAD; i++) {
+      ck_assert(ps->dir[i] == 0 && ps->dy_dx[i] == 0);
+      ck_assert(ps->sp[i] == 0 && ps->curv[i] == 0);
+    }
+    _ck_same(ps->px_length, ref.px_length);
+    // The length between the dy/dx extremes is now a difference of lengths
+    // along the stroke, rather than a sum of its segments.
+    _ck_close(ps->ndde, ref.ndde);
+    _ck_same(ps->dcr, ref.dcr);
+    _ck_same(ps->tot_revs, ref.tot_revs);
+    ck_assert_int_eq(ps->overtraced, ref.overtraced);
+    ck_assert_int_eq(ps->closed, ref.closed);
+
+    free(ref.pts);
+    free(ref.dir);
+    free(ref.dy_dx);
+    free(ref.sp);
+    free(ref.curv);
+    stroke_destroy(strk);
+  }
+
+  stroke_t empty = { 0, 0, NULL };
+  ck_assert_int_eq(pal_process(pal, &empty)->num_pts, 0);
+  pal_destroy(pal);
+}
+END_TEST
+
+START_TEST(c_pal_stroke_arc_length)
+{ // Lengths along the stroke, from its first point after the tails are gone.
+  pal_context_t* pal = pal_create();
+  for (int k = 0; k < 20; k++) {
+    stroke_t* strk = _test_stroke(k);
+    const pal_stroke_t* ps = pal_process(pal, strk);
+    const int num = ps->num_pts;
+    if (num < 2) {  // No length to go along.
+      stroke_destroy(strk);
+      continue;
+    }
+
+    double len = 0;
+    ck_assert(pal_stroke_length(ps, 0, 0) == 0);
+    for (int i = 1; i < num; i++) {
+      len += point2d_distance(&ps->pts[i-1].p2d, &ps->pts[i].p2d);
+      ck_assert(fabs(pal_stroke_length(ps, 0, i) - len) <= 1e-9 * len);
+    }
+    ck_assert(pal_stroke_param(ps, 0) == 0);
+    ck_assert(pal_stroke_param(ps, num - 1) == 1);
 
-  pal_deinit();
+    ck_assert_int_eq(pal_stroke_index_at(ps, 0), 0);
+    ck_assert_int_eq(pal_stroke_index_at(ps, 1), num - 1);
+    ck_assert_int_eq(pal_stroke_index_at(ps, 2), num - 1);
+    for (double frac = 0.1; frac < 1; frac += 0.1) {
+      const int i = pal_stroke_index_at(ps, frac);
+      ck_assert(pal_stroke_param(ps, i) >= frac);
+      ck_assert(i == 0 || pal_stroke_param(ps, i - 1) < frac);
+    }
+    stroke_destroy(strk);
+  }
+  pal_destroy(pal);
 }
 END_TEST
 
@@ -108,10 +404,13 @@ static Suite* pal_suite() {
   Suite* suite = suite_create("paleo");
 
   TCase* tc = tcase_create("process");
-  tcase_add_test(tc, c_pal_init_deinit);
+  tcase_add_test(tc, c_pal_create_destroy);
   tcase_add_test(tc, c_pal_recognize_empty);
   tcase_add_test(tc, c_pal_recognize_1_point);
   tcase_add_test(tc, c_pal_recognize_40_points);
+  tcase_add_test(tc, c_pal_contexts_independent);
+  tcase_add_test(tc, c_pal_process_matches_reference);
+  tcase_add_test(tc, c_pal_stroke_arc_length);
   suite_add_tcase(suite, tc);
 
   tc = tcase_create("sanity");
@@ -0,0 +1,101 @@
+/*! Benchmarks Protractor against $P on the same command gestures.
+ *
+ * Each recognizer gets `MOCK_GESTURES` times `copies` wobbly templates and
+ * recognizes `queries` wobbly strokes made with other seeds.  Prints the
+ * accuracy, the time per query, and the number of queries per second of each.
+ * Not part of `make check`'s tests; run it by hand:
+ *
+ * \code{.sh}
+ * $ ./bench_protractor [copies [queries]]
+ * \endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common/stroke.h"
+#include "dollarp/dollarp.h"
+#include "protractor/protractor.h"
+#include "mock_gesture.h"
+
+//! The size of the wobble of every gesture.
+#define _WOBBLE 0.04
+
+/*! Gets the time.
+ *
+ * \return The time, in seconds.
+ */
+static double _now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*! Prints a recognizer's accuracy and speed.
+ *
+ * \param name The recognizer.
+ * \param right The number of queries recognized correctly.
+ * \param queries The number of queries.
+ * \param secs The time they took.
+ */
+static void _report(const char* name, int right, int queries, double secs) {
+  printf("%-12s accuracy %.3f  %10.2f us/query  %12.0f queries/s\n",
+         name, right / (double)queries, 1e6 * secs / queries, queries / secs);
+}
+
+int main(int argc, char** argv) {
+  const int copies = (argc > 1) ? atoi(argv[1]) : 100;
+  const int queries = (argc > 2) ? atoi(argv[2]) : 400;
+  const int num = MOCK_GESTURES * copies;
+  printf("%d templates, %d queries\n", num, queries);
+
+  pt_context_t* pt = pt_create();
+  dp_context_t* dp = dp_create();
+  dp_set_n(dp, PT_DEFAULT_N);
+  char name[16];
+  for (int i = 0; i < num; i++) {
+    stroke_t* strk = mock_gesture(i, i / MOCK_GESTURES, _WOBBLE);
+    snprintf(name, sizeof(name), "%d", i % MOCK_GESTURES);
+    pt_add_template(pt, strk, name);
+    dp_add_template(dp, strk, name);
+    stroke_destroy(strk);
+  }
+
+  stroke_t** strks = calloc(queries, sizeof(stroke_t*));
+  for (int q = 0; q < queries; q++) {
+    strks[q] = mock_gesture(q, 1000 + q, _WOBBLE);
+  }
+
+  // Both recognizers reuse a workspace, as a throughput-bound caller would.
+  pt_workspace_t* pt_ws = pt_workspace_create(pt);
+  dp_workspace_t* dp_ws = dp_workspace_create(dp);
+
+  int right = 0;
+  double start = _now();
+  for (int q = 0; q < queries; q++) {
+    pt_result_t res = pt_recognize_ws(pt, pt_ws, strks[q]);
+    right += res.index % MOCK_GESTURES == q % MOCK_GESTURES;
+  }
+  _report("Protractor", right, queries, _now() - start);
+
+  right = 0;
+  start = _now();
+  for (int q = 0; q < queries; q++) {
+    dp_result_t res = dp_recognize_ws(dp, dp_ws, strks[q]);
+    right += res.index % MOCK_GESTURES == q % MOCK_GESTURES;
+  }
+  _report("$P", right, queries, _now() - start);
+
+  for (int q = 0; q < queries; q++) {
+    stroke_destroy(strks[q]);
+  }
+  free(strks);
+  dp_workspace_destroy(dp_ws);
+  pt_workspace_destroy(pt_ws);
+  dp_destroy(dp);
+  pt_destroy(pt);
+  return EXIT_SUCCESS;
+}
+
+#undef _WOBBLE
@@ -0,0 +1,46 @@
+#include <math.h>
+
+#include "mock_gesture.h"
+
+//! Number of points in each gesture.
+#define _NUM_PTS 64
+
+//! The corners of each polyline gesture, ending with a repeat of the last.
+static const double _corners[][6][2] = {
+  { { 0, 0 }, { 1, 0 }, { 1, 0 } },                           // Line.
+  { { 0, 0 }, { 0.5, 1 }, { 1, 0 }, { 1, 0 } },               // Caret.
+  { { 0, 1 }, { 0.5, 0 }, { 1, 1 }, { 1, 1 } },               // V.
+  { { 0, 0.5 }, { 0.3, 0 }, { 1, 1 }, { 1, 1 } },             // Check.
+  { { 0, 1 }, { 1, 1 }, { 0, 0 }, { 1, 0 }, { 1, 0 } },       // Zig-zag.
+  { { 0, 0 } },                                               // Circle.
+  { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 }, { 0, 0 }, { 0, 0 } }, // Square.
+  { { 0, 0 }, { 1, 0 }, { 0.5, 1 }, { 0, 0 }, { 0, 0 } },     // Triangle.
+};
+
+//! Number of segments of each polyline gesture.
+static const int _segments[] = { 1, 2, 2, 2, 3, 0, 4, 3 };
+
+stroke_t* mock_gesture(int k, int seed, double wobble) {
+  k %= MOCK_GESTURES;
+  stroke_t* strk = stroke_create(_NUM_PTS);
+  for (int i = 0; i < _NUM_PTS; i++) {
+    const double u = i / (_NUM_PTS - 1.0);
+    double x, y;
+    if (_segments[k] == 0) {
+      x = 0.5 + 0.5 * cos(2 * M_PI * u);
+      y = 0.5 + 0.5 * sin(2 * M_PI * u);
+    } else {
+      const double s = u * _segments[k];
+      const int j = (s < _segments[k]) ? (int)s : _segments[k] - 1;
+      const double f = s - j;
+      x = (1 - f) * _corners[k][j][0] + f * _corners[k][j + 1][0];
+      y = (1 - f) * _corners[k][j][1] + f * _corners[k][j + 1][1];
+    }
+    x += wobble * sin(i * 0.7 * (seed + 1) + seed);
+    y += wobble * cos(i * 0.3 * (seed + 2) + seed);
+    stroke_add_timed(strk, 100 * x, 100 * y, i);
+  }
+  return strk;
+}
+
+#undef _NUM_PTS
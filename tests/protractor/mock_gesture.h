@@ -0,0 +1,21 @@
+#ifndef __mock_gesture_h__
+#define __mock_gesture_h__
+
+#include "common/stroke.h"
+
+//! Number of different gestures `mock_gesture()` makes.
+#define MOCK_GESTURES 8
+
+/*! Creates a single-stroke command gesture -- a line, caret, V, check,
+ * zig-zag, circle, square, or triangle -- drawn with 64 points, and perturbed
+ * by a deterministic wobble.
+ *
+ * \param k Selects the gesture, modulo `MOCK_GESTURES`.
+ * \param seed Selects the wobble.
+ * \param wobble The size of the wobble, relative to the gesture's size.
+ *
+ * \return The stroke.  Must be freed with call to `stroke_destroy`.
+ */
+stroke_t* mock_gesture(int k, int seed, double wobble);
+
+#endif // __mock_gesture_h__
@@ -0,0 +1,252 @@
+#include <check.h>
+#include <math.h>
+#include <values.h>
+
+#include "common/stroke.h"
+#include "protractor/protractor.h"
+#include "mock_gesture.h"
+
+/*! Makes a context with one template of each mock gesture, named after it.
+ *
+ * \return The context.
+ */
+static pt_context_t* _gestures_context() {
+  pt_context_t* ctx = pt_create();
+  char name[16];
+  for (int k = 0; k < MOCK_GESTURES; k++) {
+    stroke_t* strk = mock_gesture(k, 0, 0);
+    snprintf(name, sizeof(name), "gesture %d", k);
+    pt_add_template(ctx, strk, name);
+    stroke_destroy(strk);
+  }
+  return ctx;
+}
+
+/*! Rotates a stroke about its first point.
+ *
+ * \param strk The stroke.
+ * \param angle The angle, counter-clockwise in radians.
+ */
+static void _rotate(stroke_t* strk, double angle) {
+  const double c = cos(angle), s = sin(angle);
+  for (int i = 0; i < strk->num; i++) {
+    const double x = strk->pts[i].x, y = strk->pts[i].y;
+    strk->pts[i].x = c * x - s * y;
+    strk->pts[i].y = s * x + c * y;
+  }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//              Context Creation, Destruction, and Manipulation               //
+////////////////////////////////////////////////////////////////////////////////
+
+START_TEST(c_pt_create) {
+  pt_context_t* ctx = pt_create();
+  ck_assert(ctx != NULL);
+  ck_assert_int_eq(ctx->n, PT_DEFAULT_N);
+  ck_assert(ctx->max_angle == PT_DEFAULT_MAX_ANGLE);
+  ck_assert_int_eq(ctx->num, 0);
+
+  stroke_t* strk = mock_gesture(1, 0, 0);
+  pt_result_t res = pt_recognize(ctx, strk);
+  ck_assert(res.tmpl == NULL);
+  ck_assert_int_eq(res.index, -1);
+  stroke_destroy(strk);
+  pt_destroy(ctx);
+} END_TEST
+
+START_TEST(c_pt_set_n) {
+  pt_context_t* ctx = pt_create();
+  ck_assert_int_eq(pt_set_n(ctx, 0), 1);
+  ck_assert_int_eq(pt_set_n(ctx, 32), 0);
+  ck_assert_int_eq(ctx->n, 32);
+
+  // The vectors already made would no longer fit.
+  stroke_t* strk = mock_gesture(0, 0, 0);
+  pt_add_template(ctx, strk, "line");
+  ck_assert_int_eq(pt_set_n(ctx, 16), 1);
+  ck_assert_int_eq(ctx->n, 32);
+  stroke_destroy(strk);
+  pt_destroy(ctx);
+} END_TEST
+
+START_TEST(c_pt_add_templates) {
+  pt_context_t* ctx = pt_create();
+  stroke_t* empty = stroke_create(0);
+  pt_add_template(ctx, empty, "empty");
+  ck_assert_int_eq(ctx->num, 0);
+  stroke_destroy(empty);
+
+  // Past the first allocation, every template keeps its own unit vector.
+  for (int k = 0; k < 250; k++) {
+    stroke_t* strk = mock_gesture(k, k, 0.01);
+    pt_add_template(ctx, strk, "many");
+    stroke_destroy(strk);
+  }
+  ck_assert_int_eq(ctx->num, 250);
+  for (int k = 0; k < 250; k++) {
+    const double* vec = ctx->tmpls[k].vec;
+    ck_assert(vec == ctx->vecs + k * 2 * ctx->n);
+    double sq = 0;
+    for (int i = 0; i < 2 * ctx->n; i++) {
+      sq += vec[i] * vec[i];
+    }
+    ck_assert(fabs(sq - 1) < 1e-9);
+  }
+  pt_destroy(ctx);
+} END_TEST
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ------------------------------- Running -------------------------------- //
+////////////////////////////////////////////////////////////////////////////////
+
+START_TEST(c_pt_recognize) {
+  pt_context_t* ctx = _gestures_context();
+  for (int k = 0; k < MOCK_GESTURES; k++) {
+    // Each template is itself, exactly.
+    stroke_t* strk = mock_gesture(k, 0, 0);
+    pt_result_t res = pt_recognize(ctx, strk);
+    ck_assert_int_eq(res.index, k);
+    ck_assert(res.tmpl == &ctx->tmpls[k]);
+    ck_assert(fabs(res.score - 1) < 1e-9);
+    ck_assert(fabs(res.angle) < 1e-6);
+    stroke_destroy(strk);
+
+    // And wobbly copies are still recognized.
+    for (int seed = 1; seed < 6; seed++) {
+      strk = mock_gesture(k, seed, 0.03);
+      res = pt_recognize(ctx, strk);
+      ck_assert_int_eq(res.index, k);
+      ck_assert(res.score < 1);
+      stroke_destroy(strk);
+    }
+  }
+  pt_destroy(ctx);
+} END_TEST
+
+START_TEST(c_pt_rotation) {
+  pt_context_t* ctx = _gestures_context();
+  int still = 0;
+  for (int k = 1; k < MOCK_GESTURES; k++) {
+    stroke_t* strk = mock_gesture(k, 0, 0);
+    _rotate(strk, 0.5);
+
+    // Any rotation: the stroke is rotated back onto its template.
+    pt_result_t res = pt_recognize(ctx, strk);
+    ck_assert_int_eq(res.index, k);
+    ck_assert(fabs(res.score - 1) < 1e-9);
+    ck_assert(fabs(res.angle + 0.5) < 1e-6);
+
+    // Bounded rotation: only as far as the bound.  Some gestures then look
+    // more like others.
+    pt_set_max_angle(ctx, 0.2);
+    pt_result_t bounded = pt_recognize(ctx, strk);
+    if (bounded.index == k) {
+      ck_assert(fabs(bounded.angle + 0.2) < 1e-9);
+      ck_assert(bounded.score < res.score);
+      still++;
+    }
+
+    // No rotation: the score is the plain cosine, and lower still.
+    pt_set_max_angle(ctx, 0);
+    pt_result_t fixed = pt_recognize(ctx, strk);
+    if (fixed.index == k) {
+      ck_assert(fixed.angle == 0);
+      ck_assert(fixed.score < bounded.score);
+    }
+    pt_set_max_angle(ctx, PT_DEFAULT_MAX_ANGLE);
+    stroke_destroy(strk);
+  }
+  ck_assert(still >= MOCK_GESTURES / 2);
+  pt_destroy(ctx);
+} END_TEST
+
+START_TEST(c_pt_recognize_ws) {
+  pt_context_t* ctx = _gestures_context();
+  pt_workspace_t* ws = pt_workspace_create(ctx);
+  ck_assert(ws != NULL);
+  for (int k = 0; k < MOCK_GESTURES; k++) {
+    stroke_t* strk = mock_gesture(k, 7, 0.05);
+    pt_result_t res = pt_recognize_ws(ctx, ws, strk);
+    pt_result_t expected = pt_recognize(ctx, strk);
+    ck_assert(res.tmpl != NULL);
+    ck_assert(res.tmpl == expected.tmpl);
+    ck_assert(res.score == expected.score);
+    ck_assert(res.angle == expected.angle);
+    stroke_destroy(strk);
+  }
+  pt_workspace_destroy(ws);
+  pt_destroy(ctx);
+
+  // A workspace sized for another `n` is regrown.
+  ctx = pt_create();
+  ws = pt_workspace_create(ctx);
+  pt_set_n(ctx, 64);
+  stroke_t* strk = mock_gesture(2, 0, 0);
+  pt_add_template(ctx, strk, "two");
+  pt_result_t res = pt_recognize_ws(ctx, ws, strk);
+  ck_assert_int_eq(res.index, 0);
+  ck_assert(fabs(res.score - 1) < 1e-9);
+  stroke_destroy(strk);
+  pt_workspace_destroy(ws);
+  pt_destroy(ctx);
+} END_TEST
+
+START_TEST(c_pt_ties) {
+  pt_context_t* ctx = pt_create();
+  stroke_t* strk = mock_gesture(2, 0, 0);
+  pt_add_template(ctx, strk, "first");
+  pt_add_template(ctx, strk, "second");
+  pt_result_t res = pt_recognize(ctx, strk);
+  ck_assert_int_eq(res.index, 0);
+  ck_assert_str_eq(res.tmpl->name, "first");
+
+  stroke_t* empty = stroke_create(0);
+  res = pt_recognize(ctx, empty);
+  ck_assert(res.tmpl == NULL);
+  ck_assert_int_eq(res.index, -1);
+  stroke_destroy(empty);
+  stroke_destroy(strk);
+  pt_destroy(ctx);
+} END_TEST
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ----------------------------- Entry Point ------------------------------ //
+////////////////////////////////////////////////////////////////////////////////
+
+static inline Suite* pt_suite() {
+  Suite* suite = suite_create("protractor");
+
+  TCase* tc = tcase_create("context");
+  tcase_add_test(tc, c_pt_create);
+  tcase_add_test(tc, c_pt_set_n);
+  tcase_add_test(tc, c_pt_add_templates);
+  suite_add_tcase(suite, tc);
+
+  tc = tcase_create("running");
+  tcase_add_test(tc, c_pt_recognize);
+  tcase_add_test(tc, c_pt_rotation);
+  tcase_add_test(tc, c_pt_ties);
+  tcase_add_test(tc, c_pt_recognize_ws);
+  suite_add_tcase(suite, tc);
+
+  return suite;
+}
+
+int main() {
+  int number_failed = 0;
+  Suite* suite = pt_suite();
+  SRunner* runner = srunner_create(suite);
+
+  srunner_run_all(runner, CK_VERBOSE);
+  number_failed = srunner_ntests_failed(runner);
+  srunner_free(runner);
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}